@@ -0,0 +1,225 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_CANDIDATESELECTOR_HPP_
+#define ROVIO_CANDIDATESELECTOR_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace rovio{
+
+/** \brief Bucketing and distance based selection of feature candidates (used by FeatureSetManager::addBestCandidates()).
+ *
+ *  Every candidate is placed into a bucket depending on its score. Candidates close to existing features are moved into lower
+ *  buckets. Then, the candidates are selected from the highest bucket downwards, whereby every selected candidate again penalizes
+ *  its neighbours. The neighbour search uses a uniform grid with a cell size of (at least) the penalty distance, such that only
+ *  the 3x3 cells around a feature are visited. The members of a bucket are kept as plain index lists, candidates moved to a lower
+ *  bucket are appended there and dropped lazily from the higher one. A bucket is sorted by score only once it is reached.
+ */
+class CandidateSelector{
+ public:
+  /** \brief Selects the best candidates.
+   *
+   * @param pixels                 - Pixel coordinates of the candidates.
+   * @param scores                 - Scores of the candidates (parallel to pixels).
+   * @param minScore               - Score threshold, candidates with a score less than or equal are not selected.
+   * @param maxScore               - Maximal score of all candidates.
+   * @param existingPixels         - Pixel coordinates of the already existing features.
+   * @param maxCount               - Maximal number of candidates which should be selected.
+   * @param nDetectionBuckets      - Number of buckets.
+   * @param scoreDetectionExponent - Exponent applied to the relative score for the bucket assignment.
+   * @param penaltyDistance        - Candidates closer than this to a feature are penalized (moved into a lower bucket).
+   * @param zeroDistancePenalty    - Number of buckets a candidate is moved down if it has zero distance to a feature.
+   * @param requireMax             - Should candidates from the lowest bucket be selected as well?
+   * @param selected               - Indices of the selected candidates, in the order of selection.
+   */
+  void select(const std::vector<cv::Point2f>& pixels, const std::vector<float>& scores, const float minScore, const float maxScore,
+              const std::vector<cv::Point2f>& existingPixels, const int maxCount, const int nDetectionBuckets, const double scoreDetectionExponent,
+              const double penaltyDistance, const double zeroDistancePenalty, const bool requireMax, std::vector<int>& selected){
+    selected.clear();
+    const int nCandidates = pixels.size();
+    bucket_.assign(nCandidates,-1);
+    members_.resize(nDetectionBuckets);
+    for(int b=0;b<nDetectionBuckets;b++){
+      members_[b].clear();
+    }
+
+    // Make buckets and fill based on score
+    unsigned int newBucketID;
+    float relScore;
+    for(int i=0;i<nCandidates;i++){
+      relScore = (scores[i]-minScore)/(maxScore-minScore);
+      if(relScore > 0.0){
+        newBucketID = std::ceil((nDetectionBuckets-1)*(pow(relScore,static_cast<float>(scoreDetectionExponent))));
+        if(newBucketID>nDetectionBuckets-1) newBucketID = nDetectionBuckets-1;
+        bucket_[i] = newBucketID;
+        members_[newBucketID].push_back(i);
+      }
+    }
+
+    // Move buckets based on current features
+    t2_ = pow(penaltyDistance,2);
+    zeroDistancePenalty_ = zeroDistancePenalty;
+    buildGrid(pixels);
+    for(const cv::Point2f& p : existingPixels){
+      penalize(p,pixels,nDetectionBuckets-1);
+    }
+
+    // Incrementally select candidates and penalize their neighbours. While bucket b is processed, candidates only leave it,
+    // such that it is sufficient to sort its members by score once (only the buckets which are actually reached are sorted).
+    for(int b = nDetectionBuckets-1;b >= 0+static_cast<int>(!requireMax) && (int)selected.size() < maxCount;b--){
+      std::vector<int>& members = members_[b];
+      members.erase(std::remove_if(members.begin(),members.end(),[&](const int i){return bucket_[i] != b;}),members.end());
+      std::sort(members.begin(),members.end(),[&](const int i, const int j){return isFirstBetter(scores,i,j);});
+      for(int k=0;k<members.size() && (int)selected.size() < maxCount;k++){
+        const int i = members[k];
+        if(bucket_[i] != b) continue;
+        selected.push_back(i);
+        bucket_[i] = -1;
+        penalize(pixels[i],pixels,b);
+      }
+    }
+  }
+
+ private:
+  /** \brief Order within a bucket: decreasing score, ties resolved by the candidate index.
+   */
+  static bool isFirstBetter(const std::vector<float>& scores, const int a, const int b){
+    return scores[a] != scores[b] ? scores[a] > scores[b] : a < b;
+  }
+
+  /** \brief Sorts all bucketed candidates into the neighbour search grid.
+   *
+   * @param pixels - Pixel coordinates of the candidates.
+   */
+  void buildGrid(const std::vector<cv::Point2f>& pixels){
+    nCellsX_ = 0;
+    nCellsY_ = 0;
+    cellItems_.clear();
+    if(t2_ <= 0.0) return;
+    bool empty = true;
+    float maxX = 0, maxY = 0;
+    for(int i=0;i<pixels.size();i++){
+      if(bucket_[i] < 0) continue;
+      if(empty){
+        origin_ = pixels[i];
+        maxX = pixels[i].x;
+        maxY = pixels[i].y;
+        empty = false;
+      } else {
+        origin_.x = std::min(origin_.x,pixels[i].x);
+        origin_.y = std::min(origin_.y,pixels[i].y);
+        maxX = std::max(maxX,pixels[i].x);
+        maxY = std::max(maxY,pixels[i].y);
+      }
+    }
+    if(empty) return;
+    // The cell size must not be smaller than the penalty distance, it is enlarged to limit the grid to maxCells_ x maxCells_ cells
+    cellSize_ = std::max(static_cast<float>(std::sqrt(t2_)),std::max(maxX-origin_.x,maxY-origin_.y)/maxCells_);
+    nCellsX_ = static_cast<int>((maxX-origin_.x)/cellSize_)+1;
+    nCellsY_ = static_cast<int>((maxY-origin_.y)/cellSize_)+1;
+    cellStart_.assign(nCellsX_*nCellsY_+1,0);
+    for(int i=0;i<pixels.size();i++){
+      if(bucket_[i] >= 0) cellStart_[getCell(pixels[i])+1]++;
+    }
+    for(int c=0;c<nCellsX_*nCellsY_;c++){
+      cellStart_[c+1] += cellStart_[c];
+    }
+    cellItems_.resize(cellStart_.back());
+    cellFill_.assign(cellStart_.begin(),cellStart_.end()-1);
+    for(int i=0;i<pixels.size();i++){
+      if(bucket_[i] >= 0) cellItems_[cellFill_[getCell(pixels[i])]++] = i;
+    }
+  }
+
+  /** \brief Returns the grid cell of a bucketed candidate.
+   */
+  int getCell(const cv::Point2f& p) const{
+    const int x = std::min(static_cast<int>((p.x-origin_.x)/cellSize_),nCellsX_-1);
+    const int y = std::min(static_cast<int>((p.y-origin_.y)/cellSize_),nCellsY_-1);
+    return y*nCellsX_+x;
+  }
+
+  /** \brief Moves all candidates within the penalty distance of a feature into lower buckets.
+   *
+   * @param p         - Pixel coordinates of the feature.
+   * @param pixels    - Pixel coordinates of the candidates.
+   * @param maxBucket - Only candidates in the buckets 1 to maxBucket are penalized.
+   */
+  void penalize(const cv::Point2f& p, const std::vector<cv::Point2f>& pixels, const int maxBucket){
+    if(nCellsX_ == 0) return;
+    const float fx = std::floor((p.x-origin_.x)/cellSize_);
+    const float fy = std::floor((p.y-origin_.y)/cellSize_);
+    if(fx < -1 || fy < -1 || fx > nCellsX_ || fy > nCellsY_) return;
+    const int x0 = std::max(static_cast<int>(fx)-1,0);
+    const int x1 = std::min(static_cast<int>(fx)+1,nCellsX_-1);
+    const int y0 = std::max(static_cast<int>(fy)-1,0);
+    const int y1 = std::min(static_cast<int>(fy)+1,nCellsY_-1);
+    double d2;
+    int newBucketID;
+    for(int y=y0;y<=y1;y++){
+      for(int x=x0;x<=x1;x++){
+        const int c = y*nCellsX_+x;
+        for(int k=cellStart_[c];k<cellStart_[c+1];k++){
+          const int i = cellItems_[k];
+          const int b = bucket_[i];
+          if(b < 1 || b > maxBucket) continue;
+          d2 = std::pow(p.x - pixels[i].x,2) + std::pow(p.y - pixels[i].y,2);
+          if(d2<t2_){
+            newBucketID = std::max((int)(b - (t2_-d2)/t2_*zeroDistancePenalty_),0);
+            if(b != newBucketID){
+              bucket_[i] = newBucketID;
+              members_[newBucketID].push_back(i);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  static constexpr float maxCells_ = 256.0f;  /**<Maximal number of grid cells along one image axis.*/
+  std::vector<int> bucket_;  /**<Current bucket of every candidate (-1: not available).*/
+  std::vector<std::vector<int>> members_;  /**<Candidate indices of every bucket (may contain candidates which moved on).*/
+  std::vector<int> cellStart_;  /**<Start of every grid cell in cellItems_ (plus end of the last cell).*/
+  std::vector<int> cellFill_;  /**<Temporary fill position of every grid cell.*/
+  std::vector<int> cellItems_;  /**<Candidate indices, sorted by grid cell.*/
+  cv::Point2f origin_;  /**<Position of the grid origin.*/
+  float cellSize_;  /**<Edge length of a grid cell.*/
+  int nCellsX_;  /**<Number of grid cells along x.*/
+  int nCellsY_;  /**<Number of grid cells along y.*/
+  double t2_;  /**<Squared penalty distance.*/
+  double zeroDistancePenalty_;  /**<Penalty for zero distance.*/
+};
+
+}
+
+
+#endif /* ROVIO_CANDIDATESELECTOR_HPP_ */
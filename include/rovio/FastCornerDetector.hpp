@@ -0,0 +1,124 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_FASTCORNERDETECTOR_HPP_
+#define ROVIO_FASTCORNERDETECTOR_HPP_
+
+#include "rovio/ImagePyramid.hpp"
+
+namespace rovio{
+
+/** \brief Persistent FAST corner detection on the levels of an image pyramid.
+ *
+ *  Holds one cv::FastFeatureDetector and one set of result buffers per pyramid level, such that repeated detections
+ *  neither recreate the detectors nor reallocate the buffers. Different levels can be detected concurrently.
+ *
+ *  @tparam n_levels - Number of pyramid levels.
+ */
+template<int n_levels>
+class MultilevelFastDetector{
+ public:
+  cv::Ptr<cv::FastFeatureDetector> detectors_[n_levels];  /**<FAST detector of every level.*/
+  std::vector<cv::KeyPoint> keypoints_[n_levels];  /**<Keypoint buffer of every level.*/
+  std::vector<FeatureCoordinates> candidates_[n_levels];  /**<Corners of the last detection on every level (defined on pyramid level 0).*/
+  std::vector<float> responses_[n_levels];  /**<FAST responses of the last detection on every level (parallel to \\ref candidates_).*/
+  cv::Mat masks_[n_levels];  /**<Detection mask of every level.*/
+  int threshold_;  /**<Current detection threshold.*/
+
+  /** \brief Constructor
+   */
+  MultilevelFastDetector(): threshold_(-1){}
+
+  /** \brief Sets the detection threshold of all levels (creates the detectors if required, cheap if unchanged).
+   *
+   * @param threshold - Detection threshold of the cv::FastFeatureDetector.
+   */
+  void setThreshold(const int threshold){
+    for(int l=0;l<n_levels;l++){
+      if(detectors_[l].empty()){
+        detectors_[l] = cv::FastFeatureDetector::create(threshold, true);
+      } else if(threshold != threshold_){
+        detectors_[l]->setThreshold(threshold);
+      }
+    }
+    threshold_ = threshold;
+  }
+
+  /** \brief Detects the corners on a single level, the result is stored in \\ref candidates_[l] and \\ref responses_[l].
+   *
+   *  Regions within maskRadius of the given pixels are excluded from the detection.
+   *
+   * @param pyr         - Image pyramid.
+   * @param l           - Pyramid level.
+   * @param maskPixels  - Pixel coordinates (level 0) around which no corners should be detected.
+   * @param maskRadius  - Radius of the masked regions on level 0 [pix]. No mask is used if <= 0.
+   */
+  void detect(const ImagePyramid<n_levels>& pyr, const int l, const std::vector<cv::Point2f>& maskPixels, const double maskRadius){
+    assert(!detectors_[l].empty());
+    candidates_[l].clear();
+    responses_[l].clear();
+    if(maskRadius > 0 && !maskPixels.empty()){
+      masks_[l].create(pyr.imgs_[l].size(),CV_8UC1);
+      masks_[l].setTo(255);
+      const int radius = std::max(static_cast<int>(std::round(maskRadius*pow(0.5,l))),1);
+      FeatureCoordinates c;
+      for(const cv::Point2f& p : maskPixels){
+        pyr.levelTranformCoordinates(FeatureCoordinates(p),c,0,l);
+        cv::circle(masks_[l],cv::Point(std::round(c.get_c().x),std::round(c.get_c().y)),radius,cv::Scalar(0),-1);
+      }
+      pyr.detectFastCorners(candidates_[l],l,*detectors_[l],keypoints_[l],&responses_[l],masks_[l]);
+    } else {
+      pyr.detectFastCorners(candidates_[l],l,*detectors_[l],keypoints_[l],&responses_[l]);
+    }
+  }
+
+  /** \brief Appends the results of the last detection on the levels l1 to l2 (in increasing order).
+   *
+   * @param candidates - List to which the corner coordinates are appended.
+   * @param responses  - List to which the FAST responses are appended.
+   * @param l1         - Lowest level.
+   * @param l2         - Highest level.
+   */
+  void getCandidates(std::vector<FeatureCoordinates>& candidates, std::vector<float>& responses, const int l1, const int l2) const{
+    size_t n = candidates.size();
+    for(int l=l1;l<=l2;l++){
+      n += candidates_[l].size();
+    }
+    candidates.reserve(n);
+    responses.reserve(n);
+    for(int l=l1;l<=l2;l++){
+      candidates.insert(candidates.end(),candidates_[l].begin(),candidates_[l].end());
+      responses.insert(responses.end(),responses_[l].begin(),responses_[l].end());
+    }
+  }
+};
+
+}
+
+
+#endif /* ROVIO_FASTCORNERDETECTOR_HPP_ */
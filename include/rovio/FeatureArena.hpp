@@ -0,0 +1,143 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_FEATUREARENA_HPP_
+#define ROVIO_FEATUREARENA_HPP_
+
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+#include "rovio/FeatureCoordinates.hpp"
+#include "rovio/FeatureDistance.hpp"
+#include "rovio/FeatureStatistics.hpp"
+#include "rovio/MultilevelPatch.hpp"
+
+namespace rovio{
+
+/** \brief Fixed size array, whose elements are stored in a single cache line aligned memory block.
+ *
+ *  Every element starts at a cache line boundary (the stride is padded to a multiple of \ref alignment_), such that
+ *  neighbouring elements never share a cache line.
+ *
+ *  @tparam T - Element type (must be default constructible).
+ *  @tparam n - Number of elements.
+ */
+template<typename T, int n>
+class AlignedArray{
+ public:
+  static constexpr size_t alignment_ = 64;  /**<Alignment of the block and of every element [bytes].*/
+  static constexpr size_t stride_ = (sizeof(T)+alignment_-1)/alignment_*alignment_;  /**<Distance between two elements [bytes].*/
+
+  /** \brief Constructor, allocates the block and default constructs all elements.
+   */
+  AlignedArray(): mpData_(nullptr){
+    void* mpData = nullptr;
+    if(posix_memalign(&mpData,alignment_,stride_*n) != 0) throw std::bad_alloc();
+    mpData_ = static_cast<char*>(mpData);
+    for(int i=0;i<n;i++){
+      new(mpData_+i*stride_) T();
+    }
+  }
+
+  /** \brief Destructor
+   */
+  ~AlignedArray(){
+    for(int i=0;i<n;i++){
+      (*this)[i].~T();
+    }
+    free(mpData_);
+  }
+
+  AlignedArray(const AlignedArray&) = delete;
+  AlignedArray& operator=(const AlignedArray&) = delete;
+
+  T& operator[](const int i){
+    return *reinterpret_cast<T*>(mpData_+i*stride_);
+  }
+  const T& operator[](const int i) const{
+    return *reinterpret_cast<const T*>(mpData_+i*stride_);
+  }
+
+ private:
+  char* mpData_;  /**<Memory block.*/
+};
+
+/** \brief Contiguous storage of the per-feature objects of a FeatureSetManager, indexed by the array/set index (slot).
+ *
+ *  FeatureSetManager::allocateMissing() links the FeatureManager pointers which are not linked to external objects
+ *  (e.g. the coordinates and distances in the filter state) to the slots of the arena, such that the per-frame loops over
+ *  the features walk linearly through memory instead of following individually allocated objects across the heap.
+ *
+ *  Copies share the storage of the original (as the shallow copies of the FeatureManager pointers do), assignment
+ *  keeps the own storage (as FeatureManager::operator= copies contents and not pointers).
+ *
+ * @tparam nLevels   - Number of pyramid levels of the MultilevelPatch%es.
+ * @tparam patchSize - Edge length of the patches in pixels.
+ * @tparam nCam      - Number of cameras.
+ * @tparam nMax      - Number of slots.
+ */
+template<int nLevels,int patchSize, int nCam,int nMax>
+class FeatureArena{
+ public:
+  struct Storage{
+    AlignedArray<MultilevelPatch<nLevels,patchSize>,nMax> multilevelPatches_;
+    AlignedArray<FeatureStatistics<nCam>,nMax> statistics_;
+    AlignedArray<FeatureCoordinates,nMax> coordinates_;
+    AlignedArray<FeatureDistance,nMax> distances_;
+  };
+
+  /** \brief Constructor
+   */
+  FeatureArena(): mpStorage_(new Storage()){}
+  FeatureArena(const FeatureArena& other) = default;
+  FeatureArena& operator=(const FeatureArena&){
+    return *this;
+  }
+
+  MultilevelPatch<nLevels,patchSize>& multilevelPatch(const int slot){
+    return mpStorage_->multilevelPatches_[slot];
+  }
+  FeatureStatistics<nCam>& statistics(const int slot){
+    return mpStorage_->statistics_[slot];
+  }
+  FeatureCoordinates& coordinates(const int slot){
+    return mpStorage_->coordinates_[slot];
+  }
+  FeatureDistance& distance(const int slot){
+    return mpStorage_->distances_[slot];
+  }
+
+ private:
+  std::shared_ptr<Storage> mpStorage_;
+};
+
+}
+
+
+#endif /* ROVIO_FEATUREARENA_HPP_ */
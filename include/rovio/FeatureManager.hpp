@@ -34,9 +34,13 @@
 #include "rovio/FeatureStatistics.hpp"
 #include "rovio/MultilevelPatch.hpp"
 #include "rovio/MultiCamera.hpp"
+#include "rovio/CandidateSelector.hpp"
+#include "rovio/SlotAllocator.hpp"
+#include "rovio/FeatureArena.hpp"
 #include "algorithm"
 #include <tuple>
 #include <list>
+#include <memory>
 
 namespace rovio{
 
@@ -61,12 +65,6 @@ class FeatureManager{
   FeatureStatistics<nCam>* mpStatistics_;
   MultilevelPatch<nLevels,patchSize>* mpMultilevelPatch_;
 
-  // Internal objects, only used if no external objects are linked
-  FeatureCoordinates* _mpCoordinates;
-  FeatureDistance* _mpDistance;
-  FeatureStatistics<nCam>* _mpStatistics;
-  MultilevelPatch<nLevels,patchSize>* _mpMultilevelPatch;
-
   /** Constructor
    */
   FeatureManager(){
@@ -75,22 +73,13 @@ class FeatureManager{
     mpDistance_ = nullptr;
     mpStatistics_ = nullptr;
     mpMultilevelPatch_ = nullptr;
-    _mpCoordinates = nullptr;
-    _mpDistance = nullptr;
-    _mpStatistics = nullptr;
-    _mpMultilevelPatch = nullptr;
   }
 
   /** Destructor
    *
-   *  @todo complete rule of three
+   *  The linked objects are not owned (\see FeatureSetManager::allocateMissing()).
    */
-  virtual ~FeatureManager(){
-    delete _mpCoordinates;
-    delete _mpDistance;
-    delete _mpStatistics;
-    delete _mpMultilevelPatch;
-  }
+  virtual ~FeatureManager(){}
 
   FeatureManager& operator= (const FeatureManager &other){
     idx_ = other.idx_;
@@ -100,27 +89,6 @@ class FeatureManager{
     *mpStatistics_ = *other.mpStatistics_;
     return *this;
   }
-
-  /** \brief Allocates all pointer which are still nullptr
-   */
-  void allocateMissing(){
-    if(mpCoordinates_ == nullptr){
-      _mpCoordinates = new FeatureCoordinates();
-      mpCoordinates_ = _mpCoordinates;
-    }
-    if(mpDistance_ == nullptr){
-      _mpDistance = new FeatureDistance();
-      mpDistance_ = _mpDistance;
-    }
-    if(mpStatistics_ == nullptr){
-      _mpStatistics = new FeatureStatistics<nCam>();
-      mpStatistics_ = _mpStatistics;
-    }
-    if(mpMultilevelPatch_ == nullptr){
-      _mpMultilevelPatch = new MultilevelPatch<nLevels,patchSize>();
-      mpMultilevelPatch_ = _mpMultilevelPatch;
-    }
-  }
 };
 
 
@@ -135,9 +103,65 @@ template<int nLevels,int patchSize, int nCam,int nMax>
 class FeatureSetManager{
  public:
   FeatureManager<nLevels,patchSize,nCam> features_[nMax];  /**<Array of features.*/
-  bool isValid_[nMax];  /**<Array, defining if there is a valid MultilevelPatchFeature at the considered array index. */
+  SlotAllocator<nMax> validSlots_;  /**<Bitset, defining if there is a valid MultilevelPatchFeature at the considered array index. Iterating over it yields the valid indices. */
   int maxIdx_;  /**<Current maximum array/set index. Number of MultilevelPatchFeature, which have already been inserted into the set. */
   const MultiCamera<nCam>* mpMultiCamera_;
+  FeatureArena<nLevels,patchSize,nCam,nMax> arena_;  /**<Contiguous storage of the per-feature objects which are not linked externally.*/
+
+  /** \brief Reusable buffers of addBestCandidatesNew().
+   */
+  struct CandidateBuffers{
+    std::vector<MultilevelPatch<nLevels,patchSize>> multilevelPatches_;  /**<Pool of extracted MultilevelPatches (only grows).*/
+    std::vector<int> candidateIndices_;  /**<Candidate index of every kept MultilevelPatch.*/
+    std::vector<int> cells_;  /**<Weight grid cell of every kept MultilevelPatch.*/
+    std::vector<int> order_;  /**<Indices of the kept MultilevelPatches, sorted by decreasing Shi-Tomasi Score.*/
+    std::vector<double> weight_;  /**<Weight of every grid cell.*/
+    std::vector<double> kernel_;  /**<Weight increase of the cells around a feature ((2*kernelRange_+1)^2 cells).*/
+    std::vector<cv::Point2f> existingPixels_;  /**<Pixel coordinates of the existing features.*/
+    int kernelRange_ = 0;  /**<Range of the weight kernel [cells].*/
+    int kernelCellSize_ = 0;  /**<Parameters for which kernel_ has been computed.*/
+    double kernelPenaltyDistance_ = 0.0;
+    double kernelZeroDistancePenalty_ = 0.0;
+
+    /** \brief Computes the weight kernel, if the parameters changed.
+     *
+     * @param cellSize            - Edge length of a grid cell [pix].
+     * @param penaltyDistance     - Distance at which the weight increase vanishes [pix].
+     * @param zeroDistancePenalty - Weight increase at zero distance.
+     */
+    void setWeightKernel(const int cellSize, const double penaltyDistance, const double zeroDistancePenalty){
+      if(!kernel_.empty() && cellSize == kernelCellSize_ && penaltyDistance == kernelPenaltyDistance_ && zeroDistancePenalty == kernelZeroDistancePenalty_) return;
+      kernelCellSize_ = cellSize;
+      kernelPenaltyDistance_ = penaltyDistance;
+      kernelZeroDistancePenalty_ = zeroDistancePenalty;
+      kernelRange_ = std::max(static_cast<int>(penaltyDistance/cellSize),0);
+      const int width = 2*kernelRange_+1;
+      kernel_.resize(width*width);
+      for(int y=-kernelRange_;y<=kernelRange_;y++){
+        for(int x=-kernelRange_;x<=kernelRange_;x++){
+          const double d = std::sqrt(x*x+y*y)*cellSize;
+          kernel_[(y+kernelRange_)*width+x+kernelRange_] = penaltyDistance > 0 ? std::max(1.0-d/penaltyDistance,0.0)*zeroDistancePenalty : zeroDistancePenalty;
+        }
+      }
+    }
+
+    /** \brief Adds the weight kernel around a cell.
+     *
+     * @param xc     - Cell x-index (may lie outside of the grid).
+     * @param yc     - Cell y-index (may lie outside of the grid).
+     * @param nCellX - Number of cells along x.
+     * @param nCellY - Number of cells along y.
+     */
+    void addWeight(const int xc, const int yc, const int nCellX, const int nCellY){
+      const int width = 2*kernelRange_+1;
+      for(int y=std::max(yc-kernelRange_,0);y<std::min(yc+kernelRange_+1,nCellY);y++){
+        for(int x=std::max(xc-kernelRange_,0);x<std::min(xc+kernelRange_+1,nCellX);x++){
+          weight_[y*nCellX+x] += kernel_[(y-yc+kernelRange_)*width+x-xc+kernelRange_];
+        }
+      }
+    }
+  };
+  std::shared_ptr<CandidateBuffers> candidateBuffers_;  /**<Buffers of addBestCandidatesNew() (created on first use). Shared by copies, which must thus not add candidates concurrently.*/
 
   /** \brief Constructor
    */
@@ -150,11 +174,15 @@ class FeatureSetManager{
      */
   virtual ~FeatureSetManager(){}
 
-  /** \brief Allocates all pointer which are still nullptr
+  /** \brief Links all pointer which are still nullptr to the corresponding slot of the \ref arena_
    */
   void allocateMissing(){
     for(unsigned int i=0;i<nMax;i++){
-      features_[i].allocateMissing();
+      FeatureManager<nLevels,patchSize,nCam>& f = features_[i];
+      if(f.mpCoordinates_ == nullptr) f.mpCoordinates_ = &arena_.coordinates(i);
+      if(f.mpDistance_ == nullptr) f.mpDistance_ = &arena_.distance(i);
+      if(f.mpStatistics_ == nullptr) f.mpStatistics_ = &arena_.statistics(i);
+      if(f.mpMultilevelPatch_ == nullptr) f.mpMultilevelPatch_ = &arena_.multilevelPatch(i);
     }
   }
 
@@ -182,9 +210,23 @@ class FeatureSetManager{
    */
   void reset(){
     maxIdx_ = 0;
-    for(unsigned int i=0;i<nMax;i++){
-      isValid_[i] = false;
-    }
+    validSlots_.reset();
+  }
+
+  /** \brief Is there a valid MultilevelPatchFeature at the given array/set index?
+   *
+   * @param ind - Array/set index.
+   */
+  bool isValid(const int ind) const{
+    return validSlots_.isOccupied(ind);
+  }
+
+  /** \brief Removes the MultilevelPatchFeature at the given array/set index from the set.
+   *
+   * @param ind - Array/set index.
+   */
+  void removeFeature(const int ind){
+    validSlots_.release(ind);
   }
 
   /** \brief Resets the MultilevelPatchSet.
@@ -193,13 +235,7 @@ class FeatureSetManager{
    * @return true, if a free index was found.
    */
   bool getFreeIndex(int& ind) const{
-    for(unsigned int i=0;i<nMax;i++){
-      if(isValid_[i] == false){
-        ind = i;
-        return true;
-      }
-    }
-    return false;
+    return validSlots_.getFree(ind);
   }
 
   /** \brief Get the number of valid MultilevelPatchFeature in the set.
@@ -207,11 +243,7 @@ class FeatureSetManager{
    * @return the number of valid MultilevelPatchFeature in the set.
    */
   int getValidCount() const{
-    int count = 0;
-    for(unsigned int i=0;i<nMax;i++){
-      if(isValid_[i] == true) ++count;
-    }
-    return count;
+    return validSlots_.count();
   }
 
   /** \brief Makes a new feature
@@ -223,7 +255,7 @@ class FeatureSetManager{
     int newInd = -1;
     if(getFreeIndex(newInd)){
       features_[newInd].idx_ = maxIdx_++;
-      isValid_[newInd] = true;
+      validSlots_.occupy(newInd);
     } else {
       std::cout << "Feature Manager: maximal number of feature reached" << std::endl;
     }
@@ -237,16 +269,102 @@ class FeatureSetManager{
   float getAverageScore(){
     float averageScore = 0;
     int count = 0;
-    for(unsigned int i=0;i<nMax;i++){
-      if(isValid_[i] == true){
-        averageScore += std::max(features_[i].mpMultilevelPatch_->s_,0.0f);
-        ++count;
-      }
+    for(const int i : validSlots_){
+      averageScore += std::max(features_[i].mpMultilevelPatch_->s_,0.0f);
+      ++count;
     }
     if(count>0) averageScore /= count;
     return averageScore;
   }
 
+  /** \brief Collects the pixel coordinates of all valid features which are in front of a given camera.
+   *
+   * @param camID  - %Camera ID
+   * @param pixels - Pixel coordinates of the features in camera camID (is overwritten).
+   */
+  void getPixelsInCamera(const int camID, std::vector<cv::Point2f>& pixels) const{
+    pixels.clear();
+    FeatureCoordinates featureCoordinates;
+    FeatureDistance featureDistance;
+    for(const int i : validSlots_){
+      mpMultiCamera_->transformFeature(camID,*(features_[i].mpCoordinates_),*(features_[i].mpDistance_),featureCoordinates,featureDistance);
+      if(featureCoordinates.isInFront() && featureCoordinates.com_c()){
+        pixels.push_back(featureCoordinates.get_c());
+      }
+    }
+  }
+
+  /** \brief Reduces a candidates list to the strongest candidates of every image grid cell.
+   *
+   *  The image is divided into square cells. Cells which already contain a valid feature of the set (transformed
+   *  into the considered camera) are skipped entirely, from all other cells at most maxPerCell candidates
+   *  with the highest response are kept. This bounds the number of candidates for which a full
+   *  MultilevelPatch has to be extracted in addBestCandidates. The order of the remaining candidates is preserved.
+   *
+   * @param candidates - List of candidate feature coordinates (pyramid level 0). Gets reduced in place.
+   * @param responses  - Detector response of every candidate (parallel to candidates). Gets reduced in place.
+   * @param imgSize    - Size of the image on pyramid level 0.
+   * @param camID      - %Camera ID
+   * @param cellSize   - Side length of a grid cell [pix]. Nothing is done if <= 0.
+   * @param maxPerCell - Maximal number of candidates kept per grid cell. Nothing is done if <= 0.
+   *
+   * @return the number of remaining candidates.
+   */
+  int preselectCandidates(std::vector<FeatureCoordinates>& candidates, std::vector<float>& responses, const cv::Size& imgSize, const int camID,
+                          const int cellSize, const int maxPerCell) const{
+    assert(candidates.size() == responses.size());
+    if(cellSize <= 0 || maxPerCell <= 0 || imgSize.width <= 0 || imgSize.height <= 0) return candidates.size();
+    const int nCellsX = (imgSize.width+cellSize-1)/cellSize;
+    const int nCellsY = (imgSize.height+cellSize-1)/cellSize;
+    auto getCell = [&](const cv::Point2f& c) -> int {
+      if(c.x < 0 || c.y < 0 || c.x >= imgSize.width || c.y >= imgSize.height) return -1;
+      return static_cast<int>(c.y)/cellSize*nCellsX+static_cast<int>(c.x)/cellSize;
+    };
+
+    // Mark cells which are already covered by existing features
+    std::vector<bool> occupied(nCellsX*nCellsY,false);
+    std::vector<cv::Point2f> pixels;
+    getPixelsInCamera(camID,pixels);
+    for(const cv::Point2f& p : pixels){
+      const int cell = getCell(p);
+      if(cell >= 0) occupied[cell] = true;
+    }
+
+    // Sort the candidates of the free cells by cell and decreasing response (ties resolved by list order)
+    std::vector<std::pair<int,int>> cellCandidates; // (cell, candidate index)
+    cellCandidates.reserve(candidates.size());
+    for(int i=0;i<candidates.size();i++){
+      const int cell = getCell(candidates[i].get_c());
+      if(cell >= 0 && !occupied[cell]) cellCandidates.emplace_back(cell,i);
+    }
+    std::sort(cellCandidates.begin(),cellCandidates.end(),[&](const std::pair<int,int>& a, const std::pair<int,int>& b){
+      if(a.first != b.first) return a.first < b.first;
+      if(responses[a.second] != responses[b.second]) return responses[a.second] > responses[b.second];
+      return a.second < b.second;
+    });
+
+    // Keep the top maxPerCell candidates of every cell
+    std::vector<bool> keep(candidates.size(),false);
+    int countInCell = 0;
+    for(int i=0;i<cellCandidates.size();i++){
+      countInCell = (i > 0 && cellCandidates[i].first == cellCandidates[i-1].first) ? countInCell+1 : 0;
+      if(countInCell < maxPerCell) keep[cellCandidates[i].second] = true;
+    }
+    int newSize = 0;
+    for(int i=0;i<candidates.size();i++){
+      if(keep[i]){
+        if(newSize != i){
+          candidates[newSize] = candidates[i];
+          responses[newSize] = responses[i];
+        }
+        ++newSize;
+      }
+    }
+    candidates.resize(newSize);
+    responses.resize(newSize);
+    return newSize;
+  }
+
   /** \brief Adds the best MultilevelPatchFeature%s from a candidates list to an existing MultilevelPatchSet.
    *
    *  This function takes a given feature candidate list and builds, in a first step,
@@ -260,6 +378,8 @@ class FeatureSetManager{
    *  to already existing features in the given MultilevelPatchSet. A small distance to an existing feature is punished,
    *  by moving the concerned candidate MultilevelPatchFeature into a lower bucket.
    *  Finally the existing MultilevelPatchSet is expanded with the best (high bucket index) candidate MultilevelPatchFeature%s.
+   *  Within a bucket, the candidates are added in the order of decreasing Shi-Tomasi Score. The bucketing and penalization
+   *  is done by a CandidateSelector.
    *
    * @param candidates             - List of candidate feature coordinates.
    * @param pyr                    - Image pyramid used to extract the MultilevelPatchFeature%s from the candidates list.
@@ -306,181 +426,134 @@ class FeatureSetManager{
       return newFeatureIDs;
     }
 
-    // Make buckets and fill based on score
-    std::vector<std::unordered_set<int>> buckets(nDetectionBuckets,std::unordered_set<int>());
-    unsigned int newBucketID;
-    float relScore;
+    // Select the best candidates (bucketing by score and penalization of candidates close to existing/added features)
+    std::vector<cv::Point2f> pixels(candidates.size());
+    std::vector<float> scores(candidates.size());
     for(int i=0;i<candidates.size();i++){
-      relScore = (multilevelPatches[i].s_-minScore)/(maxScore-minScore);
-      if(relScore > 0.0){
-        newBucketID = std::ceil((nDetectionBuckets-1)*(pow(relScore,static_cast<float>(scoreDetectionExponent))));
-        if(newBucketID>nDetectionBuckets-1) newBucketID = nDetectionBuckets-1;
-        buckets[newBucketID].insert(i);
-      }
+      pixels[i] = candidates[i].get_c();
+      scores[i] = multilevelPatches[i].s_;
     }
-
-    // Move buckets based on current features
-    double d2;
-    double t2 = pow(penaltyDistance,2);
-    bool doDelete;
-    FeatureCoordinates featureCoordinates;
-    FeatureDistance featureDistance;
-    for(unsigned int i=0;i<nMax;i++){
-      if(isValid_[i]){
-        mpMultiCamera_->transformFeature(camID,*(features_[i].mpCoordinates_),*(features_[i].mpDistance_),featureCoordinates,featureDistance);
-        if(featureCoordinates.isInFront()){
-          for (unsigned int bucketID = 1;bucketID < nDetectionBuckets;bucketID++) {
-            for (auto it_cand = buckets[bucketID].begin();it_cand != buckets[bucketID].end();) {
-              doDelete = false;
-              d2 = std::pow(featureCoordinates.get_c().x - candidates[*it_cand].get_c().x,2) + std::pow(featureCoordinates.get_c().y - candidates[*it_cand].get_c().y,2);  // Squared distance between the existing feature and the candidate feature.
-              if(d2<t2){
-                newBucketID = std::max((int)(bucketID - (t2-d2)/t2*zeroDistancePenalty),0);
-                if(bucketID != newBucketID){
-                  buckets[newBucketID].insert(*it_cand);
-                  doDelete = true;
-                }
-              }
-              if(doDelete){
-                buckets[bucketID].erase(it_cand++);
-              } else {
-                ++it_cand;
-              }
-            }
-          }
-        }
-      }
-    }
-
-    // Incrementally add features and update candidate buckets (Check distance of candidates with respect to the newly inserted feature).
-    int addedCount = 0;
-    for (int bucketID = nDetectionBuckets-1;bucketID >= 0+static_cast<int>(!requireMax);bucketID--) {
-      while(!buckets[bucketID].empty() && addedCount < maxAddedFeature && getValidCount() != nMax) {
-        const int nf = *(buckets[bucketID].begin());
-        buckets[bucketID].erase(nf);
-        const int ind = makeNewFeature(camID);
+    std::vector<cv::Point2f> existingPixels;
+    getPixelsInCamera(camID,existingPixels);
+    std::vector<int> selected;
+    CandidateSelector selector;
+    selector.select(pixels,scores,minScore,maxScore,existingPixels,std::min(maxAddedFeature,static_cast<int>(nMax)-getValidCount()),
+                    nDetectionBuckets,scoreDetectionExponent,penaltyDistance,zeroDistancePenalty,requireMax,selected);
+
+    // Add the selected candidates as new features
+    for(const int nf : selected){
+      const int ind = makeNewFeature(camID);
+      if(ind >= 0){
         features_[ind].mpCoordinates_->set_c(candidates[nf].get_c());
         features_[ind].mpCoordinates_->camID_ = camID;
         features_[ind].mpCoordinates_->set_warp_identity();
         features_[ind].mpCoordinates_->mpCamera_ = &mpMultiCamera_->cameras_[camID];
         *(features_[ind].mpMultilevelPatch_) = multilevelPatches[nf];
-        if(ind >= 0){
-          newFeatureIDs.insert(ind);
-        }
-        addedCount++;
-        for (unsigned int bucketID2 = 1;bucketID2 <= bucketID;bucketID2++) {
-          for (auto it_cand = buckets[bucketID2].begin();it_cand != buckets[bucketID2].end();) {
-            doDelete = false;
-            d2 = std::pow(candidates[nf].get_c().x - candidates[*it_cand].get_c().x,2) + std::pow(candidates[nf].get_c().y - candidates[*it_cand].get_c().y,2);
-            if(d2<t2){
-              newBucketID = std::max((int)(bucketID2 - (t2-d2)/t2*zeroDistancePenalty),0);
-              if(bucketID2 != newBucketID){
-                buckets[newBucketID].insert(*it_cand);
-                doDelete = true;
-              }
-            }
-            if(doDelete){
-              buckets[bucketID2].erase(it_cand++);
-            } else {
-              ++it_cand;
-            }
-          }
-        }
+        newFeatureIDs.insert(ind);
       }
     }
 
     return newFeatureIDs;
   }
 
-  static bool isFirstMPBetter(const std::tuple<const FeatureCoordinates*,MultilevelPatch<nLevels,patchSize>,int>& mp1, const std::tuple<const FeatureCoordinates*,MultilevelPatch<nLevels,patchSize>,int>&mp2){
-    return std::get<1>(mp1).s_ > std::get<1>(mp2).s_;
-  }
-
+  /** \brief Adds the best MultilevelPatchFeature%s from a candidates list, using a weight grid for the spatial distribution.
+   *
+   *  The candidates are sorted by their Shi-Tomasi Score and added in this order. The image is divided into cells of 10x10 pixels.
+   *  Every existing or added feature increases the weight of the cells around it (by zeroDistancePenalty at zero distance,
+   *  decreasing linearly to zero at penaltyDistance). Candidates in cells with a weight of 100 or more are skipped.
+   *  All buffers are kept in \ref candidateBuffers_ and reused for the next call, such that no memory is allocated once they
+   *  have grown to the required size (besides the returned set).
+   *
+   * @param candidates          - List of candidate feature coordinates.
+   * @param pyr                 - Image pyramid used to extract the MultilevelPatchFeature%s from the candidates list.
+   * @param camID               - %Camera ID
+   * @param initTime            - Current time (time at which the MultilevelPatchFeature%s are created from the candidates list).
+   * @param l1                  - Start pyramid level for the Shi-Tomasi Score computation of MultilevelPatchFeature%s extracted from the candidates list.
+   * @param l2                  - End pyramid level for the Shi-Tomasi Score computation of MultilevelPatchFeature%s extracted from the candidates list.
+   * @param maxAddedFeature     - Maximal number of features which should be added to the mlpSet.
+   * @param nDetectionBuckets   - Unused, for interface compatibility with addBestCandidates().
+   * @param scoreDetectionExponent - Unused, for interface compatibility with addBestCandidates().
+   * @param penaltyDistance     - Distance up to which a feature increases the weight of the surrounding cells [pix].
+   * @param zeroDistancePenalty - Weight increase of the cell of a feature.
+   * @param requireMax          - Unused, for interface compatibility with addBestCandidates().
+   * @param minScore            - Minimal Shi-Tomasi Score of a candidate.
+   *
+   * @return an unordered_set, holding the indizes of the MultilevelPatchSet, at which the new MultilevelPatchFeature%s have been added (from the candidates list).
+   */
   std::unordered_set<unsigned int> addBestCandidatesNew(const std::vector<FeatureCoordinates>& candidates, const ImagePyramid<nLevels>& pyr, const int camID, const double initTime,
                                                        const int l1, const int l2, const int maxAddedFeature, const int nDetectionBuckets, const double scoreDetectionExponent,
                                                        const double penaltyDistance, const double zeroDistancePenalty, const bool requireMax, const float minScore){
       std::unordered_set<unsigned int> newFeatureIDs;
-      std::list<std::tuple<const FeatureCoordinates*,MultilevelPatch<nLevels,patchSize>,int>> multilevelPatches;
+      if(!candidateBuffers_) candidateBuffers_.reset(new CandidateBuffers());
+      CandidateBuffers& buffers = *candidateBuffers_;
 
       const int cellSize = 10;
-      const int nCellX = (pyr.imgs_[0].cols-1)/cellSize+1;
-      const int nCellY = (pyr.imgs_[0].rows-1)/cellSize+1;
-      const int nCell = nCellX*nCellY;
-      const int nRange = penaltyDistance/cellSize;
-
-      double weight[nCell];
-      for(int x=0;x<nCellX;x++){
-        for(int y=0;y<nCellY;y++){
-          weight[x*nCellY+y] = 0.0;
-        }
-      }
-      std::unordered_set<int> multilevelPatchBuckets[nCell];
-
-      // Compute all multilevelPatches including shi-tomasi scores and add bucket ID
-      float maxScore = -1.0;
+      const int nCellX = (pyr.sizes_[0].width-1)/cellSize+1;
+      const int nCellY = (pyr.sizes_[0].height-1)/cellSize+1;
+      buffers.weight_.assign(nCellX*nCellY,0.0);
+      buffers.setWeightKernel(cellSize,penaltyDistance,zeroDistancePenalty);
+
+      // Compute all multilevelPatches including shi-tomasi scores and grid cell (into the pooled buffer)
+      int count = 0;
+      buffers.candidateIndices_.clear();
+      buffers.cells_.clear();
       for(int i=0;i<candidates.size();i++){
         if(MultilevelPatch<nLevels,patchSize>::isMultilevelPatchInFrame(pyr,candidates[i],l2,true)){
-          multilevelPatches.emplace_back();
-          std::get<1>(multilevelPatches.back()).extractMultilevelPatchFromImage(pyr,candidates[i],l2,true);
-          std::get<1>(multilevelPatches.back()).computeMultilevelShiTomasiScore(l1,l2);
-          if(std::get<1>(multilevelPatches.back()).s_ < minScore){
-            multilevelPatches.pop_back();
-          } else {
-            std::get<0>(multilevelPatches.back()) = &candidates[i];
-            const int xc = candidates[i].get_c().x/cellSize;
-            const int yc = candidates[i].get_c().y/cellSize;
-            std::get<2>(multilevelPatches.back()) = xc*nCellY+yc;
+          if(count == buffers.multilevelPatches_.size()) buffers.multilevelPatches_.emplace_back();
+          MultilevelPatch<nLevels,patchSize>& mp = buffers.multilevelPatches_[count];
+          mp.extractMultilevelPatchFromImage(pyr,candidates[i],l2,true);
+          mp.computeMultilevelShiTomasiScore(l1,l2);
+          if(mp.s_ >= minScore){
+            buffers.candidateIndices_.push_back(i);
+            buffers.cells_.push_back(static_cast<int>(candidates[i].get_c().y/cellSize)*nCellX+static_cast<int>(candidates[i].get_c().x/cellSize));
+            count++;
           }
         }
       }
-      if(multilevelPatches.size() <= 0){ // TODO: check
+      if(count == 0){
         return newFeatureIDs;
       }
 
-      // Sort the vector
-      multilevelPatches.sort(isFirstMPBetter);
+      // Sort the indices by decreasing score (ties resolved by the candidate order)
+      buffers.order_.resize(count);
+      for(int k=0;k<count;k++){
+        buffers.order_[k] = k;
+      }
+      std::sort(buffers.order_.begin(),buffers.order_.end(),[&buffers](const int a, const int b){
+        const float sa = buffers.multilevelPatches_[a].s_;
+        const float sb = buffers.multilevelPatches_[b].s_;
+        return sa != sb ? sa > sb : a < b;
+      });
 
       // Compute weights based on current feature distribution
-      FeatureCoordinates featureCoordinates;
-      FeatureDistance featureDistance;
-      for(unsigned int i=0;i<nMax;i++){
-        if(isValid_[i]){
-          mpMultiCamera_->transformFeature(camID,*(features_[i].mpCoordinates_),*(features_[i].mpDistance_),featureCoordinates,featureDistance);
-          if(featureCoordinates.isInFront()){
-            const int xc = featureCoordinates.get_c().x/cellSize;
-            const int yc = featureCoordinates.get_c().y/cellSize;
-            for(int x=std::max(xc-nRange,0);x<std::min(xc+nRange+1,nCellX);x++){
-              for(int y=std::max(yc-nRange,0);y<std::min(yc+nRange+1,nCellY);y++){
-                weight[x*nCellY+y] += std::max(1.0-std::sqrt((x-xc)*(x-xc)+(y-yc)*(y-yc))/penaltyDistance,0.0)*zeroDistancePenalty;
-              }
-            }
-          }
+      getPixelsInCamera(camID,buffers.existingPixels_);
+      for(const cv::Point2f& p : buffers.existingPixels_){
+        const float xc = std::floor(p.x/cellSize);
+        const float yc = std::floor(p.y/cellSize);
+        if(xc+buffers.kernelRange_ >= 0 && xc-buffers.kernelRange_ < nCellX && yc+buffers.kernelRange_ >= 0 && yc-buffers.kernelRange_ < nCellY){
+          buffers.addWeight(xc,yc,nCellX,nCellY);
         }
       }
 
-      // Go through list: add highest, increase bucket weighting, remove all candidates of all buckets which are above 100
+      // Go through list: add highest, increase cell weighting, skip all candidates in cells with a weight of 100 or more
       int addedCount = 0;
-      for(typename std::list<std::tuple<const FeatureCoordinates*,MultilevelPatch<nLevels,patchSize>,int>>::iterator it=multilevelPatches.begin(); it!=multilevelPatches.end() && addedCount < maxAddedFeature; ++it){
-        int bucketID = std::get<2>(*it);
-        if(weight[bucketID] < 100.0){
+      for(int k=0;k<count && addedCount < maxAddedFeature && getValidCount() != nMax;k++){
+        const int mpIdx = buffers.order_[k];
+        const int cell = buffers.cells_[mpIdx];
+        if(buffers.weight_[cell] < 100.0){
           const int ind = makeNewFeature(camID);
-          features_[ind].mpCoordinates_->set_c(std::get<0>(*it)->get_c());
+          if(ind < 0) break;
+          const FeatureCoordinates& c = candidates[buffers.candidateIndices_[mpIdx]];
+          features_[ind].mpCoordinates_->set_c(c.get_c());
           features_[ind].mpCoordinates_->camID_ = camID;
           features_[ind].mpCoordinates_->set_warp_identity();
           features_[ind].mpCoordinates_->mpCamera_ = &mpMultiCamera_->cameras_[camID];
-          *(features_[ind].mpMultilevelPatch_) = std::get<1>(*it);
-          if(ind >= 0){
-            newFeatureIDs.insert(ind);
-          }
+          *(features_[ind].mpMultilevelPatch_) = buffers.multilevelPatches_[mpIdx];
+          newFeatureIDs.insert(ind);
           addedCount++;
 
-          // Increse Bucket weights
-          const int xc = bucketID/nCellY;
-          const int yc = bucketID%nCellY;
-          for(int x=std::max(xc-nRange,0);x<std::min(xc+nRange+1,nCellX);x++){
-            for(int y=std::max(yc-nRange,0);y<std::min(yc+nRange+1,nCellY);y++){
-              weight[x*nCellY+y] += std::max(1.0-std::sqrt((x-xc)*(x-xc)+(y-yc)*(y-yc))/penaltyDistance,0.0)*zeroDistancePenalty;
-            }
-          }
+          // Increase cell weights
+          buffers.addWeight(cell%nCellX,cell/nCellX,nCellX,nCellY);
         }
       }
 
@@ -29,6 +29,9 @@
 #ifndef FEATURESTATISTICS_HPP_
 #define FEATURESTATISTICS_HPP_
 
+#include <algorithm>
+#include <array>
+
 namespace rovio{
 
 /** \brief Defines the tracking status of a MultilevelPatchFeature.
@@ -42,8 +45,17 @@ enum TrackingStatus{
   FAILED_TRACKING, /**< The tracking in the filter failed, e.g. outlier*/
   TRACKED /**< Successfull tracking with filter*/
 };
+static const int nTrackingStatus = TRACKED+1;  /**<Number of different TrackingStatus.*/
 
-template<int nCam>
+/** \brief Tracking statistics of a MultilevelPatchFeature.
+ *
+ *  The windowed counts (countTrackingStatistics() with n > 0) are based on a fixed-capacity ring buffer over the last nHistory
+ *  frames, such that copying the statistics (e.g. with the filter state) does not allocate.
+ *
+ *  @tparam nCam     - Number of cameras.
+ *  @tparam nHistory - Number of frames kept in the history. Windows over more frames are limited to the last nHistory+1 frames.
+ */
+template<int nCam, int nHistory = 100>
 class FeatureStatistics{
  public:
   double initTime_;  /**<Time of feature initialization.*/
@@ -67,14 +79,17 @@ class FeatureStatistics{
 
 
   TrackingStatus status_[nCam];  /**<MultilevelPatchFeature tracking and mapping status.*/
-  std::map<TrackingStatus,int> cumulativeTrackingStatus_[nCam];  /**< Count for specific tracking status.*/
-  std::map<double,TrackingStatus> statistics_[nCam];  /**< Accumulation of status (index is the time)*/
+  int cumulativeTrackingStatus_[nCam][nTrackingStatus];  /**< Count for specific tracking status.*/
+  std::array<std::array<int,nTrackingStatus>,nHistory> history_[nCam];  /**< Ring buffer over the last frames, holding \ref cumulativeTrackingStatus_ as it was before the
+                                                                             corresponding frame was stored. The count within the last m frames is thus a single difference.*/
+  int historyCount_;  /**< Number of frames stored into \ref history_ since the last reset (the newest frame is at (historyCount_-1)%nHistory).*/
 
   /** \brief Constructor.
    *
    *  Initializes the feature statistics
    * */
   FeatureStatistics(const double& currentTime = 0.0){
+    static_assert(nHistory > 0,"FeatureStatistics nHistory must be positive");
     resetStatistics(currentTime);
     localQualityRange_ = 10;
     localVisibilityRange_ = 100;
@@ -86,15 +101,13 @@ class FeatureStatistics{
    */
   void resetStatistics(const double& currentTime){
     for(int i=0;i<nCam;i++){
-      cumulativeTrackingStatus_[i][UNKNOWN] = 0;
-      cumulativeTrackingStatus_[i][NOT_IN_FRAME] = 0;
-      cumulativeTrackingStatus_[i][FAILED_ALIGNEMENT] = 0;
-      cumulativeTrackingStatus_[i][FAILED_TRACKING] = 0;
-      cumulativeTrackingStatus_[i][TRACKED] = 0;
-      statistics_[i].clear();
+      for(int s=0;s<nTrackingStatus;s++){
+        cumulativeTrackingStatus_[i][s] = 0;
+      }
       status_[i] = UNKNOWN;
       localQuality_[i] = 1.0;
     }
+    historyCount_ = 0;
     totCount_ = 0;
     trackedCount_ = 0;
     initTime_ = currentTime;
@@ -102,6 +115,13 @@ class FeatureStatistics{
     localVisibility_ = 1.0;
   }
 
+  /** \brief Returns the number of frames kept in \ref history_. It does not depend on the evaluation ranges, such that
+   *         changing them keeps the history.
+   */
+  int historySize() const{
+    return nHistory;
+  }
+
   /** \brief Increases the MultilevelPatchFeature statistics and resets the \ref status_.
    *
    * @param currentTime - Current time.
@@ -119,6 +139,8 @@ class FeatureStatistics{
       localVisibility_ = localVisibility_*(1-1.0/localVisibilityRange_);
     }
 
+    const int historyIdx = historyCount_%nHistory;
+
     for(int i=0;i<nCam;i++){
       // Increase local quality
       if(status_[i] == TRACKED){
@@ -128,10 +150,11 @@ class FeatureStatistics{
       }
 
       // Store
+      std::copy(cumulativeTrackingStatus_[i],cumulativeTrackingStatus_[i]+nTrackingStatus,history_[i][historyIdx].begin());
       cumulativeTrackingStatus_[i][status_[i]]++;
-      statistics_[i][currentTime_] = status_[i];
       status_[i] = UNKNOWN;
     }
+    historyCount_++;
     totCount_++;
     currentTime_ = currentTime;
   }
@@ -140,7 +163,7 @@ class FeatureStatistics{
    *
    * @param s - \ref TrackingStatus of interest.
    * @param camID - \ref Camera ID of camera of interest. If -1 (or not specified) counts for all camera.
-   * @param n - \ref Last n frames. If 0 (or not specified) counts for all frames.
+   * @param n - \ref Last n frames. If 0 (or not specified) counts for all frames. At most nHistory+1 frames are considered.
    * @return the number of how many times the \ref TrackingStatus s occured.
    */
   int countTrackingStatistics(const TrackingStatus s, const int camID = -1, const int n = 0) const{
@@ -155,16 +178,13 @@ class FeatureStatistics{
       startID = camID;
       endID = camID;
     }
+    // Number of stored frames to consider and index of the oldest one in the history
+    const int m = std::min(n-1,std::min(historyCount_,nHistory));
+    const int oldestIdx = m > 0 ? (historyCount_-m)%nHistory : 0;
     for(int i=startID;i<=endID;i++){
-      if(n==0){
-        count += cumulativeTrackingStatus_[i].at(s) + (int)(status_[i] == s);
-      } else {
-        auto it = statistics_[i].rbegin();
-        for(int j=0;j<n-1 && it != statistics_[i].rend();++j){
-          if(it->second == s) count++;
-          ++it;
-        }
-        count += (int)(status_[i] == s);
+      count += cumulativeTrackingStatus_[i][s] + (int)(status_[i] == s);
+      if(n!=0){
+        count -= m > 0 ? history_[i][oldestIdx][s] : cumulativeTrackingStatus_[i][s];
       }
     }
     return count;
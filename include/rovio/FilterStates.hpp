@@ -626,19 +626,17 @@ class FilterState: public LWF::FilterState<State<nMax,nLevels,patchSize,nCam,nPo
     medianDistanceParameters->fill(initDistanceParameter);
     // Collect the distance values of the features for each camera frame.
     std::vector<double> distanceParameterCollection[nCam];
-    for (unsigned int i = 0; i < nMax; i++) {
-      if (fsm_.isValid_[i]) {
-        for(int camID = 0;camID<nCam;camID++){
-          transformFeatureOutputCT_.setFeatureID(i);
-          transformFeatureOutputCT_.setOutputCameraID(camID);
-          transformFeatureOutputCT_.transformState(state_, featureOutput_);
-          if(featureOutput_.c().isInFront()){
-            transformFeatureOutputCT_.transformCovMat(state_, cov_, featureOutputCov_);
-            const double uncertainty = sqrt(featureOutputCov_(2,2))*featureOutput_.d().getDistanceDerivative();
-            const double depth = fsm_.features_[i].mpDistance_->getDistance();
-            if(uncertainty/depth > maxUncertaintyToDistanceRatio){
-              distanceParameterCollection[camID].push_back(featureOutput_.d().p_);
-            }
+    for(const int i : fsm_.validSlots_){
+      for(int camID = 0;camID<nCam;camID++){
+        transformFeatureOutputCT_.setFeatureID(i);
+        transformFeatureOutputCT_.setOutputCameraID(camID);
+        transformFeatureOutputCT_.transformState(state_, featureOutput_);
+        if(featureOutput_.c().isInFront()){
+          transformFeatureOutputCT_.transformCovMat(state_, cov_, featureOutputCov_);
+          const double uncertainty = sqrt(featureOutputCov_(2,2))*featureOutput_.d().getDistanceDerivative();
+          const double depth = fsm_.features_[i].mpDistance_->getDistance();
+          if(uncertainty/depth > maxUncertaintyToDistanceRatio){
+            distanceParameterCollection[camID].push_back(featureOutput_.d().p_);
           }
         }
       }
@@ -33,77 +33,383 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 #include "rovio/FeatureCoordinates.hpp"
+#include "rovio/PatchCoordinates.hpp"
+#include "rovio/PatchInterpolation.hpp"
 
 namespace rovio{
 
-/** \brief Halfsamples an image.
+/** \brief Halfsamples a single image row (2x2 box filter, truncating integer average), one pixel at a time.
  *
- *   @param imgIn - Input image.
+ *   @param top  - Pointer to the upper input row.
+ *   @param bot  - Pointer to the lower input row.
+ *   @param out  - Pointer to the output row.
+ *   @param x0   - First output pixel to be computed.
+ *   @param cols - Number of output pixels.
+ */
+inline void halfSampleRowScalar(const uint8_t* top, const uint8_t* bot, uint8_t* out, const int x0, const int cols){
+  for(int x=x0; x<cols; ++x){
+    out[x] = (top[2*x]+top[2*x+1]+bot[2*x]+bot[2*x+1])/4;
+  }
+}
+
+#ifdef ROVIO_X86_SIMD
+/** \brief SSE2 version of halfSampleRowScalar(), 16 output pixels per iteration.
+ *
+ *  The horizontal pairs are summed in 16 bit (even bytes masked, odd bytes shifted down), such that the result is bit-identical
+ *  to the scalar kernel (a pavgb cascade would round twice).
+ */
+__attribute__((target("sse2")))
+inline void halfSampleRowSSE2(const uint8_t* top, const uint8_t* bot, uint8_t* out, const int cols){
+  const __m128i mask = _mm_set1_epi16(0x00FF);
+  int x=0;
+  for(; x+16<=cols; x+=16){
+    const __m128i t0 = _mm_loadu_si128((const __m128i*)(top+2*x));
+    const __m128i t1 = _mm_loadu_si128((const __m128i*)(top+2*x+16));
+    const __m128i b0 = _mm_loadu_si128((const __m128i*)(bot+2*x));
+    const __m128i b1 = _mm_loadu_si128((const __m128i*)(bot+2*x+16));
+    const __m128i s0 = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(t0,mask),_mm_srli_epi16(t0,8)),
+                                     _mm_add_epi16(_mm_and_si128(b0,mask),_mm_srli_epi16(b0,8)));
+    const __m128i s1 = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(t1,mask),_mm_srli_epi16(t1,8)),
+                                     _mm_add_epi16(_mm_and_si128(b1,mask),_mm_srli_epi16(b1,8)));
+    _mm_storeu_si128((__m128i*)(out+x),_mm_packus_epi16(_mm_srli_epi16(s0,2),_mm_srli_epi16(s1,2)));
+  }
+  halfSampleRowScalar(top,bot,out,x,cols);
+}
+
+/** \brief AVX2 version of halfSampleRowScalar(), 32 output pixels per iteration.
+ */
+__attribute__((target("avx2")))
+inline void halfSampleRowAVX2(const uint8_t* top, const uint8_t* bot, uint8_t* out, const int cols){
+  const __m256i mask = _mm256_set1_epi16(0x00FF);
+  int x=0;
+  for(; x+32<=cols; x+=32){
+    const __m256i t0 = _mm256_loadu_si256((const __m256i*)(top+2*x));
+    const __m256i t1 = _mm256_loadu_si256((const __m256i*)(top+2*x+32));
+    const __m256i b0 = _mm256_loadu_si256((const __m256i*)(bot+2*x));
+    const __m256i b1 = _mm256_loadu_si256((const __m256i*)(bot+2*x+32));
+    const __m256i s0 = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(t0,mask),_mm256_srli_epi16(t0,8)),
+                                        _mm256_add_epi16(_mm256_and_si256(b0,mask),_mm256_srli_epi16(b0,8)));
+    const __m256i s1 = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(t1,mask),_mm256_srli_epi16(t1,8)),
+                                        _mm256_add_epi16(_mm256_and_si256(b1,mask),_mm256_srli_epi16(b1,8)));
+    const __m256i packed = _mm256_packus_epi16(_mm256_srli_epi16(s0,2),_mm256_srli_epi16(s1,2)); // Packs within 128 bit lanes
+    _mm256_storeu_si256((__m256i*)(out+x),_mm256_permute4x64_epi64(packed,0xD8));
+  }
+  halfSampleRowSSE2(top+2*x,bot+2*x,out+x,cols-x);
+}
+#endif
+
+/** \brief Halfsamples an image (2x2 box filter).
+ *
+ *   @param imgIn  - Input image.
  *   @param imgOut - Output image (halfsampled).
+ *   @param kernel - Instruction set to be used (all kernels yield identical results).
  */
-void halfSample(const cv::Mat& imgIn,cv::Mat& imgOut){
+inline void halfSample(const cv::Mat& imgIn,cv::Mat& imgOut, const InterpolationKernel kernel = activeInterpolationKernel()){
   imgOut.create(imgIn.rows/2,imgIn.cols/2,imgIn.type());
   const int refStepIn = imgIn.step.p[0];
   const int refStepOut = imgOut.step.p[0];
-  uint8_t* imgPtrInTop;
-  uint8_t* imgPtrInBot;
-  uint8_t* imgPtrOut;
   for(int y=0; y<imgOut.rows; ++y){
-    imgPtrInTop =  imgIn.data + 2*y*refStepIn;
-    imgPtrInBot =  imgIn.data + (2*y+1)*refStepIn;
-    imgPtrOut = imgOut.data + y*refStepOut;
-    for(int x=0; x<imgOut.cols; ++x, ++imgPtrOut, imgPtrInTop += 2, imgPtrInBot += 2)
-    {
-      *imgPtrOut = (imgPtrInTop[0]+imgPtrInTop[1]+imgPtrInBot[0]+imgPtrInBot[1])/4;
+    const uint8_t* imgPtrInTop = imgIn.data + 2*y*refStepIn;
+    const uint8_t* imgPtrInBot = imgIn.data + (2*y+1)*refStepIn;
+    uint8_t* imgPtrOut = imgOut.data + y*refStepOut;
+    switch(kernel){
+#ifdef ROVIO_X86_SIMD
+      case KERNEL_AVX2:
+        halfSampleRowAVX2(imgPtrInTop,imgPtrInBot,imgPtrOut,imgOut.cols);
+        break;
+      case KERNEL_SSE2:
+        halfSampleRowSSE2(imgPtrInTop,imgPtrInBot,imgPtrOut,imgOut.cols);
+        break;
+#endif
+      default:
+        halfSampleRowScalar(imgPtrInTop,imgPtrInBot,imgPtrOut,0,imgOut.cols);
+    }
+  }
+}
+
+/** \brief Computes the central difference gradients of a single image row, one pixel at a time.
+ *
+ *   @param top  - Pointer to the row above.
+ *   @param mid  - Pointer to the row.
+ *   @param bot  - Pointer to the row below.
+ *   @param gx   - Output row of the gradient in x-direction (twice the central difference).
+ *   @param gy   - Output row of the gradient in y-direction (twice the central difference).
+ *   @param x0   - First pixel to be computed (>= 1).
+ *   @param x1   - Last pixel to be computed + 1 (<= cols-1).
+ */
+inline void computeGradientRowScalar(const uint8_t* top, const uint8_t* mid, const uint8_t* bot, int16_t* gx, int16_t* gy, const int x0, const int x1){
+  for(int x=x0; x<x1; ++x){
+    gx[x] = mid[x+1]-mid[x-1];
+    gy[x] = bot[x]-top[x];
+  }
+}
+
+#ifdef ROVIO_X86_SIMD
+/** \brief SSE2 version of computeGradientRowScalar(), 16 pixels per iteration.
+ */
+__attribute__((target("sse2")))
+inline void computeGradientRowSSE2(const uint8_t* top, const uint8_t* mid, const uint8_t* bot, int16_t* gx, int16_t* gy, const int x1){
+  const __m128i zero = _mm_setzero_si128();
+  int x=1;
+  for(; x+16<=x1; x+=16){
+    const __m128i l = _mm_loadu_si128((const __m128i*)(mid+x-1));
+    const __m128i r = _mm_loadu_si128((const __m128i*)(mid+x+1));
+    const __m128i t = _mm_loadu_si128((const __m128i*)(top+x));
+    const __m128i b = _mm_loadu_si128((const __m128i*)(bot+x));
+    _mm_storeu_si128((__m128i*)(gx+x),_mm_sub_epi16(_mm_unpacklo_epi8(r,zero),_mm_unpacklo_epi8(l,zero)));
+    _mm_storeu_si128((__m128i*)(gx+x+8),_mm_sub_epi16(_mm_unpackhi_epi8(r,zero),_mm_unpackhi_epi8(l,zero)));
+    _mm_storeu_si128((__m128i*)(gy+x),_mm_sub_epi16(_mm_unpacklo_epi8(b,zero),_mm_unpacklo_epi8(t,zero)));
+    _mm_storeu_si128((__m128i*)(gy+x+8),_mm_sub_epi16(_mm_unpackhi_epi8(b,zero),_mm_unpackhi_epi8(t,zero)));
+  }
+  computeGradientRowScalar(top,mid,bot,gx,gy,x,x1);
+}
+#endif
+
+/** \brief Computes the gradient images of an image (twice the central differences, exact in 16 bit). The gradients of
+ *         the outermost pixels are set to zero.
+ *
+ *   @param img    - Input image.
+ *   @param gradX  - Output gradient image in x-direction (CV_16SC1).
+ *   @param gradY  - Output gradient image in y-direction (CV_16SC1).
+ *   @param kernel - Instruction set to be used (all kernels yield identical results, AVX2 uses the SSE2 kernel).
+ */
+inline void computeGradientImages(const cv::Mat& img, cv::Mat& gradX, cv::Mat& gradY, const InterpolationKernel kernel = activeInterpolationKernel()){
+  gradX.create(img.rows,img.cols,CV_16SC1);
+  gradY.create(img.rows,img.cols,CV_16SC1);
+  const int refStep = img.step.p[0];
+  for(int y=0; y<img.rows; ++y){
+    int16_t* gx = gradX.ptr<int16_t>(y);
+    int16_t* gy = gradY.ptr<int16_t>(y);
+    if(y == 0 || y == img.rows-1 || img.cols < 3){
+      memset(gx,0,img.cols*sizeof(int16_t));
+      memset(gy,0,img.cols*sizeof(int16_t));
+      continue;
+    }
+    gx[0] = gy[0] = gx[img.cols-1] = gy[img.cols-1] = 0;
+    const uint8_t* mid = img.data + y*refStep;
+    switch(kernel){
+#ifdef ROVIO_X86_SIMD
+      case KERNEL_AVX2:
+      case KERNEL_SSE2:
+        computeGradientRowSSE2(mid-refStep,mid,mid+refStep,gx,gy,img.cols-1);
+        break;
+#endif
+      default:
+        computeGradientRowScalar(mid-refStep,mid,mid+refStep,gx,gy,1,img.cols-1);
     }
   }
 }
 
+/** \brief Fixed-capacity pool of pre-sized pyramid level buffers.
+ *
+ *  The buffers are sized from the first requested resolution. A slot is free again as soon as no pyramid references its
+ *  buffers anymore (the pool then holds the only reference), such that pyramids can be shared freely (see ImagePyramid).
+ *  If all slots are in use, unpooled buffers are returned. Not thread-safe.
+ *
+ *   @tparam n_levels - Number of pyramid levels.
+ */
+template<int n_levels>
+class ImagePyramidPool{
+ public:
+  int capacity_; /**<Maximal number of slots.*/
+  std::vector<std::vector<cv::Mat>> slots_; /**<Level buffers of every slot.*/
+  cv::Size size_; /**<Size of level 0 the buffers have been allocated for.*/
+  int type_; /**<Type of the buffers.*/
+  int minLevel_; /**<Lowest level index the buffers have been allocated for (level 0 is only allocated if 0).*/
+  int maxLevel_; /**<Highest level index the buffers have been allocated for.*/
+  unsigned long hits_; /**<Number of acquire() calls served with a recycled slot.*/
+  unsigned long misses_; /**<Number of acquire() calls which required new buffers.*/
+
+  /** \brief Constructor
+   *
+   *   @param capacity - Maximal number of slots (should cover all pyramids alive at the same time, i.e. the current measurement,
+   *                     queued measurements and the previous pyramids of the filter states).
+   */
+  ImagePyramidPool(const int capacity = 8): capacity_(capacity), size_(0,0), type_(-1), minLevel_(0), maxLevel_(n_levels-1), hits_(0), misses_(0){};
+  virtual ~ImagePyramidPool(){};
+
+  /** \brief Checks if a slot is referenced by a pyramid.
+   */
+  static bool isSlotInUse(const std::vector<cv::Mat>& slot){
+    for(const auto& img : slot){
+      if(img.u != nullptr && img.u->refcount > 1) return true;
+    }
+    return false;
+  }
+
+  /** \brief Provides level buffers for a pyramid of the given resolution.
+   *
+   *   @param imgs - Level images, set to the buffers of a free slot (or to new buffers).
+   *   @param size - Size of level 0.
+   *   @param type - Image type.
+   *   @param minLevel - Lowest level to be stored, see ImagePyramid::computeFromImage().
+   *   @param maxLevel - Highest level to be stored.
+   *   @return true, if a recycled slot was used (hit).
+   */
+  bool acquire(cv::Mat* imgs, const cv::Size& size, const int type, const int minLevel = 0, const int maxLevel = n_levels-1){
+    if(size != size_ || type != type_ || minLevel != minLevel_ || maxLevel != maxLevel_){
+      slots_.clear();
+      size_ = size;
+      type_ = type;
+      minLevel_ = minLevel;
+      maxLevel_ = maxLevel;
+    }
+    for(auto& slot : slots_){
+      if(!isSlotInUse(slot)){
+        std::copy(slot.begin(),slot.end(),imgs);
+        hits_++;
+        return true;
+      }
+    }
+    misses_++;
+    std::vector<cv::Mat> slot(n_levels);
+    cv::Size levelSize = size;
+    for(int i=0;i<=maxLevel;i++){
+      if(i > 0 || minLevel == 0) slot[i].create(levelSize,type);
+      levelSize = cv::Size(levelSize.width/2,levelSize.height/2);
+    }
+    std::copy(slot.begin(),slot.end(),imgs);
+    if(static_cast<int>(slots_.size()) < capacity_){
+      slots_.push_back(slot);
+    }
+    return false;
+  }
+};
+
 /** \brief Image pyramid with selectable number of levels.
+ *
+ *  The level images are reference-counted (cv::Mat) and treated as immutable: copying a pyramid only shares the level buffers,
+ *  and computeFromImage() never writes into buffers which are still referenced elsewhere. It either allocates new buffers or,
+ *  with an ImagePyramidPool, recycles pooled buffers, which are only reused once their reference count shows that no other
+ *  pyramid holds them anymore. Copies thus keep their content as long as their buffers are only read. Use clone() if the
+ *  pyramid (or one of its level images) is to be modified in place, or if it must not keep pooled buffers in use.
  *
  *   @tparam n_levels - Number of pyramid levels.
- *   @todo: complete rule of three
  */
 template<int n_levels>
 class ImagePyramid{
  public:
   ImagePyramid(){};
   virtual ~ImagePyramid(){};
-  cv::Mat imgs_[n_levels]; /**<Array, containing the pyramid images.*/
+  cv::Mat imgs_[n_levels]; /**<Array, containing the pyramid images (shared, must not be modified in place). Empty if not computed.*/
+  cv::Size sizes_[n_levels]; /**<Array, containing the image sizes of all levels (also of the levels which are not computed).*/
+  cv::Mat gradX_[n_levels]; /**<Array, containing the gradient images in x-direction (optional, see computeGradients()).*/
+  cv::Mat gradY_[n_levels]; /**<Array, containing the gradient images in y-direction (optional, see computeGradients()).*/
   cv::Point2f centers_[n_levels]; /**<Array, containing the image center coordinates (in pixel), defined in an
                                       image centered coordinate system of the image at level 0.*/
 
   /** \brief Initializes the image pyramid from an input image (level 0).
    *
-   *   @param img   - Input image (level 0).
-   *   @param useCv - Set to true, if opencv (cv::pyrDown) should be used for the pyramid creation.
+   *  Two downsampling modes are available: the 5x5 Gaussian of cv::pyrDown (smoother, shifts the level centers by an additional
+   *  half pixel) and the 2x2 box filter of halfSample() (SIMD, several times faster). The level centers \ref centers_ are
+   *  adapted to the selected mode, so both can be used interchangeably by the feature handling.
+   *
+   *  Without pool, the input image is not copied but shared as level 0, it must thus not be modified afterwards (pass
+   *  img.clone() otherwise). With pool, the input image is copied into the level 0 buffer of the pool, and all levels are
+   *  computed into pooled buffers without any allocation in the steady state.
+   *  The buffers of the previous content are released, pyramids sharing them are not affected.
+   *
+   *  Only the levels up to maxLevel are computed. If minLevel > 0, level 1 is computed straight from the input image and level 0
+   *  is not stored (the levels between 1 and minLevel are required as intermediate results and are kept). The centers and sizes
+   *  of all levels are set in any case, such that the coordinate transformations stay consistent.
+   *
+   *   @param img      - Input image (level 0).
+   *   @param useCv    - Set to true, if opencv (cv::pyrDown) should be used for the pyramid creation, otherwise halfSample().
+   *   @param pool     - Buffer pool providing the level buffers (nullptr: allocate).
+   *   @param minLevel - Lowest level which is referenced by the user of the pyramid.
+   *   @param maxLevel - Highest level which is referenced by the user of the pyramid.
    */
-  void computeFromImage(const cv::Mat& img, const bool useCv = false){
-    img.copyTo(imgs_[0]);
+  void computeFromImage(const cv::Mat& img, const bool useCv = false, ImagePyramidPool<n_levels>* pool = nullptr,
+                        const int minLevel = 0, const int maxLevel = n_levels-1){
+    assert(minLevel >= 0 && maxLevel < n_levels && minLevel <= maxLevel);
+    for(int i=0; i<n_levels; ++i){
+      imgs_[i].release();
+      gradX_[i].release();
+      gradY_[i].release();
+    }
+    if(pool != nullptr){
+      pool->acquire(imgs_,img.size(),img.type(),minLevel,maxLevel);
+      if(minLevel == 0) img.copyTo(imgs_[0]);
+    } else if(minLevel == 0){
+      imgs_[0] = img;
+    }
+    sizes_[0] = img.size();
     centers_[0] = cv::Point2f(0,0);
     for(int i=1; i<n_levels; ++i){
+      const cv::Mat& imgIn = i == 1 ? img : imgs_[i-1];
+      sizes_[i] = cv::Size(sizes_[i-1].width/2, sizes_[i-1].height/2);
       if(!useCv){
-        halfSample(imgs_[i-1],imgs_[i]);
-        centers_[i].x = centers_[i-1].x-pow(0.5,2-i)*(float)(imgs_[i-1].rows%2);
-        centers_[i].y = centers_[i-1].y-pow(0.5,2-i)*(float)(imgs_[i-1].cols%2);
+        if(i <= maxLevel) halfSample(imgIn,imgs_[i]);
+        centers_[i].x = centers_[i-1].x-pow(0.5,2-i)*(float)(sizes_[i-1].height%2);
+        centers_[i].y = centers_[i-1].y-pow(0.5,2-i)*(float)(sizes_[i-1].width%2);
       } else {
-        cv::pyrDown(imgs_[i-1],imgs_[i],cv::Size(imgs_[i-1].cols/2, imgs_[i-1].rows/2));
-        centers_[i].x = centers_[i-1].x-pow(0.5,2-i)*(float)((imgs_[i-1].rows%2)+1);
-        centers_[i].y = centers_[i-1].y-pow(0.5,2-i)*(float)((imgs_[i-1].cols%2)+1);
+        if(i <= maxLevel) cv::pyrDown(imgIn,imgs_[i],sizes_[i]);
+        centers_[i].x = centers_[i-1].x-pow(0.5,2-i)*(float)((sizes_[i-1].height%2)+1);
+        centers_[i].y = centers_[i-1].y-pow(0.5,2-i)*(float)((sizes_[i-1].width%2)+1);
       }
     }
   }
 
-  /** \brief Copies the image pyramid.
+  /** \brief Computes the gradient images (see computeGradientImages()) of the computed levels, such that patches can
+   *         interpolate their gradients instead of differencing an expanded patch (see Patch::extractPatchAndGradientsFromImage()).
+   *         Has to be called after computeFromImage().
+   *
+   *   @param minLevel - Lowest level for which the gradients should be computed.
+   *   @param maxLevel - Highest level for which the gradients should be computed.
+   */
+  void computeGradients(const int minLevel = 0, const int maxLevel = n_levels-1){
+    for(int i=minLevel; i<=maxLevel; ++i){
+      gradX_[i].release(); // Might be shared with other pyramids
+      gradY_[i].release();
+      if(isLevelComputed(i)){
+        computeGradientImages(imgs_[i],gradX_[i],gradY_[i]);
+      }
+    }
+  }
+
+  /** \brief Checks if the gradient images of a pyramid level have been computed.
+   *
+   *   @param l - Pyramid level.
+   */
+  bool hasGradients(const int l) const{
+    return !gradX_[l].empty();
+  }
+
+  /** \brief Checks if a pyramid level has been computed.
+   *
+   *   @param l - Pyramid level.
+   */
+  bool isLevelComputed(const int l) const{
+    return !imgs_[l].empty();
+  }
+
+  /** \brief Copies the image pyramid, O(1): the level buffers are shared.
    */
   ImagePyramid<n_levels>& operator=(const ImagePyramid<n_levels> &rhs) {
     for(unsigned int i=0;i<n_levels;i++){
-      rhs.imgs_[i].copyTo(imgs_[i]);
+      imgs_[i] = rhs.imgs_[i];
+      gradX_[i] = rhs.gradX_[i];
+      gradY_[i] = rhs.gradY_[i];
+      sizes_[i] = rhs.sizes_[i];
       centers_[i] = rhs.centers_[i];
     }
     return *this;
   }
 
+  /** \brief Returns a deep copy of the image pyramid (with its own level buffers).
+   */
+  ImagePyramid<n_levels> clone() const{
+    ImagePyramid<n_levels> pyr;
+    for(unsigned int i=0;i<n_levels;i++){
+      pyr.imgs_[i] = imgs_[i].clone();
+      pyr.gradX_[i] = gradX_[i].clone();
+      pyr.gradY_[i] = gradY_[i].clone();
+      pyr.sizes_[i] = sizes_[i];
+      pyr.centers_[i] = centers_[i];
+    }
+    return pyr;
+  }
+
   /** \brief Transforms pixel coordinates between two pyramid levels.
    *
    * @Note Invalidates camera and bearing vector, since the camera model is not valid for arbitrary image levels.
@@ -125,22 +431,54 @@ class ImagePyramid{
     cOut.mpCamera_ = nullptr;
   }
 
+  /** \brief Transforms pixel coordinates between two pyramid levels, keeping the warping.
+   *
+   * @param cIn        - Input coordinates
+   * @param cOut       - Output coordinates
+   * @param l1         - Input pyramid level.
+   * @param l2         - Output pyramid level.
+   */
+  void levelTranformCoordinates(const PatchCoordinates& cIn,PatchCoordinates& cOut,const int l1, const int l2) const{
+    assert(l1<n_levels && l2<n_levels && l1>=0 && l2>=0);
+    const cv::Point2f c = (centers_[l1]-centers_[l2])*pow(0.5,l2)+cIn.get_c()*pow(0.5,l2-l1);
+    cOut = cIn;
+    cOut.set_c(c);
+  }
+
   /** \brief Extract FastCorner coordinates
    *
    * @param candidates         - List of the extracted corner coordinates (defined on pyramid level 0).
    * @param l                  - Pyramid level at which the corners should be extracted.
    * @param detectionThreshold - Detection threshold of the used cv::FastFeatureDetector.
    *                             See http://docs.opencv.org/trunk/df/d74/classcv_1_1FastFeatureDetector.html
+   * @param responses          - Optional list receiving the FAST response of every extracted corner (kept parallel to candidates).
    */
-  void detectFastCorners(std::vector<FeatureCoordinates>& candidates, int l, int detectionThreshold) const{
+  void detectFastCorners(std::vector<FeatureCoordinates>& candidates, int l, int detectionThreshold, std::vector<float>* responses = nullptr) const{
     std::vector<cv::KeyPoint> keypoints;
     cv::Ptr<cv::FastFeatureDetector> feature_detector_fast = cv::FastFeatureDetector::create(detectionThreshold, true);
-    feature_detector_fast->detect(imgs_[l], keypoints);
+    detectFastCorners(candidates,l,*feature_detector_fast,keypoints,responses);
+  }
+
+  /** \brief Extract FastCorner coordinates with an existing detector
+   *
+   * @param candidates - List of the extracted corner coordinates (defined on pyramid level 0).
+   * @param l          - Pyramid level at which the corners should be extracted.
+   * @param detector   - Detector which is used for the extraction.
+   * @param keypoints  - Keypoint buffer, is overwritten.
+   * @param responses  - Optional list receiving the FAST response of every extracted corner (kept parallel to candidates).
+   * @param mask       - Optional detection mask on level l (corners are only extracted where the mask is non-zero).
+   */
+  void detectFastCorners(std::vector<FeatureCoordinates>& candidates, int l, cv::FastFeatureDetector& detector, std::vector<cv::KeyPoint>& keypoints,
+                         std::vector<float>* responses = nullptr, const cv::Mat& mask = cv::Mat()) const{
+    keypoints.clear();
+    detector.detect(imgs_[l], keypoints, mask);
     FeatureCoordinates c;
     candidates.reserve(candidates.size()+keypoints.size());
+    if(responses != nullptr) responses->reserve(responses->size()+keypoints.size());
     for (auto it = keypoints.cbegin(), end = keypoints.cend(); it != end; ++it) {
       levelTranformCoordinates(FeatureCoordinates(cv::Point2f(it->pt.x, it->pt.y)),c,l,0);
       candidates.push_back(c);
+      if(responses != nullptr) responses->push_back(it->response);
     }
   }
 };
@@ -39,6 +39,7 @@
 #include "rovio/CoordinateTransform/PixelOutput.hpp"
 #include "rovio/ZeroVelocityUpdate.hpp"
 #include "rovio/MultilevelPatchAlignment.hpp"
+#include "rovio/FastCornerDetector.hpp"
 
 namespace rovio {
 
@@ -70,6 +71,9 @@ class ImgUpdateMeasAuxiliary: public LWF::AuxiliaryBase<ImgUpdateMeasAuxiliary<S
  public:
   ImgUpdateMeasAuxiliary(){
     reset(0.0);
+    for(int i=0;i<STATE::nCam_;i++){
+      pyrPool_[i].reset(new ImagePyramidPool<STATE::nLevels_>());
+    }
   };
   virtual ~ImgUpdateMeasAuxiliary(){};
   void reset(const double t){
@@ -85,6 +89,7 @@ class ImgUpdateMeasAuxiliary: public LWF::AuxiliaryBase<ImgUpdateMeasAuxiliary<S
     return true;
   }
   ImagePyramid<STATE::nLevels_> pyr_[STATE::nCam_];
+  std::shared_ptr<ImagePyramidPool<STATE::nLevels_>> pyrPool_[STATE::nCam_]; /**<Buffer pools for the pyramids, shared by all copies of the measurement.*/
   bool isValidPyr_[STATE::nCam_];
   double imgTime_;
 };
@@ -189,6 +194,11 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
   double startDetectionTh_;
   int nDetectionBuckets_;
   int fastDetectionThreshold_;
+  int detectionCellSize_; /**<Side length of the grid cells used for the candidate preselection [pix] (disabled if <= 0).*/
+  int detectionCandidatesPerCell_; /**<Maximal number of candidates per grid cell kept by the candidate preselection.*/
+  int detectionWorkers_; /**<Number of workers for the concurrent corner detection on all cameras and levels (sequential if <= 1).*/
+  bool maskDetectionAroundFeatures_; /**<Should the corner detection skip the regions within penaltyDistance of existing features.*/
+  bool useWeightGridDetection_; /**<Should new features be added with the weight grid of addBestCandidatesNew() instead of the score buckets of addBestCandidates().*/
   double scoreDetectionExponent_;
   double penaltyDistance_;
   double zeroDistancePenalty_;
@@ -209,6 +219,7 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
   double innovationInterpolationFactor_; /**<How much should be used from the direct or indirect error terms. Value must be between 0 and 1.*/
   bool doFrameVisualisation_;
   bool visualizePatches_;
+  bool logAlignErrors_; /**<Should the patch errors of the measurements be logged in FilterState::mlpErrorLog_ (only needed for publishing them).*/
   bool verbose_;
   bool removeNegativeFeatureAfterUpdate_;
   double specialLinearizationThreshold_;
@@ -222,12 +233,16 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
   double alignConvergencePixelRange_;
   double alignCoverageRatio_;
   int alignMaxUniSample_;
+  int alignSeedWorkers_; /**<Number of workers for the parallel evaluation of the alignment seeds (sequential if <= 1).*/
   bool useCrossCameraMeasurements_; /**<Should features be matched across cameras.*/
   bool doStereoInitialization_; /**<Should a stereo match be used for feature initialization.*/
+  bool useBoxFilterPyramid_; /**<Should the image pyramids be built with the 2x2 box filter (halfSample()) instead of cv::pyrDown.*/
+  bool useGradientPyramid_; /**<Should gradient images be computed for the pyramids, patch gradients are then interpolated from them.*/
   int minNoAlignment_; /**<Minimal number of alignment every feature must make through.*/
   double alignmentHuberNormThreshold_; /**<Intensity error threshold for Huber norm.*/
   double alignmentGaussianWeightingSigma_; /**<Width of Gaussian which is used for pixel error weighting.*/
   double alignmentGradientExponent_; /**<Exponent used for gradient based weighting of residuals.*/
+  double alignSeedCancelIntensityError_; /**<Average intensity error below which an alignment seed cancels the remaining seeds (disabled if <= 0).*/
 
 
   // Temporary
@@ -244,6 +259,34 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
   mutable FeatureCoordinates tempCoordinates_;
   mutable mtState linearizationPoint_;
   mutable std::vector<FeatureCoordinates> candidates_;
+  mutable std::vector<float> candidateResponses_;
+  mutable MultilevelFastDetector<mtState::nLevels_> fastDetectors_[mtState::nCam_];
+  mutable std::vector<cv::Point2f> detectionMaskPixels_[mtState::nCam_];
+  std::shared_ptr<WorkerPool> detectionWorkerPool_;
+
+  /** \brief Timing and count metrics of the feature detection.
+   */
+  struct DetectionMetrics{
+    double detectionTime_; /**<Time of the last corner detection on all cameras and levels [ms].*/
+    double totalDetectionTime_; /**<Accumulated time of all corner detections [ms].*/
+    int nDetectionRuns_; /**<Number of corner detections.*/
+    int nDetected_[mtState::nCam_]; /**<Number of corners of the last detection in every camera.*/
+    int nPreselected_[mtState::nCam_]; /**<Number of candidates after the preselection of the last detection in every camera.*/
+    int nAdded_[mtState::nCam_]; /**<Number of added features of the last detection in every camera.*/
+    DetectionMetrics(): detectionTime_(0.0), totalDetectionTime_(0.0), nDetectionRuns_(0){
+      for(int i=0;i<mtState::nCam_;i++){
+        nDetected_[i] = 0;
+        nPreselected_[i] = 0;
+        nAdded_[i] = 0;
+      }
+    }
+    /** \brief Returns the average time of a corner detection [ms].
+     */
+    double getAverageDetectionTime() const{
+      return nDetectionRuns_ > 0 ? totalDetectionTime_/nDetectionRuns_ : 0.0;
+    }
+  };
+  mutable DetectionMetrics detectionMetrics_;
   mutable bool doPreAlignment_;
   mutable Eigen::Vector2d pixError_;
   mutable cv::Point2f c_temp_;
@@ -264,6 +307,11 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
     startDetectionTh_ = 0.9;
     nDetectionBuckets_ = 100;
     fastDetectionThreshold_ = 10;
+    detectionCellSize_ = 0;
+    detectionCandidatesPerCell_ = 5;
+    detectionWorkers_ = 1;
+    maskDetectionAroundFeatures_ = false;
+    useWeightGridDetection_ = false;
     scoreDetectionExponent_ = 0.5;
     penaltyDistance_ = 20;
     zeroDistancePenalty_ = nDetectionBuckets_*1.0;
@@ -271,6 +319,7 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
     innovationInterpolationFactor_ = 0.5;
     doFrameVisualisation_ = true;
     visualizePatches_ = false;
+    logAlignErrors_ = false;
     verbose_ = false;
     trackingUpperBound_ = 0.9;
     trackingLowerBound_ = 0.1;
@@ -294,8 +343,11 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
     alignConvergencePixelRange_ = 1.0;
     alignCoverageRatio_ = 2.0;
     alignMaxUniSample_ = 5;
+    alignSeedWorkers_ = 1;
     useCrossCameraMeasurements_ = true;
     doStereoInitialization_ = true;
+    useBoxFilterPyramid_ = false;
+    useGradientPyramid_ = false;
     removalFactor_ = 1.1;
     minNoAlignment_ = 5;
     alignmentGaussianWeightingSigma_ = 2.0;
@@ -326,8 +378,12 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
     intRegister_.registerScalar("startLevel",startLevel_);
     intRegister_.registerScalar("endLevel",endLevel_);
     intRegister_.registerScalar("nDetectionBuckets",nDetectionBuckets_);
+    intRegister_.registerScalar("detectionCellSize",detectionCellSize_);
+    intRegister_.registerScalar("detectionCandidatesPerCell",detectionCandidatesPerCell_);
+    intRegister_.registerScalar("detectionWorkers",detectionWorkers_);
     intRegister_.registerScalar("MotionDetection.minFeatureCountForNoMotionDetection",minFeatureCountForNoMotionDetection_);
     intRegister_.registerScalar("alignMaxUniSample",alignMaxUniSample_);
+    intRegister_.registerScalar("alignSeedWorkers",alignSeedWorkers_);
     intRegister_.registerScalar("minNoAlignment",minNoAlignment_);
     boolRegister_.registerScalar("MotionDetection.isEnabled",doVisualMotionDetection_);
     boolRegister_.registerScalar("useDirectMethod",useDirectMethod_);
@@ -336,8 +392,15 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
     boolRegister_.registerScalar("removeNegativeFeatureAfterUpdate",removeNegativeFeatureAfterUpdate_);
     boolRegister_.registerScalar("useCrossCameraMeasurements",useCrossCameraMeasurements_);
     boolRegister_.registerScalar("doStereoInitialization",doStereoInitialization_);
+    boolRegister_.registerScalar("useBoxFilterPyramid",useBoxFilterPyramid_);
+    boolRegister_.registerScalar("useGradientPyramid",useGradientPyramid_);
+    boolRegister_.registerScalar("maskDetectionAroundFeatures",maskDetectionAroundFeatures_);
+    boolRegister_.registerScalar("useWeightGridDetection",useWeightGridDetection_);
     boolRegister_.registerScalar("useIntensityOffsetForAlignment",alignment_.useIntensityOffset_);
     boolRegister_.registerScalar("useIntensitySqewForAlignment",alignment_.useIntensitySqew_);
+    boolRegister_.registerScalar("useNormalEquationsForAlignment",alignment_.useNormalEquations_);
+    boolRegister_.registerScalar("useInverseCompositionalAlignment",alignment_.useInverseCompositional_);
+    boolRegister_.registerScalar("useESMForAlignment",alignment_.useESM_);
     doubleRegister_.removeScalarByVar(updnoiP_(0,0));
     doubleRegister_.removeScalarByVar(updnoiP_(1,1));
     doubleRegister_.registerScalar("UpdateNoise.pix",updateNoisePix_);
@@ -358,6 +421,8 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
     doubleRegister_.registerScalar("alignmentGaussianWeightingSigma",alignmentGaussianWeightingSigma_);
     alignmentGradientExponent_ = static_cast<double>(alignment_.gradientExponent_);
     doubleRegister_.registerScalar("alignmentGradientExponent",alignmentGradientExponent_);
+    alignSeedCancelIntensityError_ = static_cast<double>(alignment_.seedCancelIntensityError_);
+    doubleRegister_.registerScalar("alignSeedCancelIntensityError",alignSeedCancelIntensityError_);
   };
 
   /** \brief Destructor
@@ -379,8 +444,37 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
     alignment_.huberNormThreshold_ = static_cast<float>(alignmentHuberNormThreshold_);
     alignment_.computeWeightings(alignmentGaussianWeightingSigma_);
     alignment_.gradientExponent_ = static_cast<float>(alignmentGradientExponent_);
+    if(alignment_.useInverseCompositional_ && alignment_.huberNormThreshold_ > 0.0){
+      std::cout << "\033[31mThe inverse compositional alignment does not support the Huber norm (alignmentHuberNormThreshold > 0), using the forward alignment!\033[0m" << std::endl;
+      alignment_.useInverseCompositional_ = false;
+    }
+    alignment_.seedCancelIntensityError_ = static_cast<float>(alignSeedCancelIntensityError_);
+    alignment_.setSeedWorkers(alignSeedWorkers_);
+    alignment_.refreshPolicy();
+    if(detectionWorkers_ <= 1){
+      detectionWorkerPool_.reset();
+    } else if(!detectionWorkerPool_ || detectionWorkerPool_->size() != detectionWorkers_){
+      detectionWorkerPool_.reset(new WorkerPool(detectionWorkers_));
+    }
   };
 
+  /** \brief Returns the range of pyramid levels which is referenced by the update with the current configuration
+   *         (alignment and detection levels, plus all levels if visualisations are enabled).
+   *
+   * @param minLevel - Lowest referenced pyramid level.
+   * @param maxLevel - Highest referenced pyramid level.
+   */
+  void getPyramidLevelRange(int& minLevel, int& maxLevel) const{
+    minLevel = endLevel_;
+    maxLevel = startLevel_;
+    if(doFrameVisualisation_ || visualizePatches_){
+      minLevel = 0;
+    }
+    if(visualizePatches_){
+      maxLevel = mtState::nLevels_-1;
+    }
+  }
+
   /** \brief Sets the multicamera pointer
    *
    * @param mpMultiCamera - Multicamera pointer
@@ -484,19 +578,17 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
     if(doVisualMotionDetection_ && filterState.imageCounter_>1){
       int totCountInFrame = 0;
       int totCountInMotion = 0;
-      for(unsigned int i=0;i<mtState::nMax_;i++){
-        if(filterState.fsm_.isValid_[i]){
-          const int& camID = filterState.state_.CfP(i).camID_;   // Camera ID of the feature.
-          tempCoordinates_ = *filterState.fsm_.features_[i].mpCoordinates_;
-          tempCoordinates_.set_warp_identity();
-          if(mlpTemp1_.isMultilevelPatchInFrame(filterState.prevPyr_[camID],tempCoordinates_,startLevel_,true)){
-            mlpTemp1_.extractMultilevelPatchFromImage(filterState.prevPyr_[camID],tempCoordinates_,startLevel_,true);
-            mlpTemp1_.computeMultilevelShiTomasiScore(endLevel_,startLevel_);
-            mlpTemp2_.extractMultilevelPatchFromImage(meas.aux().pyr_[camID],tempCoordinates_,startLevel_,true);
-            const float avgError = mlpTemp1_.computeAverageDifference(mlpTemp2_,endLevel_,startLevel_);
-            if(avgError/std::sqrt(mlpTemp1_.e1_) > static_cast<float>(pixelCoordinateMotionTh_)) totCountInMotion++;
-            totCountInFrame++;
-          }
+      for(const int i : filterState.fsm_.validSlots_){
+        const int& camID = filterState.state_.CfP(i).camID_;   // Camera ID of the feature.
+        tempCoordinates_ = *filterState.fsm_.features_[i].mpCoordinates_;
+        tempCoordinates_.set_warp_identity();
+        if(mlpTemp1_.isMultilevelPatchInFrame(filterState.prevPyr_[camID],tempCoordinates_,startLevel_,true)){
+          mlpTemp1_.extractMultilevelPatchFromImage(filterState.prevPyr_[camID],tempCoordinates_,startLevel_,true);
+          mlpTemp1_.computeMultilevelShiTomasiScore(endLevel_,startLevel_);
+          mlpTemp2_.extractMultilevelPatchFromImage(meas.aux().pyr_[camID],tempCoordinates_,startLevel_,true);
+          const float avgError = mlpTemp1_.computeAverageDifference(mlpTemp2_,endLevel_,startLevel_);
+          if(avgError/std::sqrt(mlpTemp1_.e1_) > static_cast<float>(pixelCoordinateMotionTh_)) totCountInMotion++;
+          totCountInFrame++;
         }
       }
       if(rateOfMovingFeaturesTh_/totCountInMotion*totCountInFrame < 1.0 || totCountInFrame < minFeatureCountForNoMotionDetection_){
@@ -536,11 +628,14 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
     state.updateMultiCameraExtrinsics(mpMultiCamera_);
 
     while(ID < mtState::nMax_ && foundValidMeasurement == false){
-      if(filterState.fsm_.isValid_[ID]){
+      if(filterState.fsm_.isValid(ID)){
         // Data handling stuff
         FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[ID];
         const int camID = f.mpCoordinates_->camID_;
         const int activeCamID = (activeCamCounter + camID)%mtState::nCam_;
+        if(activeCamCounter==0 && logAlignErrors_){
+          filterState.mlpErrorLog_[ID].reset(); // Only the levels of a valid measurement are logged below
+        }
         if(activeCamCounter==0 && f.mpStatistics_->status_[activeCamID] != FAILED_TRACKING){
           f.mpStatistics_->increaseStatistics(filterState.t_);
           if(verbose_){
@@ -548,7 +643,7 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
           }
           // Visualize patch tracking
           if(visualizePatches_){
-            f.mpMultilevelPatch_->drawMultilevelPatch(filterState.patchDrawing_,cv::Point2i(2,filterState.drawPB_+ID*filterState.drawPS_),1,false);
+            drawMultilevelPatch(filterState.patchDrawing_,*f.mpMultilevelPatch_,cv::Point2i(2,filterState.drawPB_+ID*filterState.drawPS_),1,false);
             cv::putText(filterState.patchDrawing_,std::to_string(f.idx_),cv::Point2i(2,10+ID*filterState.drawPS_),cv::FONT_HERSHEY_SIMPLEX, 0.4, cv::Scalar(255,255,255));
           }
         }
@@ -588,7 +683,7 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
           if(visualizePatches_){
             if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[activeCamID],featureOutput_.c(),mtState::nLevels_-1,false)){
               mlpTemp1_.extractMultilevelPatchFromImage(meas.aux().pyr_[activeCamID],featureOutput_.c(),mtState::nLevels_-1,false);
-              mlpTemp1_.drawMultilevelPatch(filterState.patchDrawing_,cv::Point2i(filterState.drawPB_+(1+2*activeCamID)*filterState.drawPS_,filterState.drawPB_+ID*filterState.drawPS_),1,false);
+              drawMultilevelPatch(filterState.patchDrawing_,mlpTemp1_,cv::Point2i(filterState.drawPB_+(1+2*activeCamID)*filterState.drawPS_,filterState.drawPB_+ID*filterState.drawPS_),1,false);
             }
           }
           if(activeCamID==camID){
@@ -604,7 +699,7 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
             if(alignment_.align2DAdaptive(alignedCoordinates_,meas.aux().pyr_[activeCamID],*f.mpMultilevelPatch_,featureOutput_.c(),startLevel_,endLevel_,
                                           alignConvergencePixelRange_,alignCoverageRatio_,alignMaxUniSample_)){
               if(activeCamID==camID) f.log_meas_ = alignedCoordinates_;
-              if(verbose_) std::cout << "    Found match: " << alignedCoordinates_.get_nor().getVec().transpose() << std::endl;
+              if(verbose_) std::cout << "    Found match: " << alignedCoordinates_.get_nor().getVec().transpose() << " (" << alignment_.iterationCount_ << " iterations)" << std::endl;
               if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[activeCamID],alignedCoordinates_,startLevel_,false)){
                 float avgError = 0.0;
                 if(patchRejectionTh_ >= 0){
@@ -702,7 +797,10 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
                     }
                   }
                 }
-                filterState.mlpErrorLog_[ID] = alignment_.mlpError_;
+                if(logAlignErrors_){ // Errors at the linearization point of the direct method, or at the match of the reprojection error
+                  alignment_.getAlignErrors(meas.aux().pyr_[activeCamID],*f.mpMultilevelPatch_,useDirectMethod_ ? featureOutput_.c() : alignedCoordinates_,
+                                            endLevel_,startLevel_,filterState.mlpErrorLog_[ID]);
+                }
               } else {
                 if(verbose_) std::cout << "    \033[31mFailed construction of linear equation!\033[0m" << std::endl;
               }
@@ -752,18 +850,16 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
 
       // Remove negative feature
       if(removeNegativeFeatureAfterUpdate_){
-        for(unsigned int i=0;i<mtState::nMax_;i++){
-          if(filterState.fsm_.isValid_[i]){
-            if(filterState.state_.dep(i).getDistance() < 1e-8){
-              if(verbose_) std::cout << "    \033[33mRemoved feature " << filterState.fsm_.features_[i].idx_ << " with invalid distance parameter " << filterState.state_.dep(i).p_ << "!\033[0m" << std::endl;
-              filterState.fsm_.isValid_[i] = false;
-              filterState.resetFeatureCovariance(i,Eigen::Matrix3d::Identity());
-            }
+        for(const int i : filterState.fsm_.validSlots_){
+          if(filterState.state_.dep(i).getDistance() < 1e-8){
+            if(verbose_) std::cout << "    \033[33mRemoved feature " << filterState.fsm_.features_[i].idx_ << " with invalid distance parameter " << filterState.state_.dep(i).p_ << "!\033[0m" << std::endl;
+            filterState.fsm_.removeFeature(i);
+            filterState.resetFeatureCovariance(i,Eigen::Matrix3d::Identity());
           }
         }
       }
 
-      if(filterState.fsm_.isValid_[ID]){
+      if(filterState.fsm_.isValid(ID)){
         // Update statue and visualization
         if(activeCamID == camID){
           featureOutput_.c() = filterState.state_.CfP(ID);
@@ -781,11 +877,11 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
             }
             if(patchRejectionTh_ < 0 || avgError <= patchRejectionTh_){
               f.mpStatistics_->status_[activeCamID] = TRACKED;
-              if(doFrameVisualisation_) mlpTemp1_.drawMultilevelPatchBorder(filterState.img_[activeCamID],featureOutput_.c(),1.0,cv::Scalar(0,150+(activeCamID == camID)*105,0));
+              if(doFrameVisualisation_) drawMultilevelPatchBorder(filterState.img_[activeCamID],mlpTemp1_,featureOutput_.c(),1.0,cv::Scalar(0,150+(activeCamID == camID)*105,0));
             } else {
               f.mpStatistics_->status_[activeCamID] = FAILED_TRACKING;
               if(doFrameVisualisation_){
-                mlpTemp1_.drawMultilevelPatchBorder(filterState.img_[activeCamID],featureOutput_.c(),1.0,cv::Scalar(0,0,150+(activeCamID == camID)*105));
+                drawMultilevelPatchBorder(filterState.img_[activeCamID],mlpTemp1_,featureOutput_.c(),1.0,cv::Scalar(0,0,150+(activeCamID == camID)*105));
                 featureOutput_.c().drawText(filterState.img_[activeCamID],"PE: " + std::to_string(avgError),cv::Scalar(0,0,150+(activeCamID == camID)*105));
               }
               if(verbose_) std::cout << "    \033[31mToo large pixel error after update: " << avgError << "\033[0m" << std::endl;
@@ -793,7 +889,7 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
           } else {
             f.mpStatistics_->status_[activeCamID] = FAILED_TRACKING;
             if(doFrameVisualisation_){
-              mlpTemp1_.drawMultilevelPatchBorder(filterState.img_[activeCamID],featureOutput_.c(),1.0,cv::Scalar(0,0,150+(activeCamID == camID)*105));
+              drawMultilevelPatchBorder(filterState.img_[activeCamID],mlpTemp1_,featureOutput_.c(),1.0,cv::Scalar(0,0,150+(activeCamID == camID)*105));
               featureOutput_.c().drawText(filterState.img_[activeCamID],"NIF",cv::Scalar(0,0,150+(activeCamID == camID)*105));
             }
             if(verbose_) std::cout << "    \033[31mNot in frame after update!\033[0m" << std::endl;
@@ -801,7 +897,7 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
         } else {
           f.mpStatistics_->status_[activeCamID] = FAILED_TRACKING;
           if(doFrameVisualisation_){
-            mlpTemp1_.drawMultilevelPatchBorder(filterState.img_[activeCamID],featureOutput_.c(),1.0,cv::Scalar(0,0,150+(activeCamID == camID)*105));
+            drawMultilevelPatchBorder(filterState.img_[activeCamID],mlpTemp1_,featureOutput_.c(),1.0,cv::Scalar(0,0,150+(activeCamID == camID)*105));
             featureOutput_.c().drawText(filterState.img_[activeCamID],"MD: " + std::to_string(outlierDetection.getMahalDistance(0)),cv::Scalar(0,0,150+(activeCamID == camID)*105));
           }
           if(verbose_) std::cout << "    \033[31mRecognized as outlier by filter: " << outlierDetection.getMahalDistance(0) << "\033[0m" << std::endl;
@@ -811,7 +907,7 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
         if(visualizePatches_){
           if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[activeCamID],featureOutput_.c(),mtState::nLevels_-1,false)){
             mlpTemp1_.extractMultilevelPatchFromImage(meas.aux().pyr_[activeCamID],featureOutput_.c(),mtState::nLevels_-1,false);
-            mlpTemp1_.drawMultilevelPatch(filterState.patchDrawing_,cv::Point2i(filterState.drawPB_+(2+2*activeCamID)*filterState.drawPS_,filterState.drawPB_+ID*filterState.drawPS_),1,false);
+            drawMultilevelPatch(filterState.patchDrawing_,mlpTemp1_,cv::Point2i(filterState.drawPB_+(2+2*activeCamID)*filterState.drawPS_,filterState.drawPB_+ID*filterState.drawPS_),1,false);
           }
           if(f.mpStatistics_->status_[activeCamID] == TRACKED){
             cv::rectangle(filterState.patchDrawing_,cv::Point2i((2+2*activeCamID)*filterState.drawPS_,ID*filterState.drawPS_),cv::Point2i((3+2*activeCamID)*filterState.drawPS_-1,(ID+1)*filterState.drawPS_-1),cv::Scalar(0,255,0),1,8,0);
@@ -857,54 +953,50 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
 
     countTracked = 0;
     // For all features in the state.
-    for(unsigned int i=0;i<mtState::nMax_;i++){
-      if(filterState.fsm_.isValid_[i]){
-        FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[i];
-        const int camID = f.mpCoordinates_->camID_;
-        if(f.mpStatistics_->trackedInSomeFrame()){
-          countTracked++;
-        }
-        if(f.mpStatistics_->status_[camID] == TRACKED && filterState.t_ - f.mpStatistics_->lastPatchUpdate_ > minTimeBetweenPatchUpdate_){
-          tempCoordinates_ = *f.mpCoordinates_;
-          tempCoordinates_.set_warp_identity();
-          if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[camID],tempCoordinates_,startLevel_,true)){
-            mlpTemp1_.extractMultilevelPatchFromImage(meas.aux().pyr_[camID],tempCoordinates_,startLevel_,true);
-            mlpTemp1_.computeMultilevelShiTomasiScore(endLevel_,startLevel_);
-            if(mlpTemp1_.s_ >= static_cast<float>(minAbsoluteSTScore_) && mlpTemp1_.s_ >= static_cast<float>(minRelativeSTScore_)*(f.mpMultilevelPatch_->s_)){
-              *f.mpMultilevelPatch_ = mlpTemp1_;
-              f.mpCoordinates_->set_warp_identity();
-              f.mpStatistics_->lastPatchUpdate_ = filterState.t_;
-            }
+    for(const int i : filterState.fsm_.validSlots_){
+      FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[i];
+      const int camID = f.mpCoordinates_->camID_;
+      if(f.mpStatistics_->trackedInSomeFrame()){
+        countTracked++;
+      }
+      if(f.mpStatistics_->status_[camID] == TRACKED && filterState.t_ - f.mpStatistics_->lastPatchUpdate_ > minTimeBetweenPatchUpdate_){
+        tempCoordinates_ = *f.mpCoordinates_;
+        tempCoordinates_.set_warp_identity();
+        if(mlpTemp1_.isMultilevelPatchInFrame(meas.aux().pyr_[camID],tempCoordinates_,startLevel_,true)){
+          mlpTemp1_.extractMultilevelPatchFromImage(meas.aux().pyr_[camID],tempCoordinates_,startLevel_,true);
+          mlpTemp1_.computeMultilevelShiTomasiScore(endLevel_,startLevel_);
+          if(mlpTemp1_.s_ >= static_cast<float>(minAbsoluteSTScore_) && mlpTemp1_.s_ >= static_cast<float>(minRelativeSTScore_)*(f.mpMultilevelPatch_->s_)){
+            *f.mpMultilevelPatch_ = mlpTemp1_;
+            f.mpCoordinates_->set_warp_identity();
+            f.mpStatistics_->lastPatchUpdate_ = filterState.t_;
           }
         }
-        // Visualize Quatlity
-        if(visualizePatches_){
-          for(int j=0;j<mtState::nCam_;j++){
-            // Local Quality
-            const double qLQ = f.mpStatistics_->getLocalQuality(j);
-            cv::line(filterState.patchDrawing_,cv::Point2i((2+2*j)*filterState.drawPS_+1,(i+1)*filterState.drawPS_-4),cv::Point2i((2+2*j)*filterState.drawPS_+1+(filterState.drawPS_-3)*qLQ,(i+1)*filterState.drawPS_-4),cv::Scalar(0,255*qLQ,255*(1-qLQ)),2,8,0);
-          }
-          const double qALQ = f.mpStatistics_->getAverageLocalQuality();
-          cv::line(filterState.patchDrawing_,cv::Point2i(1,(i+1)*filterState.drawPS_-10),cv::Point2i(1+(filterState.drawPS_-3)*qALQ,(i+1)*filterState.drawPS_-10),cv::Scalar(0,255*qALQ,255*(1-qALQ)),2,8,0);
-          const double qLV = f.mpStatistics_->getLocalVisibility();
-          cv::line(filterState.patchDrawing_,cv::Point2i(1,(i+1)*filterState.drawPS_-7),cv::Point2i(1+(filterState.drawPS_-3)*qLV,(i+1)*filterState.drawPS_-7),cv::Scalar(0,255*qLV,255*(1-qLV)),2,8,0);
-          const double qGQ = f.mpStatistics_->getGlobalQuality();
-          cv::line(filterState.patchDrawing_,cv::Point2i(1,(i+1)*filterState.drawPS_-4),cv::Point2i(1+(filterState.drawPS_-3)*qGQ,(i+1)*filterState.drawPS_-4),cv::Scalar(0,255*qGQ,255*(1-qALQ)),2,8,0);
+      }
+      // Visualize Quatlity
+      if(visualizePatches_){
+        for(int j=0;j<mtState::nCam_;j++){
+          // Local Quality
+          const double qLQ = f.mpStatistics_->getLocalQuality(j);
+          cv::line(filterState.patchDrawing_,cv::Point2i((2+2*j)*filterState.drawPS_+1,(i+1)*filterState.drawPS_-4),cv::Point2i((2+2*j)*filterState.drawPS_+1+(filterState.drawPS_-3)*qLQ,(i+1)*filterState.drawPS_-4),cv::Scalar(0,255*qLQ,255*(1-qLQ)),2,8,0);
         }
+        const double qALQ = f.mpStatistics_->getAverageLocalQuality();
+        cv::line(filterState.patchDrawing_,cv::Point2i(1,(i+1)*filterState.drawPS_-10),cv::Point2i(1+(filterState.drawPS_-3)*qALQ,(i+1)*filterState.drawPS_-10),cv::Scalar(0,255*qALQ,255*(1-qALQ)),2,8,0);
+        const double qLV = f.mpStatistics_->getLocalVisibility();
+        cv::line(filterState.patchDrawing_,cv::Point2i(1,(i+1)*filterState.drawPS_-7),cv::Point2i(1+(filterState.drawPS_-3)*qLV,(i+1)*filterState.drawPS_-7),cv::Scalar(0,255*qLV,255*(1-qLV)),2,8,0);
+        const double qGQ = f.mpStatistics_->getGlobalQuality();
+        cv::line(filterState.patchDrawing_,cv::Point2i(1,(i+1)*filterState.drawPS_-4),cv::Point2i(1+(filterState.drawPS_-3)*qGQ,(i+1)*filterState.drawPS_-4),cv::Scalar(0,255*qGQ,255*(1-qALQ)),2,8,0);
       }
     }
 
     // Remove bad feature.
     averageScore = filterState.fsm_.getAverageScore(); // TODO: make the following dependent on the ST-score
     if(verbose_) std::cout << "Removing features: ";
-    for(unsigned int i=0;i<mtState::nMax_;i++){
-      if(filterState.fsm_.isValid_[i]){
-        FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[i];
-        if(!f.mpStatistics_->isGoodFeature(trackingUpperBound_,trackingLowerBound_)){
-          if(verbose_) std::cout << filterState.fsm_.features_[i].idx_ << ", ";
-          filterState.fsm_.isValid_[i] = false;
-          filterState.resetFeatureCovariance(i,Eigen::Matrix3d::Identity());
-        }
+    for(const int i : filterState.fsm_.validSlots_){
+      FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[i];
+      if(!f.mpStatistics_->isGoodFeature(trackingUpperBound_,trackingLowerBound_)){
+        if(verbose_) std::cout << filterState.fsm_.features_[i].idx_ << ", ";
+        filterState.fsm_.removeFeature(i);
+        filterState.resetFeatureCovariance(i,Eigen::Matrix3d::Identity());
       }
     }
     if(verbose_) std::cout << " | ";
@@ -913,11 +1005,11 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
     double factor = removalFactor_;
     featureIndex = 0;
     while((int)(mtState::nMax_) - (int)(filterState.fsm_.getValidCount()) < requiredFreeFeature){
-      if(filterState.fsm_.isValid_[featureIndex]){
+      if(filterState.fsm_.isValid(featureIndex)){
         FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[featureIndex];
         if(!f.mpStatistics_->trackedInSomeFrame() && !f.mpStatistics_->isGoodFeature(trackingUpperBound_*factor,trackingLowerBound_*factor)){
           if(verbose_) std::cout << filterState.fsm_.features_[featureIndex].idx_ << ", ";
-          filterState.fsm_.isValid_[featureIndex] = false;
+          filterState.fsm_.removeFeature(featureIndex);
           filterState.resetFeatureCovariance(featureIndex,Eigen::Matrix3d::Identity());
         }
       }
@@ -938,20 +1030,53 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
       } else {
         medianDepthParameters.fill(initDepth_);
       }
+      // Detect the corners on all cameras and levels (the masks only account for the features existing before the detection)
+      if(verbose_) std::cout << "Adding keypoints" << std::endl;
+      const double t0 = (double) cv::getTickCount();
+      for(int camID = 0;camID<mtState::nCam_;camID++){
+        fastDetectors_[camID].setThreshold(fastDetectionThreshold_);
+        if(maskDetectionAroundFeatures_){
+          filterState.fsm_.getPixelsInCamera(camID,detectionMaskPixels_[camID]);
+        } else {
+          detectionMaskPixels_[camID].clear();
+        }
+      }
+      const int nDetectionLevels = startLevel_-endLevel_+1;
+      auto detectionJob = [&](const int i, const int workerId){
+        const int camID = i/nDetectionLevels;
+        fastDetectors_[camID].detect(meas.aux().pyr_[camID],endLevel_+i%nDetectionLevels,detectionMaskPixels_[camID],penaltyDistance_);
+      };
+      if(detectionWorkerPool_){
+        detectionWorkerPool_->parallelFor(mtState::nCam_*nDetectionLevels,detectionJob);
+      } else {
+        for(int i=0;i<mtState::nCam_*nDetectionLevels;i++){
+          detectionJob(i,0);
+        }
+      }
+      const double t1 = (double) cv::getTickCount();
+      detectionMetrics_.detectionTime_ = (t1-t0)/cv::getTickFrequency()*1000;
+      detectionMetrics_.totalDetectionTime_ += detectionMetrics_.detectionTime_;
+      detectionMetrics_.nDetectionRuns_++;
+      if(verbose_) std::cout << "== Detection on levels " << endLevel_ << "-" << startLevel_ << " (" << detectionMetrics_.detectionTime_ << " ms)" << std::endl;
       for(int camID = 0;camID<mtState::nCam_;camID++){
         // Get Candidates
-        if(verbose_) std::cout << "Adding keypoints" << std::endl;
-        const double t1 = (double) cv::getTickCount();
         candidates_.clear();
-        for(int l=endLevel_;l<=startLevel_;l++){
-          meas.aux().pyr_[camID].detectFastCorners(candidates_,l,fastDetectionThreshold_);
-        }
+        candidateResponses_.clear();
+        fastDetectors_[camID].getCandidates(candidates_,candidateResponses_,endLevel_,startLevel_);
+        detectionMetrics_.nDetected_[camID] = candidates_.size();
+        if(verbose_) std::cout << "== Detected " << candidates_.size() << " in camera " << camID << std::endl;
+        filterState.fsm_.preselectCandidates(candidates_,candidateResponses_,meas.aux().pyr_[camID].sizes_[0],camID,detectionCellSize_,detectionCandidatesPerCell_);
+        detectionMetrics_.nPreselected_[camID] = candidates_.size();
         const double t2 = (double) cv::getTickCount();
-        if(verbose_) std::cout << "== Detected " << candidates_.size() << " on levels " << endLevel_ << "-" << startLevel_ << " (" << (t2-t1)/cv::getTickFrequency()*1000 << " ms)" << std::endl;
-        std::unordered_set<unsigned int> newSet = filterState.fsm_.addBestCandidates(candidates_,meas.aux().pyr_[camID],camID,filterState.t_,
-                                                                    endLevel_,startLevel_,(mtState::nMax_-filterState.fsm_.getValidCount())/(mtState::nCam_-camID),nDetectionBuckets_, scoreDetectionExponent_,
-                                                                    penaltyDistance_, zeroDistancePenalty_,false,minAbsoluteSTScore_);
+        if(verbose_) std::cout << "== Preselected " << candidates_.size() << " candidates" << std::endl;
+        const int maxAdd = (mtState::nMax_-filterState.fsm_.getValidCount())/(mtState::nCam_-camID);
+        std::unordered_set<unsigned int> newSet = useWeightGridDetection_ ?
+            filterState.fsm_.addBestCandidatesNew(candidates_,meas.aux().pyr_[camID],camID,filterState.t_,endLevel_,startLevel_,maxAdd,nDetectionBuckets_,scoreDetectionExponent_,
+                                                  penaltyDistance_,zeroDistancePenalty_,false,minAbsoluteSTScore_) :
+            filterState.fsm_.addBestCandidates(candidates_,meas.aux().pyr_[camID],camID,filterState.t_,endLevel_,startLevel_,maxAdd,nDetectionBuckets_,scoreDetectionExponent_,
+                                               penaltyDistance_,zeroDistancePenalty_,false,minAbsoluteSTScore_);
         const double t3 = (double) cv::getTickCount();
+        detectionMetrics_.nAdded_[camID] = newSet.size();
         if(verbose_) std::cout << "== Got " << filterState.fsm_.getValidCount() << " after adding " << newSet.size() << " features in camera " << camID << " (" << (t3-t2)/cv::getTickFrequency()*1000 << " ms)" << std::endl;
         for(auto it = newSet.begin();it != newSet.end();++it){
           FeatureManager<mtState::nLevels_,mtState::patchSize_,mtState::nCam_>& f = filterState.fsm_.features_[*it];
@@ -985,10 +1110,8 @@ ImgOutlierDetection<typename FILTERSTATE::mtState>,false>{
         }
       }
     }
-    for(unsigned int i=0;i<mtState::nMax_;i++){
-      if(filterState.fsm_.isValid_[i]){
-        filterState.fsm_.features_[i].log_previous_ = *filterState.fsm_.features_[i].mpCoordinates_;
-      }
+    for(const int i : filterState.fsm_.validSlots_){
+      filterState.fsm_.features_[i].log_previous_ = *filterState.fsm_.features_[i].mpCoordinates_;
     }
     if (doFrameVisualisation_){
       for(int i=0;i<mtState::nCam_;i++){
@@ -29,6 +29,10 @@
 #ifndef ROVIO_MULTILEVELPATCH_HPP_
 #define ROVIO_MULTILEVELPATCH_HPP_
 
+#include <atomic>
+#include <stdint.h>
+#include <type_traits>
+
 #include "rovio/Patch.hpp"
 #include "rovio/FeatureCoordinates.hpp"
 #include "rovio/ImagePyramid.hpp"
@@ -36,6 +40,8 @@
 namespace rovio{
 
 /** \brief A multilevel patch class.
+ *
+ *    Trivially copyable, standard-layout value type (see Patch), such that copies reduce to memcpy.
  *
  *    @tparam nLevels   - Number of pyramid levels on which the feature is defined.
  *    @tparam patchSize - Edge length of the patches in pixels. Value must be a multiple of 2!.
@@ -47,47 +53,54 @@ class MultilevelPatch{
   static const int nLevels_ = nLevels;  /**<Number of pyramid levels on which the feature is defined.*/
   Patch<patchSize> patches_[nLevels_];  /**<Array, holding the patches on each pyramid level.*/
   bool isValidPatch_[nLevels_];  /**<Array, specifying if there is a valid patch stored at the corresponding location in \ref patches_.*/
-  mutable Eigen::Matrix3f H_;  /**<Hessian matrix, corresponding to the multilevel patches.*/
+  mutable PodMatrix<3,3> H_;  /**<Hessian matrix, corresponding to the multilevel patches.*/
   mutable float e0_;  /**<Smaller eigenvalue of H_.*/
   mutable float e1_;  /**<Larger eigenvalue of H_.*/
   mutable float s_;  /**<Shi-Tomasi score of the multilevel patch feature. @todo define and store method of computation*/
+  uint64_t extractionId_;  /**<Unique id of the extraction which set the patches (shared by copies, 0 if not extracted).
+                               Data derived from the patches can be reused as long as it does not change (\see MultilevelPatchAlignment::prepareJacobians()).*/
 
   /** Constructor
    */
   MultilevelPatch(){
+    static_assert(std::is_trivially_copyable<MultilevelPatch>::value,"MultilevelPatch must stay trivially copyable (copied with memcpy)");
     reset();
   }
 
-  /** Destructor
-   */
-  virtual ~MultilevelPatch(){}
-
   /** \brief Resets the MultilevelPatch.
    *
    * @param idx - feature ID
    * @initTime  - Time at initialization.
    */
   void reset(){
-    H_.setIdentity();
+    H_.map().setIdentity();
     e0_ = 0;
     e1_ = 0;
     s_ = 0;
+    extractionId_ = 0;
     for(unsigned int i = 0;i<nLevels_;i++){
       isValidPatch_[i] = false;
     }
   }
 
+  /** \brief Returns a new unique extraction id (\ref extractionId_), thread-safe.
+   */
+  static uint64_t newExtractionId(){
+    static std::atomic<uint64_t> lastId(0);
+    return ++lastId;
+  }
+
   /** \brief Computes and sets the multilevel Shi-Tomasi Score \ref s_, considering a defined pyramid level interval.
    *
    * @param l1 - Start level (l1<l2)
    * @param l2 - End level (l1<l2)
    */
   void computeMultilevelShiTomasiScore(const int l1 = 0, const int l2 = nLevels_-1) const{
-    H_.setZero();
+    H_.map().setZero();
     int count = 0;
     for(int i=l1;i<=l2;i++){
       if(isValidPatch_[i]){
-        H_ += pow(0.25,i)*patches_[i].getHessian();
+        H_.map() += pow(0.25,i)*patches_[i].getHessian();
         count++;
       }
     }
@@ -117,33 +130,6 @@ class MultilevelPatch{
     }
   }
 
-  /** \brief Draws the patches of the MultilevelPatch into an image.
-   *
-   * @param drawImg    - Image in which should be drawn.
-   * @param c          - Center pixel coordinates of the patch (on level 0)
-   * @param stretch    - %Patch drawing magnification factor.
-   * @param withBorder - Draw either the patches Patch::patch_ (withBorder = false) or the expanded patches
-   *                     Patch::patchWithBorder_ (withBorder = true) .
-   */
-  void drawMultilevelPatch(cv::Mat& drawImg,const cv::Point2i& c,int stretch = 1,const bool withBorder = false) const{
-    for(int l=nLevels_-1;l>=0;l--){
-      if(isValidPatch_[l]){
-        cv::Point2i corner = cv::Point2i((patchSize/2+(int)withBorder)*(pow(2,nLevels_-1)-pow(2,l)),(patchSize/2+(int)withBorder)*(pow(2,nLevels_-1)-pow(2,l)));
-        patches_[l].drawPatch(drawImg,c+corner,stretch*pow(2,l),withBorder);
-      }
-    }
-  }
-
-  /** \brief Draws the patch borders into an image.
-   *
-   * @param drawImg     - Image in which the patch borders should be drawn.
-   * @param s           - Scaling factor.
-   * @param color       - Line color.
-   */
-  void drawMultilevelPatchBorder(cv::Mat& drawImg,const FeatureCoordinates& c,const float s, const cv::Scalar& color) const{
-    patches_[0].drawPatchBorder(drawImg,c,s*pow(2.0,nLevels-1),color);
-  }
-
   /** \brief Computes the RMSE (Root Mean Squared Error) with respect to the patches of an other MultilevelPatch
    *         for an specific pyramid level interval.
    *
@@ -188,8 +174,19 @@ class MultilevelPatch{
    *                      If false, the check is only executed with the general patch dimensions.
    */
   static bool isMultilevelPatchInFrame(const ImagePyramid<nLevels>& pyr,const FeatureCoordinates& c, const int l = nLevels-1,const bool withBorder = false){
-    if(!c.isInFront() || !c.com_warp_c()) return false;
-    FeatureCoordinates coorTemp;
+    PatchCoordinates pc;
+    return c.isInFront() && pc.set(c) && isMultilevelPatchInFrame(pyr,pc,l,withBorder);
+  }
+
+  /** \brief Checks if the MultilevelPatchFeature's patches are fully located within the corresponding images.
+   *
+   * @param pyr         - Image pyramid, which should be checked to fully contain the patches.
+   * @param c           - Pixel coordinates and warping of the patch in the reference image.
+   * @param l           - Maximal pyramid level which should be checked.
+   * @param withBorder  - Check with the expanded patch dimensions.
+   */
+  static bool isMultilevelPatchInFrame(const ImagePyramid<nLevels>& pyr,const PatchCoordinates& c, const int l = nLevels-1,const bool withBorder = false){
+    PatchCoordinates coorTemp;
     pyr.levelTranformCoordinates(c,coorTemp,0,l);
     return Patch<patchSize>::isPatchInFrame(pyr.imgs_[l],coorTemp,withBorder);
   }
@@ -197,21 +194,88 @@ class MultilevelPatch{
   /** \brief Extracts a multilevel patch from a given image pyramid.
    *
    * @param pyr         - Image pyramid from which the patch data should be extracted.
-   * @param l           - Patches are extracted from pyramid level 0 to l.
-   * @param mpCoor      - Coordinates of the patch in the reference image (subpixel coordinates possible).
+   * @param l           - Patches are extracted from pyramid level 0 to l (levels which are not computed in the pyramid are marked invalid).
+   * @param mpCoor      - Coordinates of the patch in the reference image (subpixel coordinates possible). If its pixel coordinates
+   *                      or its warping cannot be computed, the levels are marked invalid.
    * @param mpWarp      - Affine warping matrix. If nullptr not warping is considered.
-   * @param withBorder  - If true, both, the general patches and the corresponding expanded patches are extracted.
+   * @param withBorder  - If true, both, the general patches and the corresponding expanded patches are extracted, and the
+   *                      gradient parameters of the patches are computed. If the pyramid provides gradient images, the gradients
+   *                      are interpolated from them and the expanded patches are not set.
    */
   void extractMultilevelPatchFromImage(const ImagePyramid<nLevels>& pyr,const FeatureCoordinates& c, const int l = nLevels-1,const bool withBorder = false){
+    PatchCoordinates pc;
+    const bool validCoordinates = pc.set(c);
+    assert(validCoordinates);
+    if(!validCoordinates){
+      for(int i=0;i<=l;i++){
+        isValidPatch_[i] = false;
+      }
+      return;
+    }
+    extractMultilevelPatchFromImage(pyr,pc,l,withBorder);
+  }
+
+  /** \brief Extracts a multilevel patch from a given image pyramid.
+   *
+   * @param pyr         - Image pyramid from which the patch data should be extracted.
+   * @param c           - Pixel coordinates and warping of the patch in the reference image.
+   * @param l           - Patches are extracted from pyramid level 0 to l.
+   * @param withBorder  - Additionally extract the expanded patches (or the interpolated gradients) and compute the gradient parameters.
+   */
+  void extractMultilevelPatchFromImage(const ImagePyramid<nLevels>& pyr,const PatchCoordinates& c, const int l = nLevels-1,const bool withBorder = false){
+    PatchCoordinates coorTemp;
+    extractionId_ = newExtractionId();
     for(unsigned int i=0;i<=l;i++){
-      FeatureCoordinates coorTemp;
+      if(!pyr.isLevelComputed(i)){
+        isValidPatch_[i] = false;
+        continue;
+      }
       pyr.levelTranformCoordinates(c,coorTemp,0,i);
       isValidPatch_[i] = true;
-      patches_[i].extractPatchFromImage(pyr.imgs_[i],coorTemp,withBorder);
+      if(withBorder && pyr.hasGradients(i)){
+        patches_[i].extractPatchAndGradientsFromImage(pyr.imgs_[i],pyr.gradX_[i],pyr.gradY_[i],coorTemp);
+      } else {
+        patches_[i].extractPatchFromImage(pyr.imgs_[i],coorTemp,withBorder);
+        if(withBorder){
+          patches_[i].computeGradientParameters();
+        }
+      }
     }
   }
 };
 
+/** \brief Draws the patches of the MultilevelPatch into an image.
+ *
+ * @param drawImg    - Image in which should be drawn.
+ * @param mp         - MultilevelPatch to draw.
+ * @param c          - Center pixel coordinates of the patch (on level 0)
+ * @param stretch    - %Patch drawing magnification factor.
+ * @param withBorder - Draw either the patches Patch::patch_ (withBorder = false) or the expanded patches
+ *                     Patch::patchWithBorder_ (withBorder = true) .
+ */
+template<int nLevels,int patchSize>
+void drawMultilevelPatch(cv::Mat& drawImg,const MultilevelPatch<nLevels,patchSize>& mp,const cv::Point2i& c,int stretch = 1,const bool withBorder = false){
+  for(int l=nLevels-1;l>=0;l--){
+    if(mp.isValidPatch_[l]){
+      cv::Point2i corner = cv::Point2i((patchSize/2+(int)withBorder)*(pow(2,nLevels-1)-pow(2,l)),(patchSize/2+(int)withBorder)*(pow(2,nLevels-1)-pow(2,l)));
+      drawPatch(drawImg,mp.patches_[l],c+corner,stretch*pow(2,l),withBorder);
+    }
+  }
+}
+
+/** \brief Draws the patch borders into an image.
+ *
+ * @param drawImg     - Image in which the patch borders should be drawn.
+ * @param mp          - MultilevelPatch to draw (only its size is used).
+ * @param c           - Coordinates of the patch in the reference image.
+ * @param s           - Scaling factor.
+ * @param color       - Line color.
+ */
+template<int nLevels,int patchSize>
+void drawMultilevelPatchBorder(cv::Mat& drawImg,const MultilevelPatch<nLevels,patchSize>& mp,const FeatureCoordinates& c,const float s, const cv::Scalar& color){
+  drawPatchBorder(drawImg,mp.patches_[0],c,s*pow(2.0,nLevels-1),color);
+}
+
 }
 
 
@@ -29,13 +29,34 @@
 #ifndef ROVIO_MULTILEVELPATCHALIGNMENT_HPP_
 #define ROVIO_MULTILEVELPATCHALIGNMENT_HPP_
 
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
 #include "lightweight_filtering/common.hpp"
 #include "rovio/ImagePyramid.hpp"
 #include "rovio/MultilevelPatch.hpp"
+#include "rovio/MultilevelPatchJacobians.hpp"
 #include "rovio/FeatureCoordinates.hpp"
+#include "rovio/PatchCoordinates.hpp"
+#include "rovio/WorkerPool.hpp"
 
 namespace rovio{
 
+/** \brief Flags of the alignment options. The alignment kernels are instantiated for every combination of the flags and are
+ *         selected at runtime through a dispatch table (\see MultilevelPatchAlignment::refreshPolicy()).
+ */
+enum AlignmentPolicyFlags{
+  ALIGN_INTENSITY_OFFSET = 1 << 0,  /**<Intensity offset compensation.*/
+  ALIGN_INTENSITY_SQEW = 1 << 1,  /**<Intensity sqew compensation.*/
+  ALIGN_WEIGHTING = 1 << 2,  /**<Gaussian weighting of the intensity errors.*/
+  ALIGN_HUBER = 1 << 3,  /**<Huber norm on the intensity errors.*/
+  ALIGN_GRADIENT_WEIGHTING = 1 << 4,  /**<Gradient based weighting of the intensity errors.*/
+  ALIGN_ESM = 1 << 5,  /**<Efficient second-order minimization.*/
+  ALIGN_POLICY_COUNT = 1 << 6  /**<Number of flag combinations.*/
+};
+
 /** \brief %Class for handling the alignement of multilevel patches
  *
  *   @tparam nLevels - Total number of pyramid levels.
@@ -46,12 +67,18 @@ class MultilevelPatchAlignment {
  public:
   mutable Eigen::MatrixXf A_;  /**<A matrix of the linear system of equations, needed for the multilevel patch alignment.*/
   mutable Eigen::MatrixXf b_;  /**<b matrix/vector of the linear system of equations, needed for the multilevel patch alignment.*/
-  mutable Eigen::ColPivHouseholderQR<Eigen::MatrixXf> mColPivHouseholderQR_;  /**<QR decomposition module. Used for computiong reduces system of equations.*/
   mutable Eigen::JacobiSVD<Eigen::MatrixXf> svd_; /**<SVD module. Used for solving linear equation systems.*/
-  mutable FeatureCoordinates bestCoordinateMatch_; /**<Best current pixel coordinate match.*/
+  mutable PatchCoordinates bestCoordinateMatch_; /**<Best current pixel coordinate match.*/
   mutable double bestIntensityError_; /**<Intensity error for the match.*/
   mutable MultilevelPatch<nLevels,patch_size> mlpTemp_; /**<Temporary multilevel patch used for various computations.*/
-  mutable MultilevelPatch<nLevels,patch_size> mlpError_;  /**<Multilevel patch containing errors and its gradient.*/
+  MultilevelPatchJacobians<nLevels,patch_size> jacobians_;  /**<Jacobians of the multilevel patch of the current alignment call (\see prepareJacobians()).*/
+  float patchExtent_[2][2];  /**<Half extents (x,y) of the patch [0] and of the expanded patch [1] for the warping of the current alignment call (\see prepareJacobians()).*/
+  uint64_t preparedExtractionId_;  /**<MultilevelPatch::extractionId_ of the patch for which \ref jacobians_ have been prepared (0 if invalid).*/
+  float preparedWarp_[4];  /**<Warping for which \ref jacobians_ and \ref patchExtent_ have been prepared.*/
+  int preparedLevels_[2];  /**<Levels [l1,l2] for which \ref jacobians_ have been prepared.*/
+  bool preparedHIC_;  /**<Have the inverse compositional Hessians been prepared.*/
+  bool preparedWeighting_;  /**<\ref useWeighting_ when the inverse compositional Hessians were prepared.*/
+  float preparedGradientExponent_;  /**<\ref gradientExponent_ when the inverse compositional Hessians were prepared.*/
   Patch<patch_size> extractedPatches_[nLevels];  /**<Extracted patches used for alignment.*/
   float huberNormThreshold_;  /**<Intensity error threshold for Huber norm.*/
   float w_[nLevels*patch_size*patch_size] __attribute__ ((aligned (16)));  /**<Weighting for patch intensity errors.*/
@@ -59,6 +86,41 @@ class MultilevelPatchAlignment {
   bool useIntensityOffset_; /**<Should an intensity offset between the patches be considered.*/
   bool useIntensitySqew_; /**<Should an intensity sqewing between the patches be considered.*/
   float gradientExponent_;  /**<Exponent used for gradient based weighting of residuals.*/
+  bool useNormalEquations_;  /**<Should align2D() accumulate and solve the 2x2 normal equations (o.w. SVD of the full linear align equations).*/
+  bool useInverseCompositional_;  /**<Should align2D() use the inverse compositional alignment (\see align2DInverseCompositional()).*/
+  bool useESM_;  /**<Should the reference gradients be averaged with the gradients of the current image (efficient second-order minimization).*/
+  int iterationCount_;  /**<Number of iterations carried out during the last call of align2D(), align2DComposed() or align2DAdaptive().*/
+
+  typedef bool (MultilevelPatchAlignment::*LinearEquationsFunction)(const ImagePyramid<nLevels>&, const MultilevelPatch<nLevels,patch_size>&,
+      const PatchCoordinates&, const int, const int, Eigen::MatrixXf&, Eigen::MatrixXf&);
+  typedef bool (MultilevelPatchAlignment::*NormalEquationsFunction)(const ImagePyramid<nLevels>&, const MultilevelPatch<nLevels,patch_size>&,
+      const PatchCoordinates&, const int, const int, Eigen::Matrix2f&, Eigen::Vector2f&, Eigen::Matrix2f*);
+  struct ErrorPatchAccumulator;
+  typedef int (MultilevelPatchAlignment::*AlignErrorsFunction)(const ImagePyramid<nLevels>&, const MultilevelPatch<nLevels,patch_size>&,
+      const PatchCoordinates&, const int, const int, ErrorPatchAccumulator&);
+
+  /** \brief Specialized alignment kernels of a set of \ref AlignmentPolicyFlags.
+   */
+  struct PolicyFunctions{
+    LinearEquationsFunction linearEquations_;  /**<getLinearAlignEquations<Policy>().*/
+    NormalEquationsFunction normalEquations_;  /**<getLinearAlignNormalEquations<Policy>().*/
+    AlignErrorsFunction alignErrors_;  /**<computeAlignErrorPatches<Policy>().*/
+  };
+  int policyFlags_;  /**<\ref AlignmentPolicyFlags of the selected kernels.*/
+  PolicyFunctions policyFunctions_;  /**<Selected alignment kernels.*/
+
+  /** \brief Result of a single seed of align2DAdaptive().
+   */
+  struct SeedResult{
+    PatchCoordinates c_;  /**<Aligned coordinates.*/
+    float avgError_;  /**<Average intensity error of the aligned patch.*/
+    int iterationCount_;  /**<Number of iterations of the alignment (0 if cancelled).*/
+    bool valid_;  /**<Did the alignment converge with the patch in frame.*/
+  };
+  std::shared_ptr<WorkerPool> seedWorkerPool_;  /**<Worker pool for the parallel seed evaluation in align2DAdaptive() (nullptr: sequential). Shared by copies, which must thus not align concurrently.*/
+  std::vector<std::shared_ptr<MultilevelPatchAlignment>> seedAlignments_;  /**<Scratch alignment of every seed worker.*/
+  std::vector<SeedResult> seedResults_;  /**<Results of the seeds of the last parallel align2DAdaptive().*/
+  float seedCancelIntensityError_;  /**<Average intensity error below which a seed is a clear winner and cancels all seeds of lower priority (disabled if <= 0).*/
 
   /** \brief Constructor
    */
@@ -69,6 +131,13 @@ class MultilevelPatchAlignment {
     useIntensityOffset_ = true;
     useIntensitySqew_ = true;
     gradientExponent_ = 0.0;
+    useNormalEquations_ = false;
+    useInverseCompositional_ = false;
+    useESM_ = false;
+    iterationCount_ = 0;
+    seedCancelIntensityError_ = 0.0;
+    preparedExtractionId_ = 0;
+    refreshPolicy();
   }
 
   /** \brief Computes the weigting mask for patches
@@ -76,6 +145,7 @@ class MultilevelPatchAlignment {
    * @param sigma - widtf of Gaussian filter
    */
   void computeWeightings(const float sigma){
+    preparedExtractionId_ = 0; // The inverse compositional Hessians depend on the weights
     useWeighting_ = sigma > 0;
     if(useWeighting_){
       for(int l = 0; l < nLevels; l++){
@@ -94,33 +164,151 @@ class MultilevelPatchAlignment {
    */
   virtual ~MultilevelPatchAlignment(){};
 
-  /** \brief Get the raw linear align equations (A*x=b), given by the [(#pixel)x2] Matrix  A (float) and the [(#pixel)x1] vector b (float).
+  /** \brief Copies the alignment options (not the temporaries) from another alignment.
    *
-   *  \see MultilevelPatchFeature::A_ and MultilevelPatchFeature::b_.
-   *  \see Function getLinearAlignEquationsReduced() to get an optimized linear align equations.
+   * @param other - Alignment to copy the options from.
+   */
+  void copyOptions(const MultilevelPatchAlignment& other){
+    huberNormThreshold_ = other.huberNormThreshold_;
+    std::copy(other.w_,other.w_+nLevels*patch_size*patch_size,w_);
+    useWeighting_ = other.useWeighting_;
+    useIntensityOffset_ = other.useIntensityOffset_;
+    useIntensitySqew_ = other.useIntensitySqew_;
+    gradientExponent_ = other.gradientExponent_;
+    useNormalEquations_ = other.useNormalEquations_;
+    useInverseCompositional_ = other.useInverseCompositional_;
+    useESM_ = other.useESM_;
+    refreshPolicy();
+  }
+
+  /** \brief Sets the number of workers for the parallel seed evaluation in align2DAdaptive().
+   *
+   * @param nWorkers - Number of workers, including the calling thread (sequential evaluation if <= 1).
+   */
+  void setSeedWorkers(const int nWorkers){
+    if(nWorkers <= 1){
+      seedWorkerPool_.reset();
+      seedAlignments_.clear();
+    } else if(!seedWorkerPool_ || seedWorkerPool_->size() != nWorkers){
+      seedWorkerPool_.reset(new WorkerPool(nWorkers));
+      seedAlignments_.clear();
+      for(int i=0;i<nWorkers;i++){
+        seedAlignments_.emplace_back(new MultilevelPatchAlignment());
+      }
+    }
+  }
+
+  /** \brief Returns the \ref AlignmentPolicyFlags corresponding to the current runtime configuration.
+   */
+  int getPolicyFlags() const{
+    return (useIntensityOffset_ ? ALIGN_INTENSITY_OFFSET : 0)
+         | (useIntensitySqew_ ? ALIGN_INTENSITY_SQEW : 0)
+         | (useWeighting_ ? ALIGN_WEIGHTING : 0)
+         | (huberNormThreshold_ > 0.0 ? ALIGN_HUBER : 0)
+         | (gradientExponent_ > 0.0 ? ALIGN_GRADIENT_WEIGHTING : 0)
+         | (useESM_ ? ALIGN_ESM : 0);
+  }
+
+  /** \brief Selects the specialized alignment kernels from the dispatch table, based on the current runtime configuration.
+   *         Should be called whenever the alignment options are changed (done in ImgUpdate::refreshProperties()). The
+   *         entry points additionally re-select if the options were changed without refreshing.
+   */
+  void refreshPolicy(){
+    policyFlags_ = getPolicyFlags();
+    policyFunctions_ = getPolicyTable()[policyFlags_];
+  }
+
+  /** \brief Returns the dispatch table, containing the specialized alignment kernels for every combination of
+   *         \ref AlignmentPolicyFlags.
+   */
+  static const PolicyFunctions* getPolicyTable(){
+    static PolicyFunctions table[ALIGN_POLICY_COUNT];
+    static const bool filled = fillPolicyTable(table,std::integral_constant<int,ALIGN_POLICY_COUNT-1>());
+    (void)filled;
+    return table;
+  }
+
+  /** \brief Recursively fills the dispatch table for the policies 0 to Policy.
+   */
+  template<int Policy>
+  static bool fillPolicyTable(PolicyFunctions* table, std::integral_constant<int,Policy>){
+    table[Policy].linearEquations_ = &MultilevelPatchAlignment::getLinearAlignEquations<Policy>;
+    table[Policy].normalEquations_ = &MultilevelPatchAlignment::getLinearAlignNormalEquations<Policy>;
+    table[Policy].alignErrors_ = &MultilevelPatchAlignment::computeAlignErrorPatches<Policy>;
+    return fillPolicyTable(table,std::integral_constant<int,Policy-1>());
+  }
+  static bool fillPolicyTable(PolicyFunctions* table, std::integral_constant<int,-1>){
+    return true;
+  }
+
+  /** \brief Computes the Jacobians of a multilevel patch for the levels [l1,l2] (\ref jacobians_), and the extents of the
+   *         warped patch for the in-frame tests (\ref patchExtent_, the same on all levels). They are reused by all iterations
+   *         of an alignment call, and by subsequent calls for the same extraction of the patch (MultilevelPatch::extractionId_),
+   *         the same warping and the same levels (e.g. getLinearAlignEquationsReduced() after align2DAdaptive()).
+   *
+   * @param mp          - \ref MultilevelPatch, which contains the patches.
+   * @param c           - Coordinates of the patch in the reference image (only the warping is used).
+   * @param l1          - Start pyramid level (l1<l2)
+   * @param l2          - End pyramid level (l1<l2)
+   * @param withHIC     - Additionally compute the Hessians of the inverse compositional alignment.
+   */
+  void prepareJacobians(const MultilevelPatch<nLevels,patch_size>& mp, const PatchCoordinates& c, const int l1, const int l2, const bool withHIC){
+    if(mp.extractionId_ != 0 && mp.extractionId_ == preparedExtractionId_ && l1 == preparedLevels_[0] && l2 == preparedLevels_[1]
+       && std::memcmp(c.warp_,preparedWarp_,sizeof(preparedWarp_)) == 0
+       && (!withHIC || (preparedHIC_ && useWeighting_ == preparedWeighting_ && gradientExponent_ == preparedGradientExponent_))){
+      return;
+    }
+    for(int withBorder=0; withBorder<2; withBorder++){
+      Patch<patch_size>::getPatchExtent(c,withBorder,patchExtent_[withBorder][0],patchExtent_[withBorder][1]);
+    }
+    const float* w = useWeighting_ ? w_ : nullptr;
+    if(c.isNearIdentityWarping()){
+      jacobians_.compute(mp,l1,l2,nullptr,withHIC,w,gradientExponent_);
+    } else {
+      const Eigen::Matrix2f affInv = c.get_warp_c().inverse();
+      jacobians_.compute(mp,l1,l2,&affInv,withHIC,w,gradientExponent_);
+    }
+    preparedExtractionId_ = mp.extractionId_;
+    std::memcpy(preparedWarp_,c.warp_,sizeof(preparedWarp_));
+    preparedLevels_[0] = l1;
+    preparedLevels_[1] = l2;
+    preparedHIC_ = withHIC;
+    preparedWeighting_ = useWeighting_;
+    preparedGradientExponent_ = gradientExponent_;
+  }
+
+  /** \brief Computes the patch intensity errors and the corresponding Jacobians for the patch alignment, including the
+   *         compensation of the linear brightness change (intensity offset and sqew), and passes them pixel by pixel to an
+   *         accumulator (\see LinearEquationsAccumulator, NormalEquationsAccumulator and ErrorPatchAccumulator). Without
+   *         intensity compensation this is done while extracting the patches, otherwise in a second pass once the means are known.
+   *         If \ref ALIGN_ESM is set, the Jacobians are averaged with the gradients of the current image (efficient second-order
+   *         minimization), which requires the expanded patches to be within the image.
+   *         The Jacobians of mp must have been prepared for the levels (\see prepareJacobians()).
    *
+   * @tparam Policy     - \ref AlignmentPolicyFlags.
+   * @tparam Accumulator - Type of the accumulator. Provides begin(numRows) and operator()(l,i,error,dx_error,dy_error,w).
    * @param pyr         - Considered image pyramid.
    * @param mp          - \ref MultilevelPatch, which contains the patches.
    * @param c           - Coordinates of the patch in the reference image.
    * @param l1          - Start pyramid level (l1<l2)
    * @param l2          - End pyramid level (l1<l2)
-   * @param A           - Jacobian of the pixel intensities w.r.t. to pixel coordinates
-   * @param b           - Intensity errors
-   * @return true, if successful.
+   * @param acc         - Accumulator, called in order of the rows of the linear align equations.
+   * @return the number of valid levels (0 if not successful).
    * @todo catch if warping too distorted
    */
-  bool getLinearAlignEquations(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& c, const int l1, const int l2,
-                               Eigen::MatrixXf& A, Eigen::MatrixXf& b){
-    A.resize(0,0);
-    b.resize(0,0);
-    Eigen::Matrix2f affInv;
-    if(!c.com_c() || !c.com_warp_c()){
-      return false;
-    }
-    affInv = c.get_warp_c().inverse();
+  template<int Policy, typename Accumulator>
+  int computeAlignErrors(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PatchCoordinates& c, const int l1, const int l2,
+                         Accumulator& acc){
+    const bool useIntensityOffset = (Policy & ALIGN_INTENSITY_OFFSET) != 0;
+    const bool useIntensitySqew = (Policy & ALIGN_INTENSITY_SQEW) != 0;
+    const bool useWeighting = (Policy & ALIGN_WEIGHTING) != 0;
+    const bool useESM = (Policy & ALIGN_ESM) != 0;
+    const bool useIntensityCompensation = useIntensityOffset || useIntensitySqew;
+    const bool nearIdentity = c.isNearIdentityWarping();
+    const Eigen::Matrix2f esmWarp = nearIdentity ? Eigen::Matrix2f::Identity() : Eigen::Matrix2f(c.get_warp_c().inverse()); // Maps the current gradients onto the Jacobians
     int numLevel = 0;
-    FeatureCoordinates c_level;
-    const int halfpatch_size = patch_size/2;
+    bool validLevel[nLevels];
+    PatchCoordinates c_level[nLevels];
     float wTot = 0;
     float mean_x = 0;
     float mean_xx = 0;
@@ -131,169 +319,453 @@ class MultilevelPatchAlignment {
     float mean_y_dx = 0;
     float mean_y_dy = 0;
 
-    // Compute raw error and gradients, as well as mean
-    for(int l = 0; l < nLevels; l++){
-      mlpError_.isValidPatch_[l] = false;
+    // Jacobians of a level and the level-scaled warping of the current gradients (ESM), set once per valid level
+    struct LevelJacobians{
+      const float* Jx;
+      const float* Jy;
+      float esm00, esm01, esm10, esm11;
+    } levelJacobians[nLevels];
+
+    // Jacobian of the raw error, optionally averaged with the gradients of the current image (ESM)
+    auto rawJacobian = [&](const LevelJacobians& lj, const int l, const int i, float& dx_error, float& dy_error){
+      if(useESM){ // extractedPatches_[l].dx_/dy_ are only valid for ESM (extraction with border)
+        const float dx_extracted = extractedPatches_[l].dx_[i];
+        const float dy_extracted = extractedPatches_[l].dy_[i];
+        dx_error = 0.5f*(lj.Jx[i] + dx_extracted*lj.esm00+dy_extracted*lj.esm10);
+        dy_error = 0.5f*(lj.Jy[i] + dx_extracted*lj.esm01+dy_extracted*lj.esm11);
+      } else {
+        dx_error = lj.Jx[i];
+        dy_error = lj.Jy[i];
+      }
+    };
+
+    // Find the valid levels
+    for(int l = l1; l <= l2; l++){
+      pyr.levelTranformCoordinates(c,c_level[l],0,l);
+      validLevel[l] = false;
+      if(mp.isValidPatch_[l] && Patch<patch_size>::isPatchInFrame(pyr.imgs_[l],c_level[l].get_c(),patchExtent_[useESM][0],patchExtent_[useESM][1])){
+        assert(mp.patches_[l].validGradientParameters_); // Computed when mp was extracted, mp is only read here
+        validLevel[l] = true;
+        numLevel++;
+        LevelJacobians& lj = levelJacobians[l];
+        lj.Jx = jacobians_.getJx(l,!nearIdentity);
+        lj.Jy = jacobians_.getJy(l,!nearIdentity);
+        if(useESM){
+          const float scale = -pow(0.5,l);
+          lj.esm00 = scale*esmWarp(0,0);
+          lj.esm01 = scale*esmWarp(0,1);
+          lj.esm10 = scale*esmWarp(1,0);
+          lj.esm11 = scale*esmWarp(1,1);
+        }
+      }
+    }
+    if(numLevel==0){
+      return 0;
     }
+    acc.begin(numLevel*patch_size*patch_size);
+
+    // Compute raw error and gradients, and either pass them on directly or compute the means
     for(int l = l1; l <= l2; l++){
-      pyr.levelTranformCoordinates(c,c_level,0,l);
-      if(mp.isValidPatch_[l] && extractedPatches_[l].isPatchInFrame(pyr.imgs_[l],c_level,false)){
-        mp.patches_[l].computeGradientParameters();
-        if(mp.patches_[l].validGradientParameters_){
-          mlpError_.isValidPatch_[l] = true;
-          numLevel++;
-          extractedPatches_[l].extractPatchFromImage(pyr.imgs_[l],c_level,false);
-          const float* it_patch_extracted = extractedPatches_[l].patch_;
-          const float* it_patch = mp.patches_[l].patch_;
-          const float* it_dx = mp.patches_[l].dx_;
-          const float* it_dy = mp.patches_[l].dy_;
-//          extractedPatches_[l].computeGradientParameters();
-//          const float* it_dx_extracted = extractedPatches_[l].dx_; // TODO: investigate further averaging of gradients
-//          const float* it_dy_extracted = extractedPatches_[l].dy_;
-          float* it_error = mlpError_.patches_[l].patch_;
-          float* it_dx_error = mlpError_.patches_[l].dx_;
-          float* it_dy_error = mlpError_.patches_[l].dy_;
-          const float* it_w = &w_[l*patch_size*patch_size];
-          for(int y=0; y<patch_size; ++y){
-            for(int x=0; x<patch_size; ++x, ++it_patch, ++it_patch_extracted, ++it_dx, ++it_dy, ++it_error, ++it_dx_error, ++it_dy_error, ++it_w){
-              *it_error = *it_patch_extracted - *it_patch;
-              const float Jx = -pow(0.5,l)*(*it_dx); // TODO: make pre-computation in Patch
-              const float Jy = -pow(0.5,l)*(*it_dy);
-              if(c.isNearIdentityWarping()){
-                *it_dx_error = Jx;
-                *it_dy_error = Jy;
-              } else {
-                *it_dx_error = Jx*affInv(0,0)+Jy*affInv(1,0);
-                *it_dy_error = Jx*affInv(0,1)+Jy*affInv(1,1);
-              }
-              if(useIntensityOffset_ || useIntensitySqew_){
-                if(useWeighting_){
-                  mean_x += (*it_w)*(*it_patch);
-                  mean_y += (*it_w)*(*it_patch_extracted);
-                  mean_y_dx += (*it_w)*(*it_dx_error);
-                  mean_y_dy += (*it_w)*(*it_dy_error);
-                  wTot += *it_w;
-                } else {
-                  mean_x += *it_patch;
-                  mean_y += *it_patch_extracted;
-                  mean_y_dx += *it_dx_error;
-                  mean_y_dy += *it_dy_error;
-                  wTot += 1.0;
-                }
-              }
-              if(useIntensitySqew_){
-                if(useWeighting_){
-                  mean_xx += (*it_w)*(*it_patch)*(*it_patch);
-                  mean_xy += (*it_w)*(*it_patch)*(*it_patch_extracted);
-                  mean_xy_dx += (*it_w)*(*it_patch)*(*it_dx_error);
-                  mean_xy_dy += (*it_w)*(*it_patch)*(*it_dy_error);
-                } else {
-                  mean_xx += (*it_patch)*(*it_patch);
-                  mean_xy += (*it_patch)*(*it_patch_extracted);
-                  mean_xy_dx += (*it_patch)*(*it_dx_error);
-                  mean_xy_dy += (*it_patch)*(*it_dy_error);
-                }
-              }
-            }
+      if(validLevel[l]){
+        if(useESM && pyr.hasGradients(l)){
+          extractedPatches_[l].extractPatchAndGradientsFromImage(pyr.imgs_[l],pyr.gradX_[l],pyr.gradY_[l],c_level[l]);
+        } else {
+          extractedPatches_[l].extractPatchFromImage(pyr.imgs_[l],c_level[l],useESM);
+        }
+        const float* it_patch_extracted = extractedPatches_[l].patch_;
+        const float* it_patch = mp.patches_[l].patch_;
+        const float* it_w = &w_[l*patch_size*patch_size];
+        const LevelJacobians& lj = levelJacobians[l];
+        float dx_error, dy_error;
+        for(int i=0; i<patch_size*patch_size; ++i, ++it_patch, ++it_patch_extracted, ++it_w){
+          rawJacobian(lj,l,i,dx_error,dy_error);
+          if(!useIntensityCompensation){
+            acc(l,i,*it_patch_extracted - *it_patch,dx_error,dy_error,*it_w);
+            continue;
+          }
+          const float w = useWeighting ? *it_w : 1.0f;
+          mean_x += w*(*it_patch);
+          mean_y += w*(*it_patch_extracted);
+          mean_y_dx += w*dx_error;
+          mean_y_dy += w*dy_error;
+          wTot += w;
+          if(useIntensitySqew){
+            mean_xx += w*(*it_patch)*(*it_patch);
+            mean_xy += w*(*it_patch)*(*it_patch_extracted);
+            mean_xy_dx += w*(*it_patch)*dx_error;
+            mean_xy_dy += w*(*it_patch)*dy_error;
           }
         }
       }
     }
-    if(numLevel==0){
-      return false;
+    if(!useIntensityCompensation){
+      return numLevel;
     }
 
     float reg_a, reg_a_dx, reg_a_dy, reg_b, reg_b_dx, reg_b_dy;
-    if(useIntensityOffset_ || useIntensitySqew_){
-      mean_x = mean_x/wTot;
-      mean_xx = mean_xx/wTot;
-      mean_xy = mean_xy/wTot;
-      mean_xy_dx = mean_xy_dx/wTot;
-      mean_xy_dy = mean_xy_dy/wTot;
-      mean_y = mean_y/wTot;
-      mean_y_dx = mean_y_dx/wTot;
-      mean_y_dy = mean_y_dy/wTot;
-
-      if(useIntensitySqew_){
-        reg_a = (mean_xy-mean_x*mean_y)/(mean_xx-mean_x*mean_x);
-        reg_a_dx = (mean_xy_dx-mean_x*mean_y_dx)/(mean_xx-mean_x*mean_x);
-        reg_a_dy = (mean_xy_dy-mean_x*mean_y_dy)/(mean_xx-mean_x*mean_x);
-        if(reg_a < 0.5f){
-          reg_a = 0.5;
-          reg_a_dx = 0.0;
-          reg_a_dy = 0.0;
-        }
-      } else {
-        reg_a = 1.0;
+    mean_x = mean_x/wTot;
+    mean_xx = mean_xx/wTot;
+    mean_xy = mean_xy/wTot;
+    mean_xy_dx = mean_xy_dx/wTot;
+    mean_xy_dy = mean_xy_dy/wTot;
+    mean_y = mean_y/wTot;
+    mean_y_dx = mean_y_dx/wTot;
+    mean_y_dy = mean_y_dy/wTot;
+
+    if(useIntensitySqew){
+      reg_a = (mean_xy-mean_x*mean_y)/(mean_xx-mean_x*mean_x);
+      reg_a_dx = (mean_xy_dx-mean_x*mean_y_dx)/(mean_xx-mean_x*mean_x);
+      reg_a_dy = (mean_xy_dy-mean_x*mean_y_dy)/(mean_xx-mean_x*mean_x);
+      if(reg_a < 0.5f){
+        reg_a = 0.5;
         reg_a_dx = 0.0;
         reg_a_dy = 0.0;
       }
-      if(useIntensityOffset_){
-        reg_b = mean_y-reg_a*mean_x;
-        reg_b_dx = mean_y_dx-reg_a_dx*mean_x;
-        reg_b_dy = mean_y_dy-reg_a_dy*mean_x;
-      } else {
-        reg_b = 0.0;
-        reg_b_dx = 0.0;
-        reg_b_dy = 0.0;
-      }
+    } else {
+      reg_a = 1.0;
+      reg_a_dx = 0.0;
+      reg_a_dy = 0.0;
+    }
+    if(useIntensityOffset){
+      reg_b = mean_y-reg_a*mean_x;
+      reg_b_dx = mean_y_dx-reg_a_dx*mean_x;
+      reg_b_dy = mean_y_dy-reg_a_dy*mean_x;
+    } else {
+      reg_b = 0.0;
+      reg_b_dx = 0.0;
+      reg_b_dy = 0.0;
     }
 
-    // Compute correct patch error and gradient (based on linear brightness fix), apply Huber norm, apply weighting
-    numLevel = 0;
+    // Compute correct patch error and gradient (based on linear brightness fix)
     for(int l = l1; l <= l2; l++){
-      if(mlpError_.isValidPatch_[l]){
-        numLevel++;
-        A.conservativeResize(numLevel*patch_size*patch_size,2);
-        b.conservativeResize(numLevel*patch_size*patch_size,1);
+      if(validLevel[l]){
         const float* it_patch = mp.patches_[l].patch_;
         const float* it_patch_extracted = extractedPatches_[l].patch_;
-        float* it_error = mlpError_.patches_[l].patch_;
-        float* it_dx_error = mlpError_.patches_[l].dx_;
-        float* it_dy_error = mlpError_.patches_[l].dy_;
         const float* it_w = &w_[l*patch_size*patch_size];
-        for(int y=0; y<patch_size; ++y){
-          for(int x=0; x<patch_size; ++x, ++it_patch, ++it_patch_extracted, ++it_error,  ++it_dx_error, ++it_dy_error, ++it_w){
-            if(useIntensityOffset_ || useIntensitySqew_){
-              *it_error = *it_patch_extracted - reg_a*(*it_patch) - reg_b;
-              *it_dx_error = reg_a*(*it_dx_error - reg_a_dx*(*it_patch) - reg_b_dx);
-              *it_dy_error = reg_a*(*it_dy_error - reg_a_dy*(*it_patch) - reg_b_dy);
-            }
-            b((numLevel-1)*patch_size*patch_size+y*patch_size+x,0) = *it_error;
-            A((numLevel-1)*patch_size*patch_size+y*patch_size+x,0) = *it_dx_error;
-            A((numLevel-1)*patch_size*patch_size+y*patch_size+x,1) = *it_dy_error;
-
-            if(huberNormThreshold_ > 0.0){ // TODO: investigate why 1.0 leads to non-deterministic behavior
-              const float b_abs = std::fabs(*it_error);
-              if(b_abs > huberNormThreshold_){
-                b((numLevel-1)*patch_size*patch_size+y*patch_size+x,0) = std::sqrt(huberNormThreshold_*(2.0*b_abs - huberNormThreshold_));
-                const float f = huberNormThreshold_/b((numLevel-1)*patch_size*patch_size+y*patch_size+x,0)*copysign(1.0, *it_error);
-                A((numLevel-1)*patch_size*patch_size+y*patch_size+x,0) = f*A((numLevel-1)*patch_size*patch_size+y*patch_size+x,0);
-                A((numLevel-1)*patch_size*patch_size+y*patch_size+x,1) = f*A((numLevel-1)*patch_size*patch_size+y*patch_size+x,1);
-              }
-            }
+        const LevelJacobians& lj = levelJacobians[l];
+        float dx_error, dy_error;
+        for(int i=0; i<patch_size*patch_size; ++i, ++it_patch, ++it_patch_extracted, ++it_w){
+          rawJacobian(lj,l,i,dx_error,dy_error);
+          acc(l,i,*it_patch_extracted - reg_a*(*it_patch) - reg_b,
+              reg_a*(dx_error - reg_a_dx*(*it_patch) - reg_b_dx),
+              reg_a*(dy_error - reg_a_dy*(*it_patch) - reg_b_dy),*it_w);
+        }
+      }
+    }
+    return numLevel;
+  }
 
-            if(gradientExponent_ >0.0){
-              const float gradientBasedWeighting = 1.0-std::pow(((*it_dx_error)*(*it_dx_error)+(*it_dy_error)*(*it_dy_error))/(2*128*128),0.5*gradientExponent_);
-              b((numLevel-1)*patch_size*patch_size+y*patch_size+x,0) *= gradientBasedWeighting;
-              A((numLevel-1)*patch_size*patch_size+y*patch_size+x,0) *= gradientBasedWeighting;
-              A((numLevel-1)*patch_size*patch_size+y*patch_size+x,1) *= gradientBasedWeighting;
-            }
+  /** \brief Computes a single (weighted) row of the linear align equations. Applies the Huber norm, the gradient based
+   *         weighting and the Gaussian weighting.
+   *
+   * @tparam Policy     - \ref AlignmentPolicyFlags.
+   * @param error       - Intensity error of the pixel.
+   * @param dx_error    - Jacobian of the intensity error w.r.t. the x-coordinate.
+   * @param dy_error    - Jacobian of the intensity error w.r.t. the y-coordinate.
+   * @param w           - Gaussian weight of the pixel.
+   * @param A0          - Weighted Jacobian w.r.t. the x-coordinate.
+   * @param A1          - Weighted Jacobian w.r.t. the y-coordinate.
+   * @param b           - Weighted intensity error.
+   */
+  template<int Policy>
+  void computeAlignEquationRow(const float error, const float dx_error, const float dy_error, const float w, float& A0, float& A1, float& b) const{
+    b = error;
+    A0 = dx_error;
+    A1 = dy_error;
+    if(Policy & ALIGN_HUBER){ // TODO: investigate why 1.0 leads to non-deterministic behavior
+      const float b_abs = std::fabs(error);
+      if(b_abs > huberNormThreshold_){
+        b = std::sqrt(huberNormThreshold_*(2.0*b_abs - huberNormThreshold_));
+        const float f = huberNormThreshold_/b*copysign(1.0, error);
+        A0 = f*A0;
+        A1 = f*A1;
+      }
+    }
+    if(Policy & ALIGN_GRADIENT_WEIGHTING){
+      const float gradientBasedWeighting = 1.0-std::pow((dx_error*dx_error+dy_error*dy_error)/(2*128*128),0.5*gradientExponent_);
+      b *= gradientBasedWeighting;
+      A0 *= gradientBasedWeighting;
+      A1 *= gradientBasedWeighting;
+    }
+    if(Policy & ALIGN_WEIGHTING){
+      b *= w;
+      A0 *= w;
+      A1 *= w;
+    }
+  }
 
-            if(useWeighting_){
-              b((numLevel-1)*patch_size*patch_size+y*patch_size+x,0) *= *it_w;
-              A((numLevel-1)*patch_size*patch_size+y*patch_size+x,0) *= *it_w;
-              A((numLevel-1)*patch_size*patch_size+y*patch_size+x,1) *= *it_w;
-            }
-          }
-        }
+  /** \brief Accumulator of computeAlignErrors(), storing the weighted rows of the linear align equations in A and b.
+   */
+  template<int Policy>
+  struct LinearEquationsAccumulator{
+    const MultilevelPatchAlignment& alignment_;  /**<Alignment, providing the weighting options.*/
+    Eigen::MatrixXf& A_;  /**<Jacobian of the pixel intensities w.r.t. to pixel coordinates.*/
+    Eigen::MatrixXf& b_;  /**<Intensity errors.*/
+    int row_;  /**<Next row.*/
+    LinearEquationsAccumulator(const MultilevelPatchAlignment& alignment, Eigen::MatrixXf& A, Eigen::MatrixXf& b): alignment_(alignment), A_(A), b_(b), row_(0){}
+    void begin(const int numRows){
+      A_.resize(numRows,2);
+      b_.resize(numRows,1);
+    }
+    void operator()(const int l, const int i, const float error, const float dx_error, const float dy_error, const float w){
+      alignment_.template computeAlignEquationRow<Policy>(error,dx_error,dy_error,w,A_(row_,0),A_(row_,1),b_(row_,0));
+      ++row_;
+    }
+  };
+
+  /** \brief Accumulator of computeAlignErrors(), summing up the normal equations of the weighted rows of the linear align equations.
+   */
+  template<int Policy>
+  struct NormalEquationsAccumulator{
+    const MultilevelPatchAlignment& alignment_;  /**<Alignment, providing the weighting options.*/
+    Eigen::Matrix2f* ATop_;  /**<If not nullptr, the first two rows of A are stored here.*/
+    int row_;  /**<Next row.*/
+    float a00_, a01_, a11_, b0_, b1_;  /**<Entries of A^T*A and A^T*b.*/
+    NormalEquationsAccumulator(const MultilevelPatchAlignment& alignment, Eigen::Matrix2f* ATop): alignment_(alignment), ATop_(ATop), row_(0),
+        a00_(0), a01_(0), a11_(0), b0_(0), b1_(0){}
+    void begin(const int numRows){}
+    void operator()(const int l, const int i, const float error, const float dx_error, const float dy_error, const float w){
+      float A0, A1, e;
+      alignment_.template computeAlignEquationRow<Policy>(error,dx_error,dy_error,w,A0,A1,e);
+      if(ATop_ != nullptr && row_ < 2){
+        (*ATop_)(row_,0) = A0;
+        (*ATop_)(row_,1) = A1;
+      }
+      ++row_;
+      a00_ += A0*A0;
+      a01_ += A0*A1;
+      a11_ += A1*A1;
+      b0_ += A0*e;
+      b1_ += A1*e;
+    }
+  };
+
+  /** \brief Accumulator of computeAlignErrors(), storing the (unweighted) intensity errors and their Jacobians in a multilevel patch.
+   */
+  struct ErrorPatchAccumulator{
+    MultilevelPatch<nLevels,patch_size>& mlpError_;  /**<Errors in Patch::patch_, Jacobians in Patch::dx_ and Patch::dy_ of the valid levels.*/
+    ErrorPatchAccumulator(MultilevelPatch<nLevels,patch_size>& mlpError): mlpError_(mlpError){
+      for(int l = 0; l < nLevels; l++){
+        mlpError_.isValidPatch_[l] = false;
       }
     }
+    void begin(const int numRows){}
+    void operator()(const int l, const int i, const float error, const float dx_error, const float dy_error, const float w){
+      mlpError_.isValidPatch_[l] = true;
+      mlpError_.patches_[l].patch_[i] = error;
+      mlpError_.patches_[l].dx_[i] = dx_error;
+      mlpError_.patches_[l].dy_[i] = dy_error;
+    }
+  };
+
+  /** \brief Get the intensity errors and their Jacobians (including the compensation of the linear brightness change, without
+   *         any weighting), e.g. for logging the result of an alignment.
+   *
+   * @param pyr         - Considered image pyramid.
+   * @param mp          - \ref MultilevelPatch, which contains the patches.
+   * @param c           - Coordinates of the patch in the reference image.
+   * @param l1          - Start pyramid level (l1<l2)
+   * @param l2          - End pyramid level (l1<l2)
+   * @param mlpError    - Errors in Patch::patch_, Jacobians in Patch::dx_ and Patch::dy_ of the valid levels.
+   * @return true, if successful.
+   */
+  bool getAlignErrors(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& c, const int l1, const int l2,
+                      MultilevelPatch<nLevels,patch_size>& mlpError){
+    ErrorPatchAccumulator acc(mlpError);
+    PatchCoordinates pc;
+    if(!pc.set(c)){
+      return false;
+    }
+    if(policyFlags_ != getPolicyFlags()) refreshPolicy();
+    prepareJacobians(mp,pc,l1,l2,false);
+    return (this->*policyFunctions_.alignErrors_)(pyr,mp,pc,l1,l2,acc) > 0;
+  }
+
+  /** \brief Get the raw linear align equations (A*x=b), given by the [(#pixel)x2] Matrix  A (float) and the [(#pixel)x1] vector b (float).
+   *
+   *  \see MultilevelPatchFeature::A_ and MultilevelPatchFeature::b_.
+   *  \see Function getLinearAlignEquationsReduced() to get an optimized linear align equations.
+   *
+   * @param pyr         - Considered image pyramid.
+   * @param mp          - \ref MultilevelPatch, which contains the patches.
+   * @param c           - Coordinates of the patch in the reference image.
+   * @param l1          - Start pyramid level (l1<l2)
+   * @param l2          - End pyramid level (l1<l2)
+   * @param A           - Jacobian of the pixel intensities w.r.t. to pixel coordinates
+   * @param b           - Intensity errors
+   * @return true, if successful.
+   * @todo catch if warping too distorted
+   */
+  bool getLinearAlignEquations(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& c, const int l1, const int l2,
+                               Eigen::MatrixXf& A, Eigen::MatrixXf& b){
+    PatchCoordinates pc;
+    if(!pc.set(c)){
+      A.resize(0,0);
+      b.resize(0,0);
+      return false;
+    }
+    return getLinearAlignEquations(pyr,mp,pc,l1,l2,A,b);
+  }
+
+  /** \brief Get the raw linear align equations for given pixel coordinates and warping (\see getLinearAlignEquations()).
+   */
+  bool getLinearAlignEquations(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PatchCoordinates& c, const int l1, const int l2,
+                               Eigen::MatrixXf& A, Eigen::MatrixXf& b){
+    if(policyFlags_ != getPolicyFlags()) refreshPolicy();
+    prepareJacobians(mp,c,l1,l2,false);
+    return (this->*policyFunctions_.linearEquations_)(pyr,mp,c,l1,l2,A,b);
+  }
+
+  /** \brief Specialization of getLinearAlignEquations() for a given set of \ref AlignmentPolicyFlags.
+   */
+  template<int Policy>
+  bool getLinearAlignEquations(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PatchCoordinates& c, const int l1, const int l2,
+                               Eigen::MatrixXf& A, Eigen::MatrixXf& b){
+    A.resize(0,0);
+    b.resize(0,0);
+    LinearEquationsAccumulator<Policy> acc(*this,A,b);
+    return computeAlignErrors<Policy>(pyr,mp,c,l1,l2,acc) > 0;
+  }
+
+  /** \brief Specialization of computeAlignErrors() with an \ref ErrorPatchAccumulator for a given set of \ref AlignmentPolicyFlags.
+   */
+  template<int Policy>
+  int computeAlignErrorPatches(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PatchCoordinates& c, const int l1, const int l2,
+                               ErrorPatchAccumulator& acc){
+    return computeAlignErrors<Policy>(pyr,mp,c,l1,l2,acc);
+  }
+
+  /** \brief Get the normal equations of the linear align equations (A^T*A*x=A^T*b), given by the [2x2] Matrix AtA (float)
+   *         and the [2x1] vector Atb (float). The normal equations are directly accumulated, without storing A and b.
+   *
+   *  \see Function getLinearAlignEquations() to get the raw linear align equations.
+   *
+   * @param pyr         - Considered image pyramid.
+   * @param mp          - \ref MultilevelPatch, which contains the patches.
+   * @param c           - Coordinates of the patch in the reference image.
+   * @param l1          - Start pyramid level (l1<l2)
+   * @param l2          - End pyramid level (l1<l2)
+   * @param AtA         - A^T*A
+   * @param Atb         - A^T*b
+   * @param ATop        - If not nullptr, the first two rows of A are stored here (required for reproducing the signs of a QR-decomposition).
+   * @return true, if successful.
+   */
+  bool getLinearAlignNormalEquations(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& c, const int l1, const int l2,
+                                     Eigen::Matrix2f& AtA, Eigen::Vector2f& Atb, Eigen::Matrix2f* ATop = nullptr){
+    PatchCoordinates pc;
+    return pc.set(c) && getLinearAlignNormalEquations(pyr,mp,pc,l1,l2,AtA,Atb,ATop);
+  }
+
+  /** \brief Get the normal equations for given pixel coordinates and warping (\see getLinearAlignNormalEquations()).
+   */
+  bool getLinearAlignNormalEquations(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PatchCoordinates& c, const int l1, const int l2,
+                                     Eigen::Matrix2f& AtA, Eigen::Vector2f& Atb, Eigen::Matrix2f* ATop = nullptr){
+    if(policyFlags_ != getPolicyFlags()) refreshPolicy();
+    prepareJacobians(mp,c,l1,l2,false);
+    return (this->*policyFunctions_.normalEquations_)(pyr,mp,c,l1,l2,AtA,Atb,ATop);
+  }
+
+  /** \brief Specialization of getLinearAlignNormalEquations() for a given set of \ref AlignmentPolicyFlags.
+   */
+  template<int Policy>
+  bool getLinearAlignNormalEquations(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PatchCoordinates& c, const int l1, const int l2,
+                                     Eigen::Matrix2f& AtA, Eigen::Vector2f& Atb, Eigen::Matrix2f* ATop){
+    NormalEquationsAccumulator<Policy> acc(*this,ATop);
+    if(computeAlignErrors<Policy>(pyr,mp,c,l1,l2,acc)==0){
+      return false;
+    }
+    AtA << acc.a00_, acc.a01_, acc.a01_, acc.a11_;
+    Atb << acc.b0_, acc.b1_;
+    return true;
+  }
+
+  /** \brief Rank test of the linear align equations, shared by the normal equations and the SVD solution in align2D(), such
+   *         that both accept the same systems. Given the eigenvalues e0 <= e1 of A^T*A (the squared singular values of A), the
+   *         system is rejected if det = e0*e1 <= eps*trace^2 = eps*(e0+e1)^2, i.e. if e0/e1 is below about the float epsilon.
+   *
+   * @param det         - Determinant of A^T*A.
+   * @param trace       - Trace of A^T*A.
+   * @return true, if the system has (numerically) full rank.
+   */
+  static bool isFullRank(const float det, const float trace){
+    return det > std::numeric_limits<float>::epsilon()*trace*trace;
+  }
+
+  /** \brief Solves the 2x2 normal equations in closed form.
+   *
+   * @param AtA         - A^T*A
+   * @param Atb         - A^T*b
+   * @param x           - Solution.
+   * @return false, if the system is (numerically) rank deficient (\see isFullRank()).
+   */
+  static bool solveNormalEquations(const Eigen::Matrix2f& AtA, const Eigen::Vector2f& Atb, Eigen::Vector2f& x){
+    const float det = AtA(0,0)*AtA(1,1)-AtA(0,1)*AtA(1,0);
+    const float trace = AtA(0,0)+AtA(1,1);
+    if(!isFullRank(det,trace)){
+      return false;
+    }
+    x(0) = (AtA(1,1)*Atb(0)-AtA(0,1)*Atb(1))/det;
+    x(1) = (AtA(0,0)*Atb(1)-AtA(1,0)*Atb(0))/det;
     return true;
   }
 
-  /** \brief Get the reduced (QR-decomposition) linear align equations (A*x=b), given by the [2x2] Matrix A (float)
-   *         and the [2x1] vector b (float).
+  /** \brief Reduces the 2x2 normal equations (A^T*A, A^T*b) to the equivalent upper triangular system (A_red, b_red), with
+   *         A_red^T*A_red = A^T*A and A_red^T*b_red = A^T*b.
+   *
+   *         The result corresponds to the column pivoting Householder QR-decomposition of A (A_red = R*P^T, b_red = first two
+   *         entries of Q^T*b), but is obtained from a 2x2 Cholesky decomposition of the normal equations. The signs of the
+   *         diagonal of R are recovered from the first two rows of A (Householder convention R(k,k) = -sign(c0)*|.|), such that
+   *         the innovation is also preserved if it is blended with the reprojection error.
+   *
+   * @param AtA         - A^T*A
+   * @param Atb         - A^T*b
+   * @param ATop        - First two rows of A.
+   * @param A_red       - Reduced Jacobian of the pixel intensities w.r.t. to pixel coordinates
+   * @param b_red       - Reduced intensity errors
+   */
+  template<typename Scalar>
+  static void reduceNormalEquations(const Eigen::Matrix<Scalar,2,2>& AtA, const Eigen::Matrix<Scalar,2,1>& Atb, const Eigen::Matrix<Scalar,2,2>& ATop,
+                                    Eigen::Matrix<Scalar,2,2>& A_red, Eigen::Matrix<Scalar,2,1>& b_red){
+    // Column pivoting (larger column norm first)
+    const int p0 = AtA(1,1) > AtA(0,0) ? 1 : 0;
+    const int p1 = 1-p0;
+
+    // Cholesky decomposition of the permuted normal equations, P^T*A^T*A*P = U^T*U
+    const Scalar u00 = std::sqrt(AtA(p0,p0));
+    const Scalar u01 = u00 > 0 ? AtA(p0,p1)/u00 : Scalar(0);
+    const Scalar u11 = std::sqrt(std::max(AtA(p1,p1)-u01*u01,Scalar(0)));
+
+    // Signs of the diagonal of R = D*U
+    const Scalar x0 = ATop(0,p0);
+    const Scalar x1 = ATop(1,p0);
+    const Scalar y0 = ATop(0,p1);
+    const Scalar y1 = ATop(1,p1);
+    Scalar d0 = x0 >= 0 ? -1 : 1;
+    Scalar c1 = y1; // Second entry of the non-pivot column after the first Householder reflection
+    if(AtA(p0,p0)-x0*x0 <= std::numeric_limits<Scalar>::min()){
+      d0 = -d0; // Trivial reflection
+    } else {
+      const Scalar beta = d0*u00;
+      const Scalar tau = (beta-x0)/beta;
+      const Scalar vTy = y0 + (AtA(p0,p1)-x0*y0)/(x0-beta);
+      c1 = y1 - tau*x1/(x0-beta)*vTy;
+    }
+    const Scalar d1 = c1 >= 0 ? -1 : 1;
+
+    // A_red = D*U*P^T, b_red = D*U^-T*P^T*A^T*b
+    A_red(0,p0) = d0*u00;
+    A_red(0,p1) = d0*u01;
+    A_red(1,p0) = 0;
+    A_red(1,p1) = d1*u11;
+    const Scalar z0 = u00 > 0 ? Atb(p0)/u00 : Scalar(0);
+    const Scalar z1 = u11 > 0 ? (Atb(p1)-u01*z0)/u11 : Scalar(0);
+    b_red(0) = d0*z0;
+    b_red(1) = d1*z1;
+  }
+
+  /** \brief Get the reduced linear align equations (A*x=b), given by the [2x2] upper triangular Matrix A (float)
+   *         and the [2x1] vector b (float). Equivalent to a QR-decomposition of the raw linear align equations, but computed
+   *         from the normal equations (\see reduceNormalEquations()).
    *
    *  \see MultilevelPatchFeature::A_ and MultilevelPatchFeature::b_.
    *  \see Function getLinearAlignEquations() to get the raw linear align equations.
@@ -311,19 +783,18 @@ class MultilevelPatchAlignment {
    */
   bool getLinearAlignEquationsReduced(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& c, const int l1, const int l2,
                                       Eigen::Matrix2f& A_red, Eigen::Vector2f& b_red){
-    bool success = getLinearAlignEquations(pyr,mp,c,l1,l2,A_,b_);
+    Eigen::Matrix2f AtA;
+    Eigen::Vector2f Atb;
+    Eigen::Matrix2f ATop;
+    bool success = getLinearAlignNormalEquations(pyr,mp,c,l1,l2,AtA,Atb,&ATop);
     if(success){
-      mColPivHouseholderQR_.compute(A_);
-      b_red = (mColPivHouseholderQR_.householderQ().inverse()*b_).template block<2,1>(0,0); // TODO: reduce
-      A_red = mColPivHouseholderQR_.matrixR().template block<2,2>(0,0);
-      A_red(1,0) = 0.0;
-      A_red = A_red*mColPivHouseholderQR_.colsPermutation();
+      reduceNormalEquations<float>(AtA,Atb,ATop,A_red,b_red);
     }
     return success;
   }
 
-  /** \brief Get the reduced (QR-decomposition) linear align equations (A*x=b), given by the [2x2] Matrix A (double)
-   *         and the [2x1] vector b (double).
+  /** \brief Get the reduced linear align equations (A*x=b), given by the [2x2] upper triangular Matrix A (double)
+   *         and the [2x1] vector b (double). The normal equations are accumulated in float, the reduction is carried out in double.
    *
    *         \see MultilevelPatchFeature::A_ and MultilevelPatchFeature::b_.
    *         \see Function getLinearAlignEquations() to get the raw linear align equations.
@@ -341,12 +812,12 @@ class MultilevelPatchAlignment {
    */
   bool getLinearAlignEquationsReduced(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& c, const int l1, const int l2,
                                       Eigen::Matrix2d& A_red, Eigen::Vector2d& b_red){
-    Eigen::Matrix2f A_red_;
-    Eigen::Vector2f b_red_;
-    bool success = getLinearAlignEquationsReduced(pyr,mp,c,l1,l2,A_red_,b_red_);
+    Eigen::Matrix2f AtA;
+    Eigen::Vector2f Atb;
+    Eigen::Matrix2f ATop;
+    bool success = getLinearAlignNormalEquations(pyr,mp,c,l1,l2,AtA,Atb,&ATop);
     if(success){
-      A_red = A_red_.cast<double>();
-      b_red = b_red_.cast<double>();
+      reduceNormalEquations<double>(AtA.cast<double>(),Atb.cast<double>(),ATop.cast<double>(),A_red,b_red);
     }
     return success;
   }
@@ -518,35 +989,61 @@ class MultilevelPatchAlignment {
    */
   bool align2D(FeatureCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& cInit,
                const int l1, const int l2, const int maxIter = 10, const double minPixUpd = 0.03){
-    // termination condition
-    const float min_update_squared = minPixUpd*minPixUpd;
-    cOut = cInit;
-    Eigen::Vector2f update;
-    update.setZero();
-    bool converged = false;
-    for(int iter = 0; iter<maxIter; ++iter){
-      if(isnan(cOut.get_c().x) || isnan(cOut.get_c().y)){
-        assert(false);
-        return false;
-      }
-      if(!getLinearAlignEquations(pyr,mp,cOut,l1,l2,A_,b_)){
-        return false;
-      }
-      svd_.compute(A_, Eigen::ComputeThinU | Eigen::ComputeThinV);
-      if(svd_.nonzeroSingularValues()<2){
-        return false;
-      }
-      update = svd_.solve(b_);
-      cOut.set_c(cv::Point2f(cOut.get_c().x + update[0],cOut.get_c().y + update[1]),false);
+    PatchCoordinates pc;
+    if(!setBoundary(cOut,cInit,pc)){
+      return false;
+    }
+    const bool converged = align2D(pc,pyr,mp,pc,l1,l2,maxIter,minPixUpd);
+    writeBack(cOut,pc);
+    return converged;
+  }
 
-      if(update[0]*update[0]+update[1]*update[1] < min_update_squared){
-        converged=true;
-        break;
-      }
+  /** \brief 2D patch alignment for given pixel coordinates and warping (\see align2D()).
+   */
+  bool align2D(PatchCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PatchCoordinates& cInit,
+               const int l1, const int l2, const int maxIter = 10, const double minPixUpd = 0.03){
+    prepareJacobians(mp,cInit,l1,l2,useInverseCompositional_);
+    return align2DPrepared(cOut,pyr,mp,cInit,l1,l2,maxIter,minPixUpd);
+  }
+
+  /** \brief Inverse compositional 2D patch alignment. No guarantee that final coordinates are fully in the frame.
+   *
+   *   The Jacobians [Jx Jy T 1] are taken from the reference patch only (pixel coordinates, intensity sqew and offset),
+   *   such that the Hessian and its inverse are constant. They are computed once per call (\ref jacobians_) and reused
+   *   across iterations. Each iteration only requires the extraction of the current patches and a single residual pass.
+   *   The Gaussian and the gradient based weighting are applied (the latter on the reference Jacobians), since they are
+   *   constant. The Huber norm depends on the current residuals, would require a new Hessian in every iteration, and is
+   *   therefore not supported (rejected by ImgUpdate::refreshProperties()).
+   *
+   * @param cOut        - Estimated coordinates for the patch alignment.
+   * @param pyr         - Considered image pyramid.
+   * @param mp          - \ref MultilevelPatch, which contains the patches.
+   * @param cInit       - Coordinates of the patch in the reference image, initial guess.
+   * @param l1          - Start pyramid level (l1<l2)
+   * @param l2          - End pyramid level (l1<l2)
+   * @param maxIter     - Maximal number of iterations
+   * @param minPixUpd   - Termination condition on absolute pixel update
+   * @return true, if alignment converged!
+   */
+  bool align2DInverseCompositional(FeatureCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& cInit,
+                                   const int l1, const int l2, const int maxIter = 10, const double minPixUpd = 0.03){
+    PatchCoordinates pc;
+    if(!setBoundary(cOut,cInit,pc)){
+      return false;
     }
+    const bool converged = align2DInverseCompositional(pc,pyr,mp,pc,l1,l2,maxIter,minPixUpd);
+    writeBack(cOut,pc);
     return converged;
   }
 
+  /** \brief Inverse compositional 2D patch alignment for given pixel coordinates and warping (\see align2DInverseCompositional()).
+   */
+  bool align2DInverseCompositional(PatchCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PatchCoordinates& cInit,
+                                   const int l1, const int l2, const int maxIter = 10, const double minPixUpd = 0.03){
+    prepareJacobians(mp,cInit,l1,l2,true);
+    return align2DInverseCompositionalPrepared(cOut,pyr,mp,cInit,l1,l2,maxIter,minPixUpd);
+  }
+
   /** \brief Execute a 2D patch alignment using only one single pyramid level (patch) of the MultilevelPatchFeature.
    *
    * @param cOut        - Estimated coordinates for the patch alignment.
@@ -573,13 +1070,20 @@ class MultilevelPatchAlignment {
    */
   bool align2DComposed(FeatureCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& cInit,
                        const int lowest_level,const int highest_level, const int start_level){
-    cOut = cInit;
-    for(int l = start_level;l>=highest_level;--l){
-      if(!align2D(cOut,pyr,mp,cOut,l,lowest_level)){
-        return false;
-      }
+    PatchCoordinates pc;
+    if(!setBoundary(cOut,cInit,pc)){
+      return false;
     }
-    return true;
+    prepareJacobians(mp,pc,highest_level,lowest_level,useInverseCompositional_);
+    int iterationCount = 0;
+    bool success = true;
+    for(int l = start_level;l>=highest_level && success;--l){
+      success = align2DPrepared(pc,pyr,mp,pc,l,lowest_level);
+      iterationCount += iterationCount_;
+    }
+    iterationCount_ = iterationCount;
+    writeBack(cOut,pc);
+    return success;
   }
 
   /** \brief Aligns a MultilevelPatchFeature to a given image pyramid, adapts the algorithm to the uncertainty of cInit
@@ -598,31 +1102,272 @@ class MultilevelPatchAlignment {
   bool align2DAdaptive(FeatureCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const FeatureCoordinates& cInit,
                        const int lowest_level = nLevels,const int highest_level = 0, const double convergencePixelRange = 1.0,  const double coverageRatio = 2.0, const int maxUniSample = 5){
     bestIntensityError_ = -1;
-    cOut = cInit;
+    PatchCoordinates pc;
+    if(!setBoundary(cOut,cInit,pc)){
+      return false;
+    }
     const int n = std::min(std::max(static_cast<int>(ceil((cInit.sigma1_*coverageRatio)/(convergencePixelRange*pow(2.0,lowest_level+1))-0.5)),0),maxUniSample); // (n+0.5)*r*2^(l+1) > s*f
     if(n==0){ // Catch simple case
-      return align2D(cOut,pyr,mp,cInit,highest_level,lowest_level);
+      const bool converged = align2D(pc,pyr,mp,pc,highest_level,lowest_level);
+      writeBack(cOut,pc);
+      return converged;
+    }
+    const Eigen::Vector2f seedDirection = cInit.eigenVector1_.cast<float>();
+    prepareJacobians(mp,pc,highest_level,lowest_level,useInverseCompositional_);
+    if(seedWorkerPool_){
+      if(!align2DAdaptiveParallel(pyr,mp,pc,seedDirection,lowest_level,highest_level,convergencePixelRange,n)){
+        return false;
+      }
+      writeBack(cOut,bestCoordinateMatch_);
+      return true;
     }
+    int iterationCount = 0;
+    PatchCoordinates cSeed;
     for(int i = -n;i<=n;i++){ // i is the multiple of steps which should be taken along the directions
-      cOut.set_c(cInit.get_c() + vecToPoint2f(cInit.eigenVector1_.cast<float>()*i*convergencePixelRange*pow(2.0,lowest_level+1)),false);
-      if(align2D(cOut,pyr,mp,cOut,highest_level,lowest_level)){
-        if(mlpTemp_.isMultilevelPatchInFrame(pyr,cOut,lowest_level,false)){
-          mlpTemp_.extractMultilevelPatchFromImage(pyr,cOut,lowest_level,false);
+      cSeed = pc;
+      cSeed.set_c(pc.get_c() + vecToPoint2f(seedDirection*i*convergencePixelRange*pow(2.0,lowest_level+1)));
+      const bool success = align2DPrepared(cSeed,pyr,mp,cSeed,highest_level,lowest_level);
+      iterationCount += iterationCount_;
+      if(success){
+        if(mlpTemp_.isMultilevelPatchInFrame(pyr,cSeed,lowest_level,false)){
+          mlpTemp_.extractMultilevelPatchFromImage(pyr,cSeed,lowest_level,false);
           const float avgError = mlpTemp_.computeAverageDifference(mp,highest_level,lowest_level);
           if(bestIntensityError_ == -1 || avgError<bestIntensityError_){
-            bestCoordinateMatch_ = cOut;
+            bestCoordinateMatch_ = cSeed;
             bestIntensityError_ = avgError;
           }
         }
       }
     }
+    iterationCount_ = iterationCount;
     if(bestIntensityError_ == -1){
       return false;
     } else {
-      cOut = bestCoordinateMatch_;
+      writeBack(cOut,bestCoordinateMatch_);
       return true;
     }
   }
+  /** \brief Parallel seed evaluation of align2DAdaptive(), using \ref seedWorkerPool_.
+   *
+   *  Every worker aligns with its own scratch alignment from \ref seedAlignments_. The seeds are handed out from the center
+   *  outwards (0,-1,1,-2,2,...). Once a seed reaches an average intensity error below \ref seedCancelIntensityError_, all seeds
+   *  of lower priority which have not been started yet are skipped. The seeds of higher priority are always evaluated and the
+   *  best match among them is selected in the sequential order, such that the result does not depend on the scheduling.
+   *
+   *  The best match is stored in \ref bestCoordinateMatch_.
+   *
+   * @param pyr           - Considered image pyramid.
+   * @param mp            - \ref MultilevelPatch, which contains the patches.
+   * @param cInit         - Coordinates of the patch in the reference image, initial guess.
+   * @param seedDirection - Direction along which the seeds are placed (major axis of the pixel uncertainty).
+   * @param lowest_level  - Lowest pyramid level
+   * @param highest_level - Highest pyramid level
+   * @param convergencePixelRange - Range of convergence
+   * @param n             - Number of seeds on one side
+   * @return true, if alignment converged!
+   */
+  bool align2DAdaptiveParallel(const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PatchCoordinates& cInit,
+                               const Eigen::Vector2f& seedDirection, const int lowest_level, const int highest_level, const double convergencePixelRange, const int n){
+    const int nSeeds = 2*n+1;
+
+    // The Jacobians of mp have been prepared in align2DAdaptive(). The workers align with a copy of them and only read from mp.
+    for(auto& a : seedAlignments_){
+      a->copyOptions(*this);
+      a->jacobians_ = jacobians_;
+      memcpy(a->patchExtent_,patchExtent_,sizeof(patchExtent_));
+    }
+
+    seedResults_.resize(nSeeds);
+    std::atomic<int> cancelFrom(nSeeds);
+    seedWorkerPool_->parallelFor(nSeeds,[&](const int k, const int workerId){
+      SeedResult& r = seedResults_[k];
+      r.valid_ = false;
+      r.iterationCount_ = 0;
+      if(k > cancelFrom.load()){
+        return;
+      }
+      MultilevelPatchAlignment& a = *seedAlignments_[workerId];
+      const int i = k%2 == 0 ? k/2 : -(k+1)/2; // Multiple of steps which should be taken along the directions
+      r.c_ = cInit;
+      r.c_.set_c(cInit.get_c() + vecToPoint2f(seedDirection*i*convergencePixelRange*pow(2.0,lowest_level+1)));
+      if(a.align2DPrepared(r.c_,pyr,mp,r.c_,highest_level,lowest_level)){
+        if(a.mlpTemp_.isMultilevelPatchInFrame(pyr,r.c_,lowest_level,false)){
+          a.mlpTemp_.extractMultilevelPatchFromImage(pyr,r.c_,lowest_level,false);
+          r.avgError_ = a.mlpTemp_.computeAverageDifference(mp,highest_level,lowest_level);
+          r.valid_ = true;
+          if(seedCancelIntensityError_ > 0 && r.avgError_ < seedCancelIntensityError_){
+            int current = cancelFrom.load();
+            while(k < current && !cancelFrom.compare_exchange_weak(current,k)){}
+          }
+        }
+      }
+      r.iterationCount_ = a.iterationCount_;
+    });
+
+    // Select the best seed in the sequential order, among the seeds which are always evaluated
+    const int lastSeed = cancelFrom.load();
+    int iterationCount = 0;
+    for(int i = -n;i<=n;i++){
+      const int k = i >= 0 ? 2*i : -2*i-1;
+      if(k > lastSeed){
+        continue;
+      }
+      const SeedResult& r = seedResults_[k];
+      iterationCount += r.iterationCount_;
+      if(r.valid_ && (bestIntensityError_ == -1 || r.avgError_<bestIntensityError_)){
+        bestCoordinateMatch_ = r.c_;
+        bestIntensityError_ = r.avgError_;
+      }
+    }
+    iterationCount_ = iterationCount;
+    return bestIntensityError_ != -1;
+  }
+
+ private:
+  /** \brief 2D patch alignment (\see align2D()), with the Jacobians of mp already prepared for the levels [l1,l2]
+   *         (\see prepareJacobians()).
+   */
+  bool align2DPrepared(PatchCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PatchCoordinates& cInit,
+                       const int l1, const int l2, const int maxIter = 10, const double minPixUpd = 0.03){
+    if(useInverseCompositional_){
+      return align2DInverseCompositionalPrepared(cOut,pyr,mp,cInit,l1,l2,maxIter,minPixUpd);
+    }
+    if(policyFlags_ != getPolicyFlags()) refreshPolicy();
+    // termination condition
+    const float min_update_squared = minPixUpd*minPixUpd;
+    cOut = cInit;
+    Eigen::Vector2f update;
+    update.setZero();
+    bool converged = false;
+    iterationCount_ = 0;
+    for(int iter = 0; iter<maxIter; ++iter){
+      iterationCount_++;
+      if(isnan(cOut.get_c().x) || isnan(cOut.get_c().y)){
+        assert(false);
+        return false;
+      }
+      if(useNormalEquations_){
+        Eigen::Matrix2f AtA;
+        Eigen::Vector2f Atb;
+        if(!(this->*policyFunctions_.normalEquations_)(pyr,mp,cOut,l1,l2,AtA,Atb,nullptr)){
+          return false;
+        }
+        if(!solveNormalEquations(AtA,Atb,update)){
+          return false;
+        }
+      } else {
+        if(!(this->*policyFunctions_.linearEquations_)(pyr,mp,cOut,l1,l2,A_,b_)){
+          return false;
+        }
+        svd_.compute(A_, Eigen::ComputeThinU | Eigen::ComputeThinV);
+        const float e0 = svd_.singularValues()(1)*svd_.singularValues()(1);
+        const float e1 = svd_.singularValues()(0)*svd_.singularValues()(0);
+        if(!isFullRank(e0*e1,e0+e1)){
+          return false;
+        }
+        update = svd_.solve(b_);
+      }
+      cOut.set_c(cv::Point2f(cOut.get_c().x + update[0],cOut.get_c().y + update[1]));
+
+      if(update[0]*update[0]+update[1]*update[1] < min_update_squared){
+        converged=true;
+        break;
+      }
+    }
+    return converged;
+  }
+
+  /** \brief Inverse compositional 2D patch alignment (\see align2DInverseCompositional()), with the Jacobians and the
+   *         inverse compositional Hessians of mp already prepared for the levels [l1,l2] (\see prepareJacobians()).
+   */
+  bool align2DInverseCompositionalPrepared(PatchCoordinates& cOut, const ImagePyramid<nLevels>& pyr, const MultilevelPatch<nLevels,patch_size>& mp, const PatchCoordinates& cInit,
+                                           const int l1, const int l2, const int maxIter = 10, const double minPixUpd = 0.03){
+    const Eigen::Matrix2f warp = cInit.get_warp_c();
+    const float min_update_squared = minPixUpd*minPixUpd;
+    cOut = cInit;
+    PatchCoordinates c_level;
+    Eigen::Vector4f g;
+    Eigen::Vector4f update;
+    Eigen::Vector2f pixUpdate;
+    float sqew = 1.0;
+    float offset = 0.0;
+    bool converged = false;
+    iterationCount_ = 0;
+    for(int iter = 0; iter<maxIter; ++iter){
+      iterationCount_++;
+      if(isnan(cOut.get_c().x) || isnan(cOut.get_c().y)){
+        assert(false);
+        return false;
+      }
+      float g0 = 0, g1 = 0, g2 = 0, g3 = 0;
+      int levelMask = 0;
+      for(int l = l1; l <= l2; l++){
+        pyr.levelTranformCoordinates(cOut,c_level,0,l);
+        if(mp.isValidPatch_[l] && Patch<patch_size>::isPatchInFrame(pyr.imgs_[l],c_level.get_c(),patchExtent_[0][0],patchExtent_[0][1])){
+          levelMask |= 1<<l;
+          extractedPatches_[l].extractPatchFromImage(pyr.imgs_[l],c_level,false);
+          const float* it_patch_extracted = extractedPatches_[l].patch_;
+          const float* it_patch = mp.patches_[l].patch_;
+          const float* it_Jx = jacobians_.getJx(l,false);
+          const float* it_Jy = jacobians_.getJy(l,false);
+          const float* it_W = jacobians_.WIC_[l];
+          for(int i=0; i<patch_size*patch_size; ++i, ++it_patch_extracted, ++it_patch, ++it_Jx, ++it_Jy, ++it_W){
+            const float e = (*it_W)*(*it_patch_extracted - sqew*(*it_patch) - offset);
+            g0 += (*it_Jx)*e;
+            g1 += (*it_Jy)*e;
+            g2 += (*it_patch)*e;
+            g3 += e;
+          }
+        }
+      }
+      if(levelMask == 0){
+        return false;
+      }
+      if(!jacobians_.computeInverseCompositionalHessianInverse(levelMask,useIntensitySqew_,useIntensityOffset_)){
+        return false;
+      }
+      g << g0, g1, g2, g3;
+      update = jacobians_.HICInv_.map()*g;
+      pixUpdate = warp*update.template head<2>();
+      cOut.set_c(cv::Point2f(cOut.get_c().x + pixUpdate[0],cOut.get_c().y + pixUpdate[1]));
+      sqew += update[2];
+      offset += update[3];
+
+      if(pixUpdate[0]*pixUpdate[0]+pixUpdate[1]*pixUpdate[1] < min_update_squared){
+        converged=true;
+        break;
+      }
+    }
+    return converged;
+  }
+
+  /** \brief Converts the initial guess of a public alignment function to \ref PatchCoordinates and initializes the output
+   *         coordinates with it (camera, bearing vector and uncertainty are only copied here, once per call).
+   *
+   * @param cOut        - Output coordinates.
+   * @param cInit       - Initial guess (may alias cOut).
+   * @param pc          - Converted initial guess.
+   * @return false, if the pixel coordinates or the warping of cInit cannot be computed.
+   */
+  static bool setBoundary(FeatureCoordinates& cOut, const FeatureCoordinates& cInit, PatchCoordinates& pc){
+    const bool valid = pc.set(cInit);
+    if(&cOut != &cInit){
+      cOut = cInit;
+    }
+    return valid;
+  }
+
+  /** \brief Writes the aligned pixel coordinates back to the output coordinates, keeping their warping.
+   *
+   * @param cOut        - Output coordinates (initialized by setBoundary()).
+   * @param pc          - Aligned coordinates.
+   */
+  static void writeBack(FeatureCoordinates& cOut, const PatchCoordinates& pc){
+    const cv::Point2f c = pc.get_c();
+    if(c != cOut.get_c()){
+      cOut.set_c(c,false);
+    }
+  }
 };
 
 }
@@ -0,0 +1,200 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_MULTILEVELPATCHJACOBIANS_HPP_
+#define ROVIO_MULTILEVELPATCHJACOBIANS_HPP_
+
+#include "lightweight_filtering/common.hpp"
+#include "rovio/MultilevelPatch.hpp"
+#include "rovio/PodMatrix.hpp"
+
+namespace rovio{
+
+/** \brief Level-scaled alignment Jacobians of a \ref MultilevelPatch, and the Hessians of the inverse compositional alignment.
+ *
+ *   Kept apart from the MultilevelPatch, which is copied with every feature. The alignment fills it once per alignment call
+ *   (\see MultilevelPatchAlignment::prepareJacobians()) and reuses it for all iterations, seeds and levels of that call.
+ *   Reading is const and asserts that the level has been computed.
+ *
+ *   @tparam nLevels   - Number of pyramid levels.
+ *   @tparam patchSize - Edge length of the patches in pixels.
+ */
+template<int nLevels,int patchSize>
+class MultilevelPatchJacobians{
+ public:
+  float Jx_[nLevels][patchSize*patchSize] __attribute__ ((aligned (16)));  /**<Level-scaled intensity gradients in x-direction (-0.5^l*dx).*/
+  float Jy_[nLevels][patchSize*patchSize] __attribute__ ((aligned (16)));  /**<Level-scaled intensity gradients in y-direction (-0.5^l*dy).*/
+  float JxWarped_[nLevels][patchSize*patchSize] __attribute__ ((aligned (16)));  /**<Jacobians in x-direction, premultiplied with the inverse warping.*/
+  float JyWarped_[nLevels][patchSize*patchSize] __attribute__ ((aligned (16)));  /**<Jacobians in y-direction, premultiplied with the inverse warping.*/
+  bool validJacobians_[nLevels];  /**<True, if \ref Jx_ and \ref Jy_ have been computed for the level.*/
+  bool validWarpedJacobians_[nLevels];  /**<True, if \ref JxWarped_ and \ref JyWarped_ have been computed for the level.*/
+  float WIC_[nLevels][patchSize*patchSize] __attribute__ ((aligned (16)));  /**<Squared residual weights of the inverse compositional alignment (Gaussian and gradient based weighting).*/
+  PodMatrix<4,4> HIC_[nLevels];  /**<Per-level Hessian for the inverse compositional alignment. Parameters: pixel coordinates (patch frame), intensity sqew, intensity offset.*/
+  bool validHIC_[nLevels];  /**<True, if \ref HIC_ has been computed for the level.*/
+  PodMatrix<4,4> HICInv_;  /**<Inverse of the combined inverse compositional Hessian for the configuration \ref HICInvKey_ (zero rows/columns for unused parameters).*/
+  int HICInvKey_;  /**<Configuration (used levels and intensity parameters) for which \ref HICInv_ has been computed, -1 if invalid.*/
+  bool validHICInv_;  /**<True, if the Hessian for \ref HICInvKey_ was invertible.*/
+
+  /** \brief Constructor
+   */
+  MultilevelPatchJacobians(){
+    invalidate();
+  }
+
+  /** \brief Marks all levels as not computed.
+   */
+  void invalidate(){
+    for(int l=0;l<nLevels;l++){
+      validJacobians_[l] = false;
+      validWarpedJacobians_[l] = false;
+      validHIC_[l] = false;
+    }
+    HICInvKey_ = -1;
+  }
+
+  /** \brief Computes the Jacobians of the valid levels in [l1,l2] of a multilevel patch (previous results are discarded).
+   *         The gradient parameters of the patches must have been computed when the patches were extracted
+   *         (\see MultilevelPatch::extractMultilevelPatchFromImage()), the multilevel patch is only read.
+   *
+   * @param mp      - \ref MultilevelPatch.
+   * @param l1      - Start pyramid level (l1<l2)
+   * @param l2      - End pyramid level (l1<l2)
+   * @param affInv  - Inverse warping for the warped Jacobians. If nullptr, the warped Jacobians are not computed.
+   * @param withHIC - Additionally compute the per-level Hessians of the inverse compositional alignment.
+   * @param w       - Gaussian weights of all levels ([nLevels*patchSize*patchSize], nullptr if not weighted), for the Hessians.
+   * @param gradientExponent - Exponent of the gradient based weighting (disabled if <= 0), for the Hessians.
+   */
+  void compute(const MultilevelPatch<nLevels,patchSize>& mp, const int l1, const int l2, const Eigen::Matrix2f* affInv, const bool withHIC,
+               const float* w = nullptr, const float gradientExponent = 0.0){
+    invalidate();
+    for(int l = l1; l <= l2; l++){
+      if(!mp.isValidPatch_[l]){
+        continue;
+      }
+      const Patch<patchSize>& p = mp.patches_[l];
+      assert(p.validGradientParameters_);
+      const float scale = -pow(0.5,l);
+      for(int i=0; i<patchSize*patchSize; ++i){
+        Jx_[l][i] = scale*p.dx_[i];
+        Jy_[l][i] = scale*p.dy_[i];
+      }
+      validJacobians_[l] = true;
+      if(affInv != nullptr){
+        const float a00 = (*affInv)(0,0), a01 = (*affInv)(0,1), a10 = (*affInv)(1,0), a11 = (*affInv)(1,1);
+        for(int i=0; i<patchSize*patchSize; ++i){
+          JxWarped_[l][i] = Jx_[l][i]*a00+Jy_[l][i]*a10;
+          JyWarped_[l][i] = Jx_[l][i]*a01+Jy_[l][i]*a11;
+        }
+        validWarpedJacobians_[l] = true;
+      }
+      if(withHIC){
+        Eigen::Vector4f J;
+        Eigen::Matrix4f H;
+        H.setZero();
+        for(int i=0; i<patchSize*patchSize; ++i){
+          float weight = w != nullptr ? w[l*patchSize*patchSize+i] : 1.0f;
+          if(gradientExponent > 0.0){ // Same weighting as the forward alignment, but on the (constant) reference Jacobians
+            weight *= 1.0-std::pow((Jx_[l][i]*Jx_[l][i]+Jy_[l][i]*Jy_[l][i])/(2*128*128),0.5*gradientExponent);
+          }
+          WIC_[l][i] = weight*weight;
+          J << Jx_[l][i], Jy_[l][i], p.patch_[i], 1.0f;
+          H += WIC_[l][i]*J*J.transpose();
+        }
+        HIC_[l].map() = H;
+        validHIC_[l] = true;
+      }
+    }
+  }
+
+  /** \brief Returns the Jacobians in x-direction of a level.
+   *
+   * @param l      - Pyramid level.
+   * @param warped - Return the Jacobians premultiplied with the inverse warping.
+   */
+  const float* getJx(const int l, const bool warped) const{
+    assert(warped ? validWarpedJacobians_[l] : validJacobians_[l]);
+    return warped ? JxWarped_[l] : Jx_[l];
+  }
+
+  /** \brief Returns the Jacobians in y-direction of a level (\see getJx()).
+   */
+  const float* getJy(const int l, const bool warped) const{
+    assert(warped ? validWarpedJacobians_[l] : validJacobians_[l]);
+    return warped ? JyWarped_[l] : Jy_[l];
+  }
+
+  /** \brief Computes the inverse of the combined inverse compositional Hessian (\ref HICInv_) for a set of levels and
+   *         intensity parameters. The result is cached and only recomputed if the configuration changes.
+   *
+   * @param levelMask          - Bitmask of the considered pyramid levels (\ref HIC_ must have been computed for them).
+   * @param useIntensitySqew   - Should the intensity sqew be estimated.
+   * @param useIntensityOffset - Should the intensity offset be estimated.
+   * @return true, if the Hessian is invertible.
+   */
+  bool computeInverseCompositionalHessianInverse(const int levelMask, const bool useIntensitySqew, const bool useIntensityOffset){
+    const int key = levelMask | ((int)useIntensitySqew << nLevels) | ((int)useIntensityOffset << (nLevels+1));
+    if(key != HICInvKey_){
+      Eigen::Matrix4f H;
+      H.setZero();
+      for(int l=0;l<nLevels;l++){
+        if(levelMask & (1<<l)){
+          assert(validHIC_[l]);
+          H += HIC_[l].map();
+        }
+      }
+      int ind[4] = {0,1,2,3};
+      int n = 2;
+      if(useIntensitySqew) ind[n++] = 2;
+      if(useIntensityOffset) ind[n++] = 3;
+      Eigen::MatrixXf Hsub(n,n);
+      for(int i=0;i<n;i++){
+        for(int j=0;j<n;j++){
+          Hsub(i,j) = H(ind[i],ind[j]);
+        }
+      }
+      Eigen::FullPivLU<Eigen::MatrixXf> lu(Hsub);
+      validHICInv_ = lu.isInvertible();
+      HICInv_.map().setZero();
+      if(validHICInv_){
+        const Eigen::MatrixXf HsubInv = lu.inverse();
+        for(int i=0;i<n;i++){
+          for(int j=0;j<n;j++){
+            HICInv_(ind[i],ind[j]) = HsubInv(i,j);
+          }
+        }
+      }
+      HICInvKey_ = key;
+    }
+    return validHICInv_;
+  }
+};
+
+}
+
+
+#endif /* ROVIO_MULTILEVELPATCHJACOBIANS_HPP_ */
@@ -29,12 +29,19 @@
 #ifndef ROVIO_PATCH_HPP_
 #define ROVIO_PATCH_HPP_
 
+#include <type_traits>
+
 #include "lightweight_filtering/common.hpp"
 #include "rovio/FeatureCoordinates.hpp"
+#include "rovio/PatchCoordinates.hpp"
+#include "rovio/PatchInterpolation.hpp"
+#include "rovio/PodMatrix.hpp"
 
 namespace rovio{
 
 /** \brief %Patch with selectable patchSize.
+ *
+ *   Trivially copyable, standard-layout value type (no virtual functions, no Eigen members), such that copies reduce to memcpy.
  *
  *   @tparam patchSize - Edge length of the patch in pixels. Value must be a multiple of 2!
  */
@@ -46,57 +53,33 @@ class Patch {
                                                                                  This expanded patch is necessary for the intensity gradient calculation.*/
   mutable float dx_[patchSize*patchSize] __attribute__ ((aligned (16)));  /**<Array, containing the intensity gradient component in x-direction for each patch pixel.*/
   mutable float dy_[patchSize*patchSize] __attribute__ ((aligned (16)));  /**<Array, containing the intensity gradient component in y-direction for each patch pixel.*/
-  mutable Eigen::Matrix3f H_;  /**<Hessian matrix of the patch (necessary for the patch alignment).*/
+  mutable PodMatrix<3,3> H_;  /**<Hessian matrix of the patch (necessary for the patch alignment).*/
   mutable float s_;  /**<Shi-Tomasi Score (smaller eigenvalue of H_).*/
   mutable float e0_;  /**<Smaller eigenvalue of H_.*/
   mutable float e1_;  /**<Larger eigenvalue of H_.*/
   mutable bool validGradientParameters_;  /**<True, if the gradient parameters (patch gradient components dx_ dy_, Hessian H_, Shi-Thomasi Score s_) have been computed.
                                   \see computeGradientParameters()*/
+  bool validPatchWithBorder_;  /**<True, if patchWithBorder_ contains the expanded patch of the current patch (not the case after extractPatchAndGradientsFromImage()).*/
   /** \brief Constructor
    */
   Patch(){
     static_assert(patchSize%2==0,"Patch patchSize must be a multiple of 2");
+    static_assert(std::is_trivially_copyable<Patch>::value,"Patch must stay trivially copyable (copied with memcpy)");
     validGradientParameters_ = false;
+    validPatchWithBorder_ = false;
     s_ = 0.0;
     e0_ = 0.0;
     e1_ = 0.0;
   }
-  /** \brief Destructor
-   */
-  virtual ~Patch(){}
-
   /** \brief Computes the gradient parameters of the patch (patch gradient components dx_ dy_, Hessian H_, Shi-Tomasi Score s_, Eigenvalues of the Hessian e0_ and e1_).
    *         The expanded patch patchWithBorder_ must be set.
    *         Sets validGradientParameters_ afterwards to true.
    */
   void computeGradientParameters() const{
     if(!validGradientParameters_){
-      H_.setZero();
-      const int refStep = patchSize+2;
-      float* it_dx = dx_;
-      float* it_dy = dy_;
-      const float* it;
-      Eigen::Vector3f J;
-      J.setZero();
-      for(int y=0; y<patchSize; ++y){
-        it = patchWithBorder_ + (y+1)*refStep + 1;
-        for(int x=0; x<patchSize; ++x, ++it, ++it_dx, ++it_dy){
-          J[0] = 0.5 * (it[1] - it[-1]);
-          J[1] = 0.5 * (it[refStep] - it[-refStep]);
-          J[2] = 1;
-          *it_dx = J[0];
-          *it_dy = J[1];
-          H_ += J*J.transpose();
-        }
-      }
-      const float dXX = H_(0,0)/(patchSize*patchSize);
-      const float dYY = H_(1,1)/(patchSize*patchSize);
-      const float dXY = H_(0,1)/(patchSize*patchSize);
-
-      e0_ = 0.5 * (dXX + dYY - sqrtf((dXX + dYY) * (dXX + dYY) - 4 * (dXX * dYY - dXY * dXY)));
-      e1_ = 0.5 * (dXX + dYY + sqrtf((dXX + dYY) * (dXX + dYY) - 4 * (dXX * dYY - dXY * dXY)));
-      s_ = e0_+e1_;
-      validGradientParameters_ = true;
+      assert(validPatchWithBorder_);
+      sweepPatchWithBorder(patchWithBorder_,nullptr,dx_,dy_,H_);
+      computeScoreFromHessian();
     }
   }
 
@@ -104,6 +87,7 @@ class Patch {
    *         expanded patch (patchWithBorder_).
    */
   void extractPatchFromPatchWithBorder(){
+    assert(validPatchWithBorder_);
     float* it_patch = patch_;
     float* it_patchWithBorder;
     for(int y=1; y<patchSize+1; ++y, it_patch += patchSize){
@@ -113,6 +97,16 @@ class Patch {
     }
   }
 
+  /** \brief Fused version of extractPatchFromPatchWithBorder() and computeGradientParameters(). Extracts patch_, the
+   *         gradient components dx_ dy_ and the Hessian H_ in a single sweep over the expanded patch (patchWithBorder_).
+   *         Sets validGradientParameters_ afterwards to true.
+   */
+  void extractPatchAndGradientParametersFromPatchWithBorder(){
+    assert(validPatchWithBorder_);
+    sweepPatchWithBorder(patchWithBorder_,patch_,dx_,dy_,H_);
+    computeScoreFromHessian();
+  }
+
   /** \brief Returns the Shi-Tomasi Score s_.
    *
    *   Computes and sets the gradient parameters, which are the patch gradient components dx_ dy_, the Hessian H_ and the Shi-Tomasi Score s_.
@@ -131,99 +125,67 @@ class Patch {
    */
   Eigen::Matrix3f getHessian() const{
     computeGradientParameters();
-    return H_;
+    return H_.map();
   }
 
-  /** \brief Draws the patch into an image.
+  /** \brief Checks if a patch at a specific image location is still within the reference image.
    *
-   *   @param drawImg    - Image in which the patch should be drawn.
-   *   @param c          - Pixel coordinates of the left upper patch corner.
-   *   @param stretch    - %Patch drawing magnification factor.
-   *   @param withBorder - Draw either the patch patch_ (withBorder = false) or the expanded patch
-   *                       patchWithBorder_ (withBorder = true).
+   *   The extent of a warped patch is the bounding box of its four corners, which is given by the absolute row sums of the
+   *   warping. The test thus reduces to a single comparison of the center against the shrunken image bounds.
+   *
+   *   @param img        - Reference Image.
+   *   @param c          - Coordinates of the patch in the reference image.
+   *   @param withBorder - Check, using either the patch-patchSize of Patch::patch_ (withBorder = false) or the patch-patchSize
+   *                       of the expanded patch Patch::patchWithBorder_ (withBorder = true).
+   *   @return true, if the patch is completely located within the reference image.
    */
-  void drawPatch(cv::Mat& drawImg,const cv::Point2i& c,int stretch = 1,const bool withBorder = false) const{
-    const int refStepY = drawImg.step.p[0];
-    const int refStepX = drawImg.step.p[1];
-    uint8_t* img_ptr;
-    const float* it_patch;
-    if(withBorder){
-      it_patch = patchWithBorder_;
-    } else {
-      it_patch = patch_;
-    }
-    for(int y=0; y<patchSize+2*(int)withBorder; ++y, it_patch += patchSize+2*(int)withBorder){
-      img_ptr = (uint8_t*) drawImg.data + (c.y+y*stretch)*refStepY + c.x*refStepX;
-      for(int x=0; x<patchSize+2*(int)withBorder; ++x)
-        for(int i=0;i<stretch;++i){
-          for(int j=0;j<stretch;++j){
-            img_ptr[x*stretch*refStepX+i*refStepY+j*refStepX+0] = (uint8_t)(it_patch[x]);
-            if(drawImg.channels() == 3){
-              img_ptr[x*stretch*refStepX+i*refStepY+j*refStepX+1] = (uint8_t)(it_patch[x]);
-              img_ptr[x*stretch*refStepX+i*refStepY+j*refStepX+2] = (uint8_t)(it_patch[x]);
-            }
-          }
-        }
-    }
+  static bool isPatchInFrame(const cv::Mat& img,const FeatureCoordinates& c,const bool withBorder = false){
+    PatchCoordinates pc;
+    return c.isInFront() && pc.set(c) && isPatchInFrame(img,pc,withBorder);
   }
 
-  /** \brief Draws the patch borders into an image.
+  /** \brief Checks if a patch at a specific image location is still within the reference image.
    *
-   * @param drawImg     - Image in which the patch borders should be drawn.
-   * @param c           - Coordinates of the patch in the reference image.
-   * @param s           - Scaling factor.
-   * @param color       - Line color.
+   *   @param img        - Reference Image.
+   *   @param c          - Pixel coordinates and warping of the patch in the reference image.
+   *   @param withBorder - Check the patch (withBorder = false) or the expanded patch (withBorder = true).
+   *   @return true, if the patch is completely located within the reference image.
    */
-  void drawPatchBorder(cv::Mat& drawImg,const FeatureCoordinates& c,const float s, const cv::Scalar& color) const{
-    const double half_length = s*patchSize/2;
-    if(c.isInFront() && c.com_warp_c()){
-      cv::Point2f c1 = c.get_patchCorner(half_length,half_length).get_c();
-      cv::Point2f c2 = c.get_patchCorner(half_length,-half_length).get_c();
-      cv::line(drawImg,c1,c2,color,1);
-      c1 = c.get_patchCorner(-half_length,-half_length).get_c();
-      cv::line(drawImg,c2,c1,color,1);
-      c2 = c.get_patchCorner(-half_length,half_length).get_c();
-      cv::line(drawImg,c1,c2,color,1);
-      c1 = c.get_patchCorner(half_length,half_length).get_c();
-      cv::line(drawImg,c2,c1,color,1);
-    }
+  static bool isPatchInFrame(const cv::Mat& img,const PatchCoordinates& c,const bool withBorder = false){
+    float extentX, extentY;
+    getPatchExtent(c,withBorder,extentX,extentY);
+    return isPatchInFrame(img,c.get_c(),extentX,extentY);
   }
 
-  /** \brief Checks if a patch at a specific image location is still within the reference image.
+  /** \brief Checks if a patch with a given extent is within the reference image (see getPatchExtent()).
    *
-   *   @param img        - Reference Image.
-   *   @param c          - Coordinates of the patch in the reference image.
-   *   @param withBorder - Check, using either the patch-patchSize of Patch::patch_ (withBorder = false) or the patch-patchSize
-   *                       of the expanded patch Patch::patchWithBorder_ (withBorder = true).
+   *   @param img     - Reference Image.
+   *   @param c       - Pixel coordinates of the patch center.
+   *   @param extentX - Half extent of the patch in x-direction.
+   *   @param extentY - Half extent of the patch in y-direction.
    *   @return true, if the patch is completely located within the reference image.
    */
-  static bool isPatchInFrame(const cv::Mat& img,const FeatureCoordinates& c,const bool withBorder = false){
-    if(c.isInFront() && c.com_warp_c()){
-      const int halfpatch_size = patchSize/2+(int)withBorder;
-      if(c.isNearIdentityWarping()){
-        if(c.get_c().x < halfpatch_size || c.get_c().y < halfpatch_size || c.get_c().x > img.cols-halfpatch_size || c.get_c().y > img.rows-halfpatch_size){
-          return false;
-        } else {
-          return true;
-        }
-      } else {
-        for(int x = 0;x<2;x++){
-          for(int y = 0;y<2;y++){
-            const float dx = halfpatch_size*(2*x-1);
-            const float dy = halfpatch_size*(2*y-1);
-            const float wdx = c.get_warp_c()(0,0)*dx + c.get_warp_c()(0,1)*dy;
-            const float wdy = c.get_warp_c()(1,0)*dx + c.get_warp_c()(1,1)*dy;
-            const float c_x = c.get_c().x + wdx;
-            const float c_y = c.get_c().y + wdy;
-            if(c_x < 0 || c_y < 0 || c_x > img.cols || c_y > img.rows){
-              return false;
-            }
-          }
-        }
-        return true;
-      }
+  static bool isPatchInFrame(const cv::Mat& img,const cv::Point2f& c,const float extentX,const float extentY){
+    return c.x >= extentX && c.y >= extentY && c.x <= img.cols-extentX && c.y <= img.rows-extentY;
+  }
+
+  /** \brief Computes the half extent of the (warped) patch in the image. Since the warping is the same on all pyramid levels,
+   *         this only needs to be computed once per feature.
+   *
+   *   @param c          - Coordinates of the patch (warping must be computable).
+   *   @param withBorder - Extent of the expanded patch (withBorder = true) or of the patch (withBorder = false).
+   *   @param extentX    - Half extent of the patch in x-direction.
+   *   @param extentY    - Half extent of the patch in y-direction.
+   */
+  static void getPatchExtent(const PatchCoordinates& c,const bool withBorder,float& extentX,float& extentY){
+    const int halfpatch_size = patchSize/2+(int)withBorder;
+    if(c.isNearIdentityWarping()){
+      extentX = halfpatch_size;
+      extentY = halfpatch_size;
     } else {
-      return false;
+      const Eigen::Matrix2f warp = c.get_warp_c();
+      extentX = halfpatch_size*(std::fabs(warp(0,0))+std::fabs(warp(0,1)));
+      extentY = halfpatch_size*(std::fabs(warp(1,0))+std::fabs(warp(1,1)));
     }
   }
 
@@ -233,75 +195,263 @@ class Patch {
    *   @param c          - Coordinates of the patch in the reference image (subpixel coordinates possible).
    *   @param withBorder - If false, the patch object is only initialized with the patch data of the general patch (Patch::patch_).
    *                       If true, the patch object is initialized with both, the patch data of the general patch (Patch::patch_)
-   *                       and the patch data of the expanded patch (Patch::patchWithBorder_).
+   *                       and the patch data of the expanded patch (Patch::patchWithBorder_). In this case the gradient
+   *                       parameters are computed in the same pass: every patch row, its central difference gradients
+   *                       and its Hessian contribution are computed as soon as the three expanded rows they depend on
+   *                       have been interpolated.
    */
   void extractPatchFromImage(const cv::Mat& img,const FeatureCoordinates& c,const bool withBorder = false){
+    PatchCoordinates pc;
+    const bool validCoordinates = pc.set(c);
+    assert(validCoordinates);
+    if(!validCoordinates) return;
+    extractPatchFromImage(img,pc,withBorder);
+  }
+
+  /** \brief Extracts a patch from an image (see extractPatchFromImage(const cv::Mat&,const FeatureCoordinates&,const bool)).
+   *
+   *   @param img        - Reference Image.
+   *   @param c          - Pixel coordinates and warping of the patch in the reference image.
+   *   @param withBorder - Additionally extract the expanded patch and compute the gradient parameters.
+   */
+  void extractPatchFromImage(const cv::Mat& img,const PatchCoordinates& c,const bool withBorder = false){
     assert(isPatchInFrame(img,c,withBorder));
-    const int halfpatch_size = patchSize/2+(int)withBorder;
-    const int refStep = img.step.p[0];
+    if(!withBorder){
+      interpolateRows<patchSize>(img,c,patch_,0,patchSize);
+      validGradientParameters_ = false;
+      validPatchWithBorder_ = false;
+      return;
+    }
 
-    // Get Pointers
-    uint8_t* img_ptr;
-    float* patch_ptr;
-    if(withBorder){
-      patch_ptr = patchWithBorder_;
-    } else {
-      patch_ptr = patch_;
+    // Interpolate the expanded patch row by row, and sweep every patch row as soon as its lower neighbour row is available
+    interpolateRows<patchSize+2>(img,c,patchWithBorder_,0,2);
+    float hxx = 0, hxy = 0, hyy = 0, hx = 0, hy = 0;
+    for(int y=0; y<patchSize; ++y){
+      interpolateRows<patchSize+2>(img,c,patchWithBorder_,y+2,y+3);
+      sweepPatchWithBorderRow(patchWithBorder_,y,patch_,dx_,dy_,hxx,hxy,hyy,hx,hy);
     }
+    H_.map() << hxx, hxy, hx,
+                hxy, hyy, hy,
+                hx,  hy,  patchSize*patchSize;
+    computeScoreFromHessian();
+    validPatchWithBorder_ = true;
+  }
+
+  /** \brief Extracts a patch from an image and interpolates its intensity gradients from precomputed gradient images
+   *         (see ImagePyramid::computeGradients()) instead of differencing an expanded patch. Computes the gradient
+   *         parameters like the extraction with border, but does not set the expanded patch (patchWithBorder_ is marked invalid).
+   *
+   *   @param img   - Reference Image.
+   *   @param gradX - Gradient image of img in x-direction (twice the central difference, CV_16SC1).
+   *   @param gradY - Gradient image of img in y-direction (twice the central difference, CV_16SC1).
+   *   @param c     - Coordinates of the patch in the reference image (subpixel coordinates possible).
+   */
+  void extractPatchAndGradientsFromImage(const cv::Mat& img,const cv::Mat& gradX,const cv::Mat& gradY,const FeatureCoordinates& c){
+    PatchCoordinates pc;
+    const bool validCoordinates = pc.set(c);
+    assert(validCoordinates);
+    if(!validCoordinates) return;
+    extractPatchAndGradientsFromImage(img,gradX,gradY,pc);
+  }
 
+  /** \brief Extracts a patch and its interpolated intensity gradients from an image (see
+   *         extractPatchAndGradientsFromImage(const cv::Mat&,const cv::Mat&,const cv::Mat&,const FeatureCoordinates&)).
+   *
+   *   @param img   - Reference Image.
+   *   @param gradX - Gradient image of img in x-direction.
+   *   @param gradY - Gradient image of img in y-direction.
+   *   @param c     - Pixel coordinates and warping of the patch in the reference image.
+   */
+  void extractPatchAndGradientsFromImage(const cv::Mat& img,const cv::Mat& gradX,const cv::Mat& gradY,const PatchCoordinates& c){
+    assert(isPatchInFrame(img,c,true));
+    extractPatchFromImage(img,c,false);
+    const int refStep = gradX.step.p[0]/sizeof(int16_t);
     if(c.isNearIdentityWarping()){
+      const int halfpatch_size = patchSize/2;
       const int u_r = floor(c.get_c().x);
       const int v_r = floor(c.get_c().y);
+      const int offset = (v_r-halfpatch_size)*refStep + u_r-halfpatch_size;
+      interpolateGradientPatch<patchSize>((const int16_t*)gradX.data+offset,(const int16_t*)gradY.data+offset,refStep,
+                                          c.get_c().x-u_r,c.get_c().y-v_r,dx_,dy_);
+    } else {
+      interpolateWarpedGradientPatch<patchSize>((const int16_t*)gradX.data,(const int16_t*)gradY.data,refStep,
+                                                c.get_c().x,c.get_c().y,c.get_warp_c(),dx_,dy_);
+    }
+    computeHessianFromGradients(dx_,dy_,H_);
+    computeScoreFromHessian();
+  }
 
-      // compute interpolation weights
-      const float subpix_x = c.get_c().x-u_r;
-      const float subpix_y = c.get_c().y-v_r;
-      const float wTL = (1.0-subpix_x)*(1.0-subpix_y);
-      const float wTR = subpix_x * (1.0-subpix_y);
-      const float wBL = (1.0-subpix_x)*subpix_y;
-      const float wBR = subpix_x * subpix_y;
-      for(int y=0; y<2*halfpatch_size; ++y){
-        img_ptr = (uint8_t*) img.data + (v_r+y-halfpatch_size)*refStep + u_r-halfpatch_size;
-        for(int x=0; x<2*halfpatch_size; ++x, ++img_ptr, ++patch_ptr)
-        {
-          *patch_ptr = wTL*img_ptr[0];
-          if(subpix_x > 0) *patch_ptr += wTR*img_ptr[1];
-          if(subpix_y > 0) *patch_ptr += wBL*img_ptr[refStep];
-          if(subpix_x > 0 && subpix_y > 0) *patch_ptr += wBR*img_ptr[refStep+1];
-        }
-      }
+ private:
+  /** \brief Single sweep over an expanded patch, computing the central difference gradients and the Hessian.
+   *         The Hessian entries are accumulated in scalars (instead of a 3x3 outer product per pixel).
+   *
+   *   @param patchWithBorder - Expanded patch ((patchSize+2)x(patchSize+2)).
+   *   @param patch           - Output of the inner patch (patchSize x patchSize), skipped if nullptr.
+   *   @param dx              - Output of the gradient component in x-direction.
+   *   @param dy              - Output of the gradient component in y-direction.
+   *   @param H               - Output of the Hessian.
+   */
+  static void sweepPatchWithBorder(const float* patchWithBorder, float* patch, float* dx, float* dy, PodMatrix<3,3>& H){
+    float hxx = 0, hxy = 0, hyy = 0, hx = 0, hy = 0;
+    for(int y=0; y<patchSize; ++y){
+      sweepPatchWithBorderRow(patchWithBorder,y,patch,dx,dy,hxx,hxy,hyy,hx,hy);
+    }
+    H.map() << hxx, hxy, hx,
+               hxy, hyy, hy,
+               hx,  hy,  patchSize*patchSize;
+  }
+
+  /** \brief Sweeps a single row of the patch (see sweepPatchWithBorder()). Only reads the rows y, y+1 and y+2 of the expanded patch.
+   *
+   *   @param patchWithBorder - Expanded patch ((patchSize+2)x(patchSize+2)).
+   *   @param y               - Patch row.
+   *   @param patch           - Output of the inner patch (patchSize x patchSize), skipped if nullptr.
+   *   @param dx              - Output of the gradient component in x-direction.
+   *   @param dy              - Output of the gradient component in y-direction.
+   */
+  static inline void sweepPatchWithBorderRow(const float* patchWithBorder, const int y, float* patch, float* dx, float* dy,
+                                             float& hxx, float& hxy, float& hyy, float& hx, float& hy){
+    const int refStep = patchSize+2;
+    const float* it = patchWithBorder + (y+1)*refStep + 1;
+    if(patch != nullptr){
+      patch += y*patchSize;
+      for(int x=0; x<patchSize; ++x) patch[x] = it[x];
+    }
+    dx += y*patchSize;
+    dy += y*patchSize;
+    for(int x=0; x<patchSize; ++x){
+      dx[x] = 0.5 * (it[x+1] - it[x-1]);
+      dy[x] = 0.5 * (it[x+refStep] - it[x-refStep]);
+    }
+    accumulateHessianRow(dx,dy,hxx,hxy,hyy,hx,hy);
+  }
+
+  /** \brief Interpolates the rows [yBegin,yEnd) of an NxN patch (N = patchSize or N = patchSize+2) centered at the patch
+   *         coordinates (vectorized, see PatchInterpolation.hpp).
+   *
+   *   @param img       - Reference Image.
+   *   @param c         - Pixel coordinates and warping of the patch in the reference image.
+   *   @param patch_ptr - Output array with N*N elements (row-major).
+   *   @param yBegin    - First row to interpolate.
+   *   @param yEnd      - Row after the last row to interpolate.
+   */
+  template<int N>
+  static void interpolateRows(const cv::Mat& img,const PatchCoordinates& c,float* patch_ptr,const int yBegin,const int yEnd){
+    const int halfpatch_size = N/2;
+    const int refStep = img.step.p[0];
+    if(c.isNearIdentityWarping()){
+      const int u_r = floor(c.get_c().x);
+      const int v_r = floor(c.get_c().y);
+      const uint8_t* img_ptr = (uint8_t*) img.data + (v_r-halfpatch_size)*refStep + u_r-halfpatch_size;
+      interpolatePatchRows<N>(img_ptr,refStep,c.get_c().x-u_r,c.get_c().y-v_r,patch_ptr,yBegin,yEnd);
     } else {
-      for(int y=0; y<2*halfpatch_size; ++y){
-        for(int x=0; x<2*halfpatch_size; ++x, ++patch_ptr){
-          const float dx = x - halfpatch_size + 0.5;
-          const float dy = y - halfpatch_size + 0.5;
-          const float wdx = c.get_warp_c()(0,0)*dx + c.get_warp_c()(0,1)*dy;
-          const float wdy = c.get_warp_c()(1,0)*dx + c.get_warp_c()(1,1)*dy;
-          const float u_pixel = c.get_c().x+wdx - 0.5;
-          const float v_pixel = c.get_c().y+wdy - 0.5;
-          const int u_r = floor(u_pixel);
-          const int v_r = floor(v_pixel);
-          const float subpix_x = u_pixel-u_r;
-          const float subpix_y = v_pixel-v_r;
-          const float wTL = (1.0-subpix_x) * (1.0-subpix_y);
-          const float wTR = subpix_x * (1.0-subpix_y);
-          const float wBL = (1.0-subpix_x) * subpix_y;
-          const float wBR = subpix_x * subpix_y;
-          img_ptr = (uint8_t*) img.data + v_r*refStep + u_r;
-          *patch_ptr = wTL*img_ptr[0];
-          if(subpix_x > 0) *patch_ptr += wTR*img_ptr[1];
-          if(subpix_y > 0) *patch_ptr += wBL*img_ptr[refStep];
-          if(subpix_x > 0 && subpix_y > 0) *patch_ptr += wBR*img_ptr[refStep+1];
-        }
-      }
+      interpolateWarpedPatchRows<N>(img.data,refStep,img.cols,img.rows,c.get_c().x,c.get_c().y,c.get_warp_c(),patch_ptr,yBegin,yEnd);
     }
-    if(withBorder){
-      extractPatchFromPatchWithBorder();
+  }
+
+  /** \brief Computes the Hessian from given gradient components.
+   *
+   *   @param dx - Gradient components in x-direction.
+   *   @param dy - Gradient components in y-direction.
+   *   @param H  - Output of the Hessian.
+   */
+  static void computeHessianFromGradients(const float* dx, const float* dy, PodMatrix<3,3>& H){
+    float hxx = 0, hxy = 0, hyy = 0, hx = 0, hy = 0;
+    for(int y=0; y<patchSize; ++y, dx += patchSize, dy += patchSize){
+      accumulateHessianRow(dx,dy,hxx,hxy,hyy,hx,hy);
+    }
+    H.map() << hxx, hxy, hx,
+               hxy, hyy, hy,
+               hx,  hy,  patchSize*patchSize;
+  }
+
+  /** \brief Accumulates the Hessian entries of a single patch row.
+   */
+  static inline void accumulateHessianRow(const float* dx, const float* dy, float& hxx, float& hxy, float& hyy, float& hx, float& hy){
+    for(int x=0; x<patchSize; ++x){
+      hxx += dx[x]*dx[x];
+      hxy += dx[x]*dy[x];
+      hyy += dy[x]*dy[x];
+      hx += dx[x];
+      hy += dy[x];
     }
-    validGradientParameters_ = false;
+  }
+
+  /** \brief Computes the Eigenvalues e0_ e1_ and the Shi-Tomasi Score s_ from the Hessian H_.
+   *         Sets validGradientParameters_ afterwards to true.
+   */
+  void computeScoreFromHessian() const{
+    const float dXX = H_(0,0)/(patchSize*patchSize);
+    const float dYY = H_(1,1)/(patchSize*patchSize);
+    const float dXY = H_(0,1)/(patchSize*patchSize);
+
+    e0_ = 0.5 * (dXX + dYY - sqrtf((dXX + dYY) * (dXX + dYY) - 4 * (dXX * dYY - dXY * dXY)));
+    e1_ = 0.5 * (dXX + dYY + sqrtf((dXX + dYY) * (dXX + dYY) - 4 * (dXX * dYY - dXY * dXY)));
+    s_ = e0_+e1_;
+    validGradientParameters_ = true;
   }
 };
 
+/** \brief Draws the patch into an image.
+ *
+ *   @param drawImg    - Image in which the patch should be drawn.
+ *   @param p          - %Patch to draw.
+ *   @param c          - Pixel coordinates of the left upper patch corner.
+ *   @param stretch    - %Patch drawing magnification factor.
+ *   @param withBorder - Draw either the patch patch_ (withBorder = false) or the expanded patch
+ *                       patchWithBorder_ (withBorder = true).
+ */
+template<int patchSize>
+void drawPatch(cv::Mat& drawImg,const Patch<patchSize>& p,const cv::Point2i& c,int stretch = 1,const bool withBorder = false){
+  const int refStepY = drawImg.step.p[0];
+  const int refStepX = drawImg.step.p[1];
+  uint8_t* img_ptr;
+  const float* it_patch;
+  if(withBorder){
+    assert(p.validPatchWithBorder_);
+    it_patch = p.patchWithBorder_;
+  } else {
+    it_patch = p.patch_;
+  }
+  for(int y=0; y<patchSize+2*(int)withBorder; ++y, it_patch += patchSize+2*(int)withBorder){
+    img_ptr = (uint8_t*) drawImg.data + (c.y+y*stretch)*refStepY + c.x*refStepX;
+    for(int x=0; x<patchSize+2*(int)withBorder; ++x)
+      for(int i=0;i<stretch;++i){
+        for(int j=0;j<stretch;++j){
+          img_ptr[x*stretch*refStepX+i*refStepY+j*refStepX+0] = (uint8_t)(it_patch[x]);
+          if(drawImg.channels() == 3){
+            img_ptr[x*stretch*refStepX+i*refStepY+j*refStepX+1] = (uint8_t)(it_patch[x]);
+            img_ptr[x*stretch*refStepX+i*refStepY+j*refStepX+2] = (uint8_t)(it_patch[x]);
+          }
+        }
+      }
+  }
+}
+
+/** \brief Draws the patch borders into an image.
+ *
+ * @param drawImg     - Image in which the patch borders should be drawn.
+ * @param p           - %Patch to draw (only its size is used).
+ * @param c           - Coordinates of the patch in the reference image.
+ * @param s           - Scaling factor.
+ * @param color       - Line color.
+ */
+template<int patchSize>
+void drawPatchBorder(cv::Mat& drawImg,const Patch<patchSize>& p,const FeatureCoordinates& c,const float s, const cv::Scalar& color){
+  const double half_length = s*patchSize/2;
+  if(c.isInFront() && c.com_warp_c()){
+    cv::Point2f c1 = c.get_patchCorner(half_length,half_length).get_c();
+    cv::Point2f c2 = c.get_patchCorner(half_length,-half_length).get_c();
+    cv::line(drawImg,c1,c2,color,1);
+    c1 = c.get_patchCorner(-half_length,-half_length).get_c();
+    cv::line(drawImg,c2,c1,color,1);
+    c2 = c.get_patchCorner(-half_length,half_length).get_c();
+    cv::line(drawImg,c1,c2,color,1);
+    c1 = c.get_patchCorner(half_length,half_length).get_c();
+    cv::line(drawImg,c2,c1,color,1);
+  }
+}
+
 }
 
 
@@ -0,0 +1,109 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_PATCHCOORDINATES_HPP_
+#define ROVIO_PATCHCOORDINATES_HPP_
+
+#include "rovio/FeatureCoordinates.hpp"
+
+namespace rovio{
+
+/** \brief Compact pixel coordinates and pixel warping of a patch, used within the Patch and alignment layer.
+ *
+ *  Trivially copyable value type (no camera, no bearing vector, no uncertainty). It is converted from
+ *  FeatureCoordinates once at the entry of the Patch and alignment functions and the aligned pixel coordinates are
+ *  written back at their exit, such that the inner loops (pyramid levels, iterations, seeds) only copy a few floats.
+ */
+struct PatchCoordinates{
+  float x_;  /**<Pixel x-coordinate.*/
+  float y_;  /**<Pixel y-coordinate.*/
+  float warp_[4];  /**<Transformation matrix for pixel coordinates (row-major, from the patch to the frame).*/
+  bool isNearIdentity_;  /**<Is the warping near identity (the same on all pyramid levels).*/
+
+  /** \brief Sets the pixel coordinates and the warping from FeatureCoordinates.
+   *
+   *  @param c - Feature coordinates.
+   *  @return false, if the pixel coordinates or the warping of c cannot be computed.
+   */
+  bool set(const FeatureCoordinates& c){
+    if(!c.com_c() || !c.com_warp_c()) return false;
+    set_c(c.get_c());
+    const Eigen::Matrix2f& warp = c.get_warp_c();
+    warp_[0] = warp(0,0);
+    warp_[1] = warp(0,1);
+    warp_[2] = warp(1,0);
+    warp_[3] = warp(1,1);
+    isNearIdentity_ = c.isNearIdentityWarping();
+    return true;
+  }
+
+  /** \brief Sets the pixel coordinates, keeps the warping.
+   *
+   *  @param c - Pixel coordinates.
+   */
+  void set_c(const cv::Point2f& c){
+    x_ = c.x;
+    y_ = c.y;
+  }
+
+  /** \brief Get the pixel coordinates.
+   */
+  cv::Point2f get_c() const{
+    return cv::Point2f(x_,y_);
+  }
+
+  /** \brief Get the warping matrix for pixel coordinates.
+   */
+  Eigen::Matrix2f get_warp_c() const{
+    Eigen::Matrix2f warp;
+    warp << warp_[0], warp_[1],
+            warp_[2], warp_[3];
+    return warp;
+  }
+
+  /** \brief Sets the warping to identity.
+   */
+  void set_warp_identity(){
+    warp_[0] = 1.0f;
+    warp_[1] = 0.0f;
+    warp_[2] = 0.0f;
+    warp_[3] = 1.0f;
+    isNearIdentity_ = true;
+  }
+
+  /** \brief Checks if the warping is near identity.
+   */
+  bool isNearIdentityWarping() const{
+    return isNearIdentity_;
+  }
+};
+
+}
+
+
+#endif /* ROVIO_PATCHCOORDINATES_HPP_ */
@@ -0,0 +1,610 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_PATCHINTERPOLATION_HPP_
+#define ROVIO_PATCHINTERPOLATION_HPP_
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <Eigen/Core>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ROVIO_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace rovio{
+
+/** \brief Instruction set used for the bilinear patch interpolation.
+ *
+ *  The scalar kernel is the reference implementation. For axis aligned patches the SIMD kernels compute the very same sums
+ *  (same weights, same order of summation) and are therefore bit-identical to the scalar kernel, as long as the
+ *  compiler does not contract the scalar multiply-adds into FMA instructions (e.g. with -march=native on a FMA capable CPU).
+ *  In this case the results differ by at most a few ulp, which is below 1e-4 intensity units for 8-bit images.
+ *  For warped patches the SIMD kernels compute the sample locations with the same operations as the scalar kernel, the
+ *  bilinear weights are computed in single precision and agree up to a few ulp (see interpolateWarpedPatchSSE2()).
+ */
+enum InterpolationKernel{
+  KERNEL_SCALAR, /**<Plain C++ implementation, one pixel at a time.*/
+  KERNEL_SSE2, /**<SSE2 implementation, 4 pixels per instruction.*/
+  KERNEL_AVX2 /**<AVX2 implementation, 8 pixels per instruction.*/
+};
+
+/** \brief Checks if an interpolation kernel can be executed on the current CPU.
+ *
+ *   @param kernel - Interpolation kernel.
+ *   @return true, if the kernel is supported.
+ */
+inline bool isInterpolationKernelSupported(const InterpolationKernel kernel){
+  switch(kernel){
+    case KERNEL_SCALAR:
+      return true;
+#ifdef ROVIO_X86_SIMD
+    case KERNEL_SSE2:
+      return __builtin_cpu_supports("sse2");
+    case KERNEL_AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+/** \brief Returns the fastest interpolation kernel supported by the current CPU.
+ */
+inline InterpolationKernel getBestInterpolationKernel(){
+  if(isInterpolationKernelSupported(KERNEL_AVX2)) return KERNEL_AVX2;
+  if(isInterpolationKernelSupported(KERNEL_SSE2)) return KERNEL_SSE2;
+  return KERNEL_SCALAR;
+}
+
+/** \brief Access to the interpolation kernel which is used by the patch extraction. Selected at runtime, can be
+ *         overwritten (e.g. for testing or benchmarking). Must only be set to supported kernels.
+ */
+inline InterpolationKernel& activeInterpolationKernel(){
+  static InterpolationKernel kernel = getBestInterpolationKernel();
+  return kernel;
+}
+
+/** \brief Computes the bilinear interpolation weights (top-left, top-right, bottom-left, bottom-right).
+ *
+ *   @param subpix_x - Subpixel offset in x-direction [0,1).
+ *   @param subpix_y - Subpixel offset in y-direction [0,1).
+ *   @param w        - Array of the 4 interpolation weights.
+ */
+inline void computeBilinearWeights(const float subpix_x, const float subpix_y, float* w){
+  w[0] = (1.0-subpix_x)*(1.0-subpix_y);
+  w[1] = subpix_x * (1.0-subpix_y);
+  w[2] = (1.0-subpix_x)*subpix_y;
+  w[3] = subpix_x * subpix_y;
+}
+
+/** \brief Interpolates a square, axis aligned NxN patch with constant subpixel offset (scalar reference implementation).
+ *
+ *   The right column and the bottom row of the bilinear stencil are only accessed if the corresponding subpixel offset is non-zero.
+ *
+ *   @tparam N        - Edge length of the patch.
+ *   @param img_ptr   - Pointer to the image pixel corresponding to the top-left patch pixel.
+ *   @param refStep   - Row step of the image in bytes.
+ *   @param subpix_x  - Subpixel offset in x-direction [0,1).
+ *   @param subpix_y  - Subpixel offset in y-direction [0,1).
+ *   @param patch_ptr - Output array with N*N elements (row-major).
+ *   @param yBegin    - First patch row to interpolate.
+ *   @param yEnd      - Patch row after the last row to interpolate (the other rows of patch_ptr are left untouched).
+ */
+template<int N>
+void interpolatePatchScalar(const uint8_t* img_ptr, const int refStep, const float subpix_x, const float subpix_y, float* patch_ptr,
+                            const int yBegin = 0, const int yEnd = N){
+  float w[4];
+  computeBilinearWeights(subpix_x,subpix_y,w);
+  patch_ptr += yBegin*N;
+  for(int y=yBegin; y<yEnd; ++y){
+    const uint8_t* it_img = img_ptr + y*refStep;
+    for(int x=0; x<N; ++x, ++it_img, ++patch_ptr){
+      *patch_ptr = w[0]*it_img[0];
+      if(subpix_x > 0) *patch_ptr += w[1]*it_img[1];
+      if(subpix_y > 0) *patch_ptr += w[2]*it_img[refStep];
+      if(subpix_x > 0 && subpix_y > 0) *patch_ptr += w[3]*it_img[refStep+1];
+    }
+  }
+}
+
+#ifdef ROVIO_X86_SIMD
+/** \brief Loads n consecutive bytes (n = 2, 4, 6 or 8) from an arbitrarily aligned address into the lower bytes of a
+ *         vector, the remaining bytes are zero. Only the n bytes are accessed.
+ *
+ *   @param p - Address of the first byte.
+ *   @param n - Number of bytes.
+ */
+__attribute__((target("sse2")))
+inline __m128i loadBytesSSE2(const uint8_t* p, const int n){
+  int32_t lo;
+  uint16_t hi;
+  switch(n){
+    case 8:
+      return _mm_loadl_epi64((const __m128i*)p);
+    case 6:
+      memcpy(&lo,p,4);
+      memcpy(&hi,p+4,2);
+      return _mm_insert_epi16(_mm_cvtsi32_si128(lo),hi,2);
+    case 4:
+      memcpy(&lo,p,4);
+      return _mm_cvtsi32_si128(lo);
+    default:
+      assert(n == 2);
+      memcpy(&hi,p,2);
+      return _mm_cvtsi32_si128(hi);
+  }
+}
+
+/** \brief Stores the first n floats (n = 2, 4, 6 or 8) of two vectors (lanes 0-3 and 4-7).
+ */
+__attribute__((target("sse2")))
+inline void storeFloatsSSE2(float* p, const __m128 lo, const __m128 hi, const int n){
+  switch(n){
+    case 8:
+      _mm_storeu_ps(p,lo);
+      _mm_storeu_ps(p+4,hi);
+      break;
+    case 6:
+      _mm_storeu_ps(p,lo);
+      _mm_storel_pi((__m64*)(p+4),hi);
+      break;
+    case 4:
+      _mm_storeu_ps(p,lo);
+      break;
+    default:
+      assert(n == 2);
+      _mm_storel_pi((__m64*)p,lo);
+      break;
+  }
+}
+
+/** \brief SSE2 version of interpolatePatchScalar(), 4 pixels per instruction.
+ *
+ *   The stencil samples are loaded directly from the image rows with unaligned loads (up to 8 pixels at once), without
+ *   reading beyond the pixels accessed by the scalar kernel. Stencil samples with a zero weight are aliased to the
+ *   top-left samples.
+ */
+template<int N>
+__attribute__((target("sse2")))
+void interpolatePatchSSE2(const uint8_t* img_ptr, const int refStep, const float subpix_x, const float subpix_y, float* patch_ptr,
+                          const int yBegin = 0, const int yEnd = N){
+  static_assert(N%2 == 0,"Patch size must be a multiple of 2");
+  float w[4];
+  computeBilinearWeights(subpix_x,subpix_y,w);
+  const int o1 = subpix_x > 0 ? 1 : 0;
+  const int o2 = subpix_y > 0 ? refStep : 0;
+  const __m128 wTL = _mm_set1_ps(w[0]);
+  const __m128 wTR = _mm_set1_ps(w[1]);
+  const __m128 wBL = _mm_set1_ps(w[2]);
+  const __m128 wBR = _mm_set1_ps(w[3]);
+  const __m128i zero = _mm_setzero_si128();
+  img_ptr += yBegin*refStep;
+  patch_ptr += yBegin*N;
+  for(int y=yBegin; y<yEnd; ++y, img_ptr += refStep, patch_ptr += N){
+    for(int x=0; x<N; x+=8){
+      const int n = N-x < 8 ? N-x : 8;
+      const __m128i tl = _mm_unpacklo_epi8(loadBytesSSE2(img_ptr+x,n),zero);
+      const __m128i tr = _mm_unpacklo_epi8(loadBytesSSE2(img_ptr+x+o1,n),zero);
+      const __m128i bl = _mm_unpacklo_epi8(loadBytesSSE2(img_ptr+x+o2,n),zero);
+      const __m128i br = _mm_unpacklo_epi8(loadBytesSSE2(img_ptr+x+o1+o2,n),zero);
+      __m128 lo = _mm_mul_ps(wTL,_mm_cvtepi32_ps(_mm_unpacklo_epi16(tl,zero)));
+      lo = _mm_add_ps(lo,_mm_mul_ps(wTR,_mm_cvtepi32_ps(_mm_unpacklo_epi16(tr,zero))));
+      lo = _mm_add_ps(lo,_mm_mul_ps(wBL,_mm_cvtepi32_ps(_mm_unpacklo_epi16(bl,zero))));
+      lo = _mm_add_ps(lo,_mm_mul_ps(wBR,_mm_cvtepi32_ps(_mm_unpacklo_epi16(br,zero))));
+      __m128 hi = _mm_mul_ps(wTL,_mm_cvtepi32_ps(_mm_unpackhi_epi16(tl,zero)));
+      hi = _mm_add_ps(hi,_mm_mul_ps(wTR,_mm_cvtepi32_ps(_mm_unpackhi_epi16(tr,zero))));
+      hi = _mm_add_ps(hi,_mm_mul_ps(wBL,_mm_cvtepi32_ps(_mm_unpackhi_epi16(bl,zero))));
+      hi = _mm_add_ps(hi,_mm_mul_ps(wBR,_mm_cvtepi32_ps(_mm_unpackhi_epi16(br,zero))));
+      storeFloatsSSE2(patch_ptr+x,lo,hi,n);
+    }
+  }
+}
+
+/** \brief AVX2 version of interpolatePatchScalar(), 8 pixels per instruction.
+ *
+ *   \see interpolatePatchSSE2() for the loading of the stencil samples.
+ */
+template<int N>
+__attribute__((target("avx2")))
+void interpolatePatchAVX2(const uint8_t* img_ptr, const int refStep, const float subpix_x, const float subpix_y, float* patch_ptr,
+                          const int yBegin = 0, const int yEnd = N){
+  static_assert(N%2 == 0,"Patch size must be a multiple of 2");
+  float w[4];
+  computeBilinearWeights(subpix_x,subpix_y,w);
+  const int o1 = subpix_x > 0 ? 1 : 0;
+  const int o2 = subpix_y > 0 ? refStep : 0;
+  const __m256 wTL = _mm256_set1_ps(w[0]);
+  const __m256 wTR = _mm256_set1_ps(w[1]);
+  const __m256 wBL = _mm256_set1_ps(w[2]);
+  const __m256 wBR = _mm256_set1_ps(w[3]);
+  img_ptr += yBegin*refStep;
+  patch_ptr += yBegin*N;
+  for(int y=yBegin; y<yEnd; ++y, img_ptr += refStep, patch_ptr += N){
+    for(int x=0; x<N; x+=8){
+      const int n = N-x < 8 ? N-x : 8;
+      const __m256 vTL = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(loadBytesSSE2(img_ptr+x,n)));
+      const __m256 vTR = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(loadBytesSSE2(img_ptr+x+o1,n)));
+      const __m256 vBL = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(loadBytesSSE2(img_ptr+x+o2,n)));
+      const __m256 vBR = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(loadBytesSSE2(img_ptr+x+o1+o2,n)));
+      __m256 v = _mm256_mul_ps(wTL,vTL);
+      v = _mm256_add_ps(v,_mm256_mul_ps(wTR,vTR));
+      v = _mm256_add_ps(v,_mm256_mul_ps(wBL,vBL));
+      v = _mm256_add_ps(v,_mm256_mul_ps(wBR,vBR));
+      if(n == 8){
+        _mm256_storeu_ps(patch_ptr+x,v);
+      } else {
+        storeFloatsSSE2(patch_ptr+x,_mm256_castps256_ps128(v),_mm256_extractf128_ps(v,1),n);
+      }
+    }
+  }
+}
+#endif
+
+/** \brief Interpolates the rows [yBegin,yEnd) of a square, axis aligned NxN patch with constant subpixel offset using the given kernel.
+ *
+ *   \see interpolatePatchScalar()
+ */
+template<int N>
+void interpolatePatchRows(const uint8_t* img_ptr, const int refStep, const float subpix_x, const float subpix_y, float* patch_ptr,
+                          const int yBegin, const int yEnd, const InterpolationKernel kernel = activeInterpolationKernel()){
+  switch(kernel){
+#ifdef ROVIO_X86_SIMD
+    case KERNEL_AVX2:
+      interpolatePatchAVX2<N>(img_ptr,refStep,subpix_x,subpix_y,patch_ptr,yBegin,yEnd);
+      break;
+    case KERNEL_SSE2:
+      interpolatePatchSSE2<N>(img_ptr,refStep,subpix_x,subpix_y,patch_ptr,yBegin,yEnd);
+      break;
+#endif
+    default:
+      interpolatePatchScalar<N>(img_ptr,refStep,subpix_x,subpix_y,patch_ptr,yBegin,yEnd);
+      break;
+  }
+}
+
+/** \brief Interpolates a square, axis aligned NxN patch with constant subpixel offset using the given kernel.
+ *
+ *   \see interpolatePatchScalar()
+ */
+template<int N>
+void interpolatePatch(const uint8_t* img_ptr, const int refStep, const float subpix_x, const float subpix_y, float* patch_ptr,
+                      const InterpolationKernel kernel = activeInterpolationKernel()){
+  interpolatePatchRows<N>(img_ptr,refStep,subpix_x,subpix_y,patch_ptr,0,N,kernel);
+}
+
+/** \brief Interpolates a square NxN patch which is affinely warped into the image (scalar reference implementation).
+ *
+ *   The sample location of every patch pixel is computed independently, and the bilinear stencil is only accessed
+ *   where the corresponding subpixel offset is non-zero.
+ *
+ *   @tparam N        - Edge length of the patch.
+ *   @param img_data  - Pointer to the image data.
+ *   @param refStep   - Row step of the image in bytes.
+ *   @param cx        - x-coordinate of the patch center in the image.
+ *   @param cy        - y-coordinate of the patch center in the image.
+ *   @param warp      - Affine warping from patch to image coordinates.
+ *   @param patch_ptr - Output array with N*N elements (row-major).
+ *   @param yBegin    - First patch row to interpolate.
+ *   @param yEnd      - Patch row after the last row to interpolate (the other rows of patch_ptr are left untouched).
+ */
+template<int N>
+void interpolateWarpedPatchScalar(const uint8_t* img_data, const int refStep, const float cx, const float cy, const Eigen::Matrix2f& warp, float* patch_ptr,
+                                  const int yBegin = 0, const int yEnd = N){
+  const int halfpatch_size = N/2;
+  patch_ptr += yBegin*N;
+  for(int y=yBegin; y<yEnd; ++y){
+    for(int x=0; x<N; ++x, ++patch_ptr){
+      const float dx = x - halfpatch_size + 0.5;
+      const float dy = y - halfpatch_size + 0.5;
+      const float wdx = warp(0,0)*dx + warp(0,1)*dy;
+      const float wdy = warp(1,0)*dx + warp(1,1)*dy;
+      const float u_pixel = cx+wdx - 0.5;
+      const float v_pixel = cy+wdy - 0.5;
+      const int u_r = floor(u_pixel);
+      const int v_r = floor(v_pixel);
+      const float subpix_x = u_pixel-u_r;
+      const float subpix_y = v_pixel-v_r;
+      const float wTL = (1.0-subpix_x) * (1.0-subpix_y);
+      const float wTR = subpix_x * (1.0-subpix_y);
+      const float wBL = (1.0-subpix_x) * subpix_y;
+      const float wBR = subpix_x * subpix_y;
+      const uint8_t* img_ptr = img_data + v_r*refStep + u_r;
+      *patch_ptr = wTL*img_ptr[0];
+      if(subpix_x > 0) *patch_ptr += wTR*img_ptr[1];
+      if(subpix_y > 0) *patch_ptr += wBL*img_ptr[refStep];
+      if(subpix_x > 0 && subpix_y > 0) *patch_ptr += wBR*img_ptr[refStep+1];
+    }
+  }
+}
+
+#ifdef ROVIO_X86_SIMD
+/** \brief SSE2 version of interpolateWarpedPatchScalar(), 4 pixels per instruction.
+ *
+ *   The sample locations are computed directly from the affine map for every pixel, with the same operations as in the
+ *   scalar kernel. The stencil access is additionally clamped to the image, such that a different rounding of the sample
+ *   locations (e.g. FMA contraction in one of the kernels) can not lead to reads beyond the image: a stencil sample
+ *   outside the image is replaced by the nearest sample inside (its weight is at the level of the coordinate rounding).
+ *   SSE2 has no gather instruction, the 4 stencil samples of every lane are loaded branch-free with scalar loads.
+ *
+ *   @param cols      - Number of image columns.
+ *   @param rows      - Number of image rows.
+ */
+template<int N>
+__attribute__((target("sse2")))
+void interpolateWarpedPatchSSE2(const uint8_t* img_data, const int refStep, const int cols, const int rows, const float cx, const float cy,
+                                const Eigen::Matrix2f& warp, float* patch_ptr, const int yBegin = 0, const int yEnd = N){
+  static_assert(N%2 == 0,"Patch size must be a multiple of 2");
+  const int halfpatch_size = N/2;
+  const __m128 lane = _mm_setr_ps(0,1,2,3);
+  const __m128 w00 = _mm_set1_ps(warp(0,0));
+  const __m128 w01 = _mm_set1_ps(warp(0,1));
+  const __m128 w10 = _mm_set1_ps(warp(1,0));
+  const __m128 w11 = _mm_set1_ps(warp(1,1));
+  const __m128 cxv = _mm_set1_ps(cx);
+  const __m128 cyv = _mm_set1_ps(cy);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 uMax = _mm_set1_ps(cols-1);
+  const __m128 vMax = _mm_set1_ps(rows-1);
+  const __m128 xMax = _mm_set1_ps(N-1);
+  const __m128 dOffset = _mm_set1_ps(0.5f-halfpatch_size);
+  int u_r[4] __attribute__ ((aligned (16)));
+  int v_r[4] __attribute__ ((aligned (16)));
+  int o1[4] __attribute__ ((aligned (16)));
+  int o2[4] __attribute__ ((aligned (16)));
+  patch_ptr += yBegin*N;
+  for(int y=yBegin; y<yEnd; ++y, patch_ptr += N){
+    const __m128 dy = _mm_set1_ps(y+0.5f-halfpatch_size);
+    const __m128 w01dy = _mm_mul_ps(w01,dy);
+    const __m128 w11dy = _mm_mul_ps(w11,dy);
+    for(int x=0; x<N; x+=4){
+      const __m128 dx = _mm_add_ps(_mm_min_ps(_mm_add_ps(_mm_set1_ps(x),lane),xMax),dOffset); // Lanes beyond the patch repeat the last column
+      const __m128 u = _mm_sub_ps(_mm_add_ps(cxv,_mm_add_ps(_mm_mul_ps(w00,dx),w01dy)),half);
+      const __m128 v = _mm_sub_ps(_mm_add_ps(cyv,_mm_add_ps(_mm_mul_ps(w10,dx),w11dy)),half);
+      __m128 fu = _mm_cvtepi32_ps(_mm_cvttps_epi32(u)); // floor
+      __m128 fv = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+      fu = _mm_sub_ps(fu,_mm_and_ps(_mm_cmpgt_ps(fu,u),one));
+      fv = _mm_sub_ps(fv,_mm_and_ps(_mm_cmpgt_ps(fv,v),one));
+      __m128 sx = _mm_sub_ps(u,fu);
+      __m128 sy = _mm_sub_ps(v,fv);
+      sx = _mm_andnot_ps(_mm_or_ps(_mm_cmplt_ps(fu,zero),_mm_cmpge_ps(fu,uMax)),sx); // Clamp to the image
+      sy = _mm_andnot_ps(_mm_or_ps(_mm_cmplt_ps(fv,zero),_mm_cmpge_ps(fv,vMax)),sy);
+      fu = _mm_min_ps(_mm_max_ps(fu,zero),uMax);
+      fv = _mm_min_ps(_mm_max_ps(fv,zero),vMax);
+      _mm_store_si128((__m128i*)u_r,_mm_cvttps_epi32(fu));
+      _mm_store_si128((__m128i*)v_r,_mm_cvttps_epi32(fv));
+      _mm_store_si128((__m128i*)o1,_mm_srli_epi32(_mm_castps_si128(_mm_cmpgt_ps(sx,zero)),31));
+      _mm_store_si128((__m128i*)o2,_mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(sy,zero)),_mm_set1_epi32(refStep)));
+      const uint8_t* p0 = img_data + v_r[0]*refStep + u_r[0];
+      const uint8_t* p1 = img_data + v_r[1]*refStep + u_r[1];
+      const uint8_t* p2 = img_data + v_r[2]*refStep + u_r[2];
+      const uint8_t* p3 = img_data + v_r[3]*refStep + u_r[3];
+      const __m128 tl = _mm_cvtepi32_ps(_mm_setr_epi32(p0[0],p1[0],p2[0],p3[0]));
+      const __m128 tr = _mm_cvtepi32_ps(_mm_setr_epi32(p0[o1[0]],p1[o1[1]],p2[o1[2]],p3[o1[3]]));
+      const __m128 bl = _mm_cvtepi32_ps(_mm_setr_epi32(p0[o2[0]],p1[o2[1]],p2[o2[2]],p3[o2[3]]));
+      const __m128 br = _mm_cvtepi32_ps(_mm_setr_epi32(p0[o1[0]+o2[0]],p1[o1[1]+o2[1]],p2[o1[2]+o2[2]],p3[o1[3]+o2[3]]));
+      const __m128 sx1 = _mm_sub_ps(one,sx);
+      const __m128 sy1 = _mm_sub_ps(one,sy);
+      __m128 r = _mm_mul_ps(_mm_mul_ps(sx1,sy1),tl);
+      r = _mm_add_ps(r,_mm_mul_ps(_mm_mul_ps(sx,sy1),tr));
+      r = _mm_add_ps(r,_mm_mul_ps(_mm_mul_ps(sx1,sy),bl));
+      r = _mm_add_ps(r,_mm_mul_ps(_mm_mul_ps(sx,sy),br));
+      if(N-x >= 4){
+        _mm_storeu_ps(patch_ptr+x,r);
+      } else {
+        _mm_storel_pi((__m64*)(patch_ptr+x),r);
+      }
+    }
+  }
+}
+
+/** \brief Extracts the bytes at the offsets off and off+o1 (o1 = 0 or 1) of every lane with a single gather. The 32-bit
+ *         words are loaded such that they end at the last required byte (and start at the first image byte at the
+ *         latest), i.e. no byte behind the stencil is accessed. The image must hold at least 4 bytes.
+ */
+__attribute__((target("avx2")))
+inline void gatherPixelPairsAVX2(const uint8_t* img_data, const __m256i off, const __m256i o1, __m256& left, __m256& right){
+  const __m256i end = _mm256_add_epi32(off,o1);
+  const __m256i start = _mm256_max_epi32(_mm256_sub_epi32(end,_mm256_set1_epi32(3)),_mm256_setzero_si256());
+  const __m256i words = _mm256_i32gather_epi32((const int*)img_data,start,1);
+  const __m256i byteMask = _mm256_set1_epi32(0xFF);
+  left = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srlv_epi32(words,_mm256_slli_epi32(_mm256_sub_epi32(off,start),3)),byteMask));
+  right = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srlv_epi32(words,_mm256_slli_epi32(_mm256_sub_epi32(end,start),3)),byteMask));
+}
+
+/** \brief AVX2 version of interpolateWarpedPatchScalar(), 8 pixels per instruction.
+ *
+ *   Same sample locations and clamping as interpolateWarpedPatchSSE2(). The stencil samples are loaded with two
+ *   hardware gathers per 8 pixels (top and bottom pixel pairs, see gatherPixelPairsAVX2()).
+ */
+template<int N>
+__attribute__((target("avx2")))
+void interpolateWarpedPatchAVX2(const uint8_t* img_data, const int refStep, const int cols, const int rows, const float cx, const float cy,
+                                const Eigen::Matrix2f& warp, float* patch_ptr, const int yBegin = 0, const int yEnd = N){
+  static_assert(N%2 == 0,"Patch size must be a multiple of 2");
+  const int halfpatch_size = N/2;
+  const __m256 lane = _mm256_setr_ps(0,1,2,3,4,5,6,7);
+  const __m256 w00 = _mm256_set1_ps(warp(0,0));
+  const __m256 w01 = _mm256_set1_ps(warp(0,1));
+  const __m256 w10 = _mm256_set1_ps(warp(1,0));
+  const __m256 w11 = _mm256_set1_ps(warp(1,1));
+  const __m256 cxv = _mm256_set1_ps(cx);
+  const __m256 cyv = _mm256_set1_ps(cy);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 uMax = _mm256_set1_ps(cols-1);
+  const __m256 vMax = _mm256_set1_ps(rows-1);
+  const __m256 xMax = _mm256_set1_ps(N-1);
+  const __m256 dOffset = _mm256_set1_ps(0.5f-halfpatch_size);
+  const __m256i refStepv = _mm256_set1_epi32(refStep);
+  patch_ptr += yBegin*N;
+  for(int y=yBegin; y<yEnd; ++y, patch_ptr += N){
+    const __m256 dy = _mm256_set1_ps(y+0.5f-halfpatch_size);
+    const __m256 w01dy = _mm256_mul_ps(w01,dy);
+    const __m256 w11dy = _mm256_mul_ps(w11,dy);
+    for(int x=0; x<N; x+=8){
+      const __m256 dx = _mm256_add_ps(_mm256_min_ps(_mm256_add_ps(_mm256_set1_ps(x),lane),xMax),dOffset); // Lanes beyond the patch repeat the last column
+      const __m256 u = _mm256_sub_ps(_mm256_add_ps(cxv,_mm256_add_ps(_mm256_mul_ps(w00,dx),w01dy)),half);
+      const __m256 v = _mm256_sub_ps(_mm256_add_ps(cyv,_mm256_add_ps(_mm256_mul_ps(w10,dx),w11dy)),half);
+      __m256 fu = _mm256_floor_ps(u);
+      __m256 fv = _mm256_floor_ps(v);
+      __m256 sx = _mm256_sub_ps(u,fu);
+      __m256 sy = _mm256_sub_ps(v,fv);
+      sx = _mm256_andnot_ps(_mm256_or_ps(_mm256_cmp_ps(fu,zero,_CMP_LT_OQ),_mm256_cmp_ps(fu,uMax,_CMP_GE_OQ)),sx); // Clamp to the image
+      sy = _mm256_andnot_ps(_mm256_or_ps(_mm256_cmp_ps(fv,zero,_CMP_LT_OQ),_mm256_cmp_ps(fv,vMax,_CMP_GE_OQ)),sy);
+      fu = _mm256_min_ps(_mm256_max_ps(fu,zero),uMax);
+      fv = _mm256_min_ps(_mm256_max_ps(fv,zero),vMax);
+      const __m256i off = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(fv),refStepv),_mm256_cvttps_epi32(fu));
+      const __m256i o1 = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cmp_ps(sx,zero,_CMP_GT_OQ)),31);
+      const __m256i o2 = _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(sy,zero,_CMP_GT_OQ)),refStepv);
+      __m256 tl, tr, bl, br;
+      gatherPixelPairsAVX2(img_data,off,o1,tl,tr);
+      gatherPixelPairsAVX2(img_data,_mm256_add_epi32(off,o2),o1,bl,br);
+      const __m256 sx1 = _mm256_sub_ps(one,sx);
+      const __m256 sy1 = _mm256_sub_ps(one,sy);
+      __m256 r = _mm256_mul_ps(_mm256_mul_ps(sx1,sy1),tl);
+      r = _mm256_add_ps(r,_mm256_mul_ps(_mm256_mul_ps(sx,sy1),tr));
+      r = _mm256_add_ps(r,_mm256_mul_ps(_mm256_mul_ps(sx1,sy),bl));
+      r = _mm256_add_ps(r,_mm256_mul_ps(_mm256_mul_ps(sx,sy),br));
+      const int n = N-x < 8 ? N-x : 8;
+      if(n == 8){
+        _mm256_storeu_ps(patch_ptr+x,r);
+      } else {
+        storeFloatsSSE2(patch_ptr+x,_mm256_castps256_ps128(r),_mm256_extractf128_ps(r,1),n);
+      }
+    }
+  }
+}
+#endif
+
+/** \brief Interpolates the rows [yBegin,yEnd) of a square NxN patch which is affinely warped into the image using the given kernel.
+ *
+ *   \see interpolateWarpedPatchScalar()
+ *   The image size is only used by the SIMD kernels, which clamp their stencil access to the image.
+ */
+template<int N>
+void interpolateWarpedPatchRows(const uint8_t* img_data, const int refStep, const int cols, const int rows, const float cx, const float cy,
+                                const Eigen::Matrix2f& warp, float* patch_ptr, const int yBegin, const int yEnd,
+                                const InterpolationKernel kernel = activeInterpolationKernel()){
+  switch(kernel){
+#ifdef ROVIO_X86_SIMD
+    case KERNEL_AVX2:
+      interpolateWarpedPatchAVX2<N>(img_data,refStep,cols,rows,cx,cy,warp,patch_ptr,yBegin,yEnd);
+      break;
+    case KERNEL_SSE2:
+      interpolateWarpedPatchSSE2<N>(img_data,refStep,cols,rows,cx,cy,warp,patch_ptr,yBegin,yEnd);
+      break;
+#endif
+    default:
+      interpolateWarpedPatchScalar<N>(img_data,refStep,cx,cy,warp,patch_ptr,yBegin,yEnd);
+      break;
+  }
+}
+
+/** \brief Interpolates a square NxN patch which is affinely warped into the image using the given kernel.
+ *
+ *   \see interpolateWarpedPatchRows()
+ */
+template<int N>
+void interpolateWarpedPatch(const uint8_t* img_data, const int refStep, const int cols, const int rows, const float cx, const float cy,
+                            const Eigen::Matrix2f& warp, float* patch_ptr, const InterpolationKernel kernel = activeInterpolationKernel()){
+  interpolateWarpedPatchRows<N>(img_data,refStep,cols,rows,cx,cy,warp,patch_ptr,0,N,kernel);
+}
+
+/** \brief Interpolates the intensity gradients of a square, axis aligned NxN patch from precomputed gradient images (see
+ *         computeGradientImages()). Since the interpolation is linear, the result equals the central differences of the
+ *         interpolated intensities.
+ *
+ *   @tparam N         - Edge length of the patch.
+ *   @param gx_ptr     - Pointer to the x-gradient pixel corresponding to the top-left patch pixel.
+ *   @param gy_ptr     - Pointer to the y-gradient pixel corresponding to the top-left patch pixel.
+ *   @param refStep    - Row step of the gradient images in elements.
+ *   @param subpix_x   - Subpixel offset in x-direction [0,1).
+ *   @param subpix_y   - Subpixel offset in y-direction [0,1).
+ *   @param dx         - Output array with N*N gradient components in x-direction.
+ *   @param dy         - Output array with N*N gradient components in y-direction.
+ */
+template<int N>
+void interpolateGradientPatch(const int16_t* gx_ptr, const int16_t* gy_ptr, const int refStep, const float subpix_x, const float subpix_y, float* dx, float* dy){
+  float w[4];
+  computeBilinearWeights(subpix_x,subpix_y,w);
+  for(int i=0;i<4;i++) w[i] *= 0.5; // The gradient images contain twice the central difference
+  const int o1 = subpix_x > 0 ? 1 : 0; // Stencil samples with zero weight are not accessed
+  const int o2 = subpix_y > 0 ? refStep : 0;
+  for(int y=0; y<N; ++y){
+    const int16_t* it_gx = gx_ptr + y*refStep;
+    const int16_t* it_gy = gy_ptr + y*refStep;
+    for(int x=0; x<N; ++x, ++it_gx, ++it_gy, ++dx, ++dy){
+      *dx = w[0]*it_gx[0] + w[1]*it_gx[o1] + w[2]*it_gx[o2] + w[3]*it_gx[o1+o2];
+      *dy = w[0]*it_gy[0] + w[1]*it_gy[o1] + w[2]*it_gy[o2] + w[3]*it_gy[o1+o2];
+    }
+  }
+}
+
+/** \brief Interpolates the intensity gradients of an affinely warped NxN patch from precomputed gradient images. The image
+ *         gradients are mapped into the patch frame (transposed warping), which corresponds to the central differences along
+ *         the warped sample grid up to second order terms.
+ *
+ *   \see interpolateWarpedPatchScalar() for the sample locations.
+ */
+template<int N>
+void interpolateWarpedGradientPatch(const int16_t* gx_data, const int16_t* gy_data, const int refStep, const float cx, const float cy,
+                                    const Eigen::Matrix2f& warp, float* dx, float* dy){
+  const int halfpatch_size = N/2;
+  for(int y=0; y<N; ++y){
+    for(int x=0; x<N; ++x, ++dx, ++dy){
+      const float du = x - halfpatch_size + 0.5;
+      const float dv = y - halfpatch_size + 0.5;
+      const float u_pixel = cx + warp(0,0)*du + warp(0,1)*dv - 0.5;
+      const float v_pixel = cy + warp(1,0)*du + warp(1,1)*dv - 0.5;
+      const int u_r = floor(u_pixel);
+      const int v_r = floor(v_pixel);
+      float w[4];
+      computeBilinearWeights(u_pixel-u_r,v_pixel-v_r,w);
+      const int o1 = w[1] > 0 ? 1 : 0;
+      const int o2 = w[2] > 0 ? refStep : 0;
+      const int16_t* it_gx = gx_data + v_r*refStep + u_r;
+      const int16_t* it_gy = gy_data + v_r*refStep + u_r;
+      const float gx = 0.5*(w[0]*it_gx[0] + w[1]*it_gx[o1] + w[2]*it_gx[o2] + w[3]*it_gx[o1+o2]);
+      const float gy = 0.5*(w[0]*it_gy[0] + w[1]*it_gy[o1] + w[2]*it_gy[o2] + w[3]*it_gy[o1+o2]);
+      *dx = warp(0,0)*gx + warp(1,0)*gy;
+      *dy = warp(0,1)*gx + warp(1,1)*gy;
+    }
+  }
+}
+
+}
+
+
+#endif /* ROVIO_PATCHINTERPOLATION_HPP_ */
@@ -0,0 +1,69 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_PODMATRIX_HPP_
+#define ROVIO_PODMATRIX_HPP_
+
+#include <Eigen/Core>
+
+namespace rovio{
+
+/** \brief Fixed size float matrix with plain array storage (column-major, as Eigen).
+ *
+ *  Unlike Eigen::Matrix, it is a trivially copyable, standard-layout type, such that classes holding it can be copied
+ *  with memcpy. Element access is provided directly, all linear algebra goes through the Eigen::Map returned by map().
+ *
+ *  @tparam rows - Number of rows.
+ *  @tparam cols - Number of columns.
+ */
+template<int rows, int cols>
+struct PodMatrix{
+  typedef Eigen::Matrix<float,rows,cols> mtEigen;
+  float data_[rows*cols];  /**<Matrix entries (column-major).*/
+
+  float& operator()(const int r, const int c){
+    return data_[c*rows+r];
+  }
+  const float& operator()(const int r, const int c) const{
+    return data_[c*rows+r];
+  }
+
+  /** \brief Returns an Eigen view onto the matrix.
+   */
+  Eigen::Map<mtEigen> map(){
+    return Eigen::Map<mtEigen>(data_);
+  }
+  Eigen::Map<const mtEigen> map() const{
+    return Eigen::Map<const mtEigen>(data_);
+  }
+};
+
+}
+
+
+#endif /* ROVIO_PODMATRIX_HPP_ */
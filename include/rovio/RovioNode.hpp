@@ -399,15 +399,14 @@ class RovioNode{
    */
   void imgCallback(const sensor_msgs::ImageConstPtr & img, const int camID = 0){
     // Get image from msg
-    cv_bridge::CvImagePtr cv_ptr;
+    cv_bridge::CvImageConstPtr cv_ptr;
     try {
-      cv_ptr = cv_bridge::toCvCopy(img, sensor_msgs::image_encodings::TYPE_8UC1);
+      cv_ptr = cv_bridge::toCvShare(img, sensor_msgs::image_encodings::TYPE_8UC1);
     } catch (cv_bridge::Exception& e) {
       ROS_ERROR("cv_bridge exception: %s", e.what());
       return;
     }
-    cv::Mat cv_img;
-    cv_ptr->image.copyTo(cv_img);
+    const cv::Mat& cv_img = cv_ptr->image; // Only valid during the callback, copied into the pooled pyramid buffers
     if(isInitialized_ && !cv_img.empty()){
       double msgTime = img->header.stamp.toSec();
       if(msgTime != imgUpdateMeas_.template get<mtImgMeas::_aux>().imgTime_){
@@ -418,7 +417,13 @@ class RovioNode{
         }
         imgUpdateMeas_.template get<mtImgMeas::_aux>().reset(msgTime);
       }
-      imgUpdateMeas_.template get<mtImgMeas::_aux>().pyr_[camID].computeFromImage(cv_img,true);
+      int minLevel, maxLevel;
+      mpImgUpdate_->getPyramidLevelRange(minLevel,maxLevel);
+      imgUpdateMeas_.template get<mtImgMeas::_aux>().pyr_[camID].computeFromImage(cv_img,!mpImgUpdate_->useBoxFilterPyramid_,
+                                                                               imgUpdateMeas_.template get<mtImgMeas::_aux>().pyrPool_[camID].get(),minLevel,maxLevel);
+      if(mpImgUpdate_->useGradientPyramid_){
+        imgUpdateMeas_.template get<mtImgMeas::_aux>().pyr_[camID].computeGradients(mpImgUpdate_->endLevel_,mpImgUpdate_->startLevel_);
+      }
       imgUpdateMeas_.template get<mtImgMeas::_aux>().isValidPyr_[camID] = true;
 
       if(imgUpdateMeas_.template get<mtImgMeas::_aux>().areAllValid()){
@@ -452,6 +457,7 @@ class RovioNode{
       static double timing_T = 0;
       static int timing_C = 0;
       const double oldSafeTime = mpFilter_->safe_.t_;
+      mpImgUpdate_->logAlignErrors_ = pubPatch_.getNumSubscribers() > 0;
       mpFilter_->updateSafe();
       const double t2 = (double) cv::getTickCount();
       int c2 = std::get<0>(mpFilter_->updateTimelineTuple_).measMap_.size();
@@ -460,6 +466,7 @@ class RovioNode{
       bool plotTiming = false;
       if(plotTiming){
         ROS_INFO_STREAM(" == Filter Update: " << (t2-t1)/cv::getTickFrequency()*1000 << " ms for processing " << c1-c2 << " images, average: " << timing_T/timing_C);
+        ROS_INFO_STREAM(" == Feature Detection: " << mpImgUpdate_->detectionMetrics_.detectionTime_ << " ms, average: " << mpImgUpdate_->detectionMetrics_.getAverageDetectionTime());
       }
       if(mpFilter_->safe_.t_ > oldSafeTime){ // Publish only if something changed
         for(int i=0;i<mtState::nCam_;i++){
@@ -644,7 +651,7 @@ class RovioNode{
           double d,d_minus,d_plus;
           const double stretchFactor = 3;
           for (unsigned int i=0;i<mtState::nMax_; i++, offset += pclMsg_.point_step) {
-            if(filterState.fsm_.isValid_[i]){
+            if(filterState.fsm_.isValid(i)){
               // Get 3D feature coordinates.
               int camID = filterState.fsm_.features_[i].mpCoordinates_->camID_;
               distance = state.dep(i);
@@ -737,16 +744,20 @@ class RovioNode{
           patchMsg_.header.stamp = ros::Time(mpFilter_->safe_.t_);
           int offset = 0;
           for (unsigned int i=0;i<mtState::nMax_; i++, offset += patchMsg_.point_step) {
-            if(filterState.fsm_.isValid_[i]){
+            if(filterState.fsm_.isValid(i)){
               memcpy(&patchMsg_.data[offset + patchMsg_.fields[0].offset], &filterState.fsm_.features_[i].idx_, sizeof(int));  // id
-              // Add patch data
+              // Add patch data (NaN for the levels which are not extracted, only the levels of the image update are)
+              const MultilevelPatch<mtState::nLevels_,mtState::patchSize_>& mp = *filterState.fsm_.features_[i].mpMultilevelPatch_;
+              const MultilevelPatch<mtState::nLevels_,mtState::patchSize_>& mpError = filterState.mlpErrorLog_[i];
+              const float badValue = std::numeric_limits<float>::quiet_NaN();
               for(int l=0;l<mtState::nLevels_;l++){
                 for(int y=0;y<mtState::patchSize_;y++){
                   for(int x=0;x<mtState::patchSize_;x++){
-                    memcpy(&patchMsg_.data[offset + patchMsg_.fields[1].offset + (l*mtState::patchSize_*mtState::patchSize_ + y*mtState::patchSize_ + x)*4], &filterState.fsm_.features_[i].mpMultilevelPatch_->patches_[l].patch_[y*mtState::patchSize_ + x], sizeof(float)); // Patch
-                    memcpy(&patchMsg_.data[offset + patchMsg_.fields[2].offset + (l*mtState::patchSize_*mtState::patchSize_ + y*mtState::patchSize_ + x)*4], &filterState.fsm_.features_[i].mpMultilevelPatch_->patches_[l].dx_[y*mtState::patchSize_ + x], sizeof(float)); // dx
-                    memcpy(&patchMsg_.data[offset + patchMsg_.fields[3].offset + (l*mtState::patchSize_*mtState::patchSize_ + y*mtState::patchSize_ + x)*4], &filterState.fsm_.features_[i].mpMultilevelPatch_->patches_[l].dy_[y*mtState::patchSize_ + x], sizeof(float)); // dy
-                    memcpy(&patchMsg_.data[offset + patchMsg_.fields[4].offset + (l*mtState::patchSize_*mtState::patchSize_ + y*mtState::patchSize_ + x)*4], &filterState.mlpErrorLog_[i].patches_[l].patch_[y*mtState::patchSize_ + x], sizeof(float)); // error
+                    const int j = y*mtState::patchSize_ + x;
+                    memcpy(&patchMsg_.data[offset + patchMsg_.fields[1].offset + (l*mtState::patchSize_*mtState::patchSize_ + j)*4], mp.isValidPatch_[l] ? &mp.patches_[l].patch_[j] : &badValue, sizeof(float)); // Patch
+                    memcpy(&patchMsg_.data[offset + patchMsg_.fields[2].offset + (l*mtState::patchSize_*mtState::patchSize_ + j)*4], mp.isValidPatch_[l] ? &mp.patches_[l].dx_[j] : &badValue, sizeof(float)); // dx
+                    memcpy(&patchMsg_.data[offset + patchMsg_.fields[3].offset + (l*mtState::patchSize_*mtState::patchSize_ + j)*4], mp.isValidPatch_[l] ? &mp.patches_[l].dy_[j] : &badValue, sizeof(float)); // dy
+                    memcpy(&patchMsg_.data[offset + patchMsg_.fields[4].offset + (l*mtState::patchSize_*mtState::patchSize_ + j)*4], mpError.isValidPatch_[l] ? &mpError.patches_[l].patch_[j] : &badValue, sizeof(float)); // error
                   }
                 }
               }
@@ -141,7 +141,7 @@ class RovioScene{
       double d_far,d_near;
       const float s = pow(2.0,mtState::nLevels_-1)*0.5*mtState::patchSize_;
       for(unsigned int i=0;i<mtState::nMax_;i++){
-        if(filterState.fsm_.isValid_[i] && filterState.fsm_.features_[i].mpCoordinates_->camID_ == camID){
+        if(filterState.fsm_.isValid(i) && filterState.fsm_.features_[i].mpCoordinates_->camID_ == camID){
           mpPatches_[i]->draw_ = true;
           d = state.dep(i);
           const double sigma = cov(mtState::template getId<mtState::_fea>(i)+2,mtState::template getId<mtState::_fea>(i)+2);
@@ -199,7 +199,7 @@ class RovioScene{
 
           mpPatches_[i]->clear();
           mpPatches_[i]->makeTexturedRectangle(1.0f,1.0f);
-          filterState.fsm_.features_[i].mpMultilevelPatch_->drawMultilevelPatch(patch_,cv::Point2i(0,0),1,false);
+          drawMultilevelPatch(patch_,*filterState.fsm_.features_[i].mpMultilevelPatch_,cv::Point2i(0,0),1,false);
           mpPatches_[i]->setTexture(patch_);
           for(int x=0;x<2;x++){
             for(int y=0;y<2;y++){
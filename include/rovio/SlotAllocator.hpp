@@ -0,0 +1,155 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_SLOTALLOCATOR_HPP_
+#define ROVIO_SLOTALLOCATOR_HPP_
+
+#include <cstdint>
+
+namespace rovio{
+
+/** \brief Bitset of the occupied slots of a fixed size array.
+ *
+ *  A free slot is found by scanning the complement of the bitset word-wise (always the lowest free slot is returned),
+ *  the number of occupied slots by popcount. Both cost O(nSlots/64) instead of O(nSlots).
+ *
+ *  @tparam nSlots - Number of slots.
+ */
+template<int nSlots>
+class SlotAllocator{
+ public:
+  static constexpr int nWords_ = (nSlots+63)/64;  /**<Number of 64 bit words.*/
+
+  /** \brief Iterator over the occupied slots (in increasing order). The slot the iterator points at may be released
+   *         while iterating, other slots must not be changed.
+   */
+  class Iterator{
+   public:
+    Iterator(const SlotAllocator* mpAllocator, const int wordIdx): mpAllocator_(mpAllocator), wordIdx_(wordIdx), word_(0){
+      if(wordIdx_ < nWords_) word_ = mpAllocator_->words_[wordIdx_];
+      advance();
+    }
+    int operator*() const{
+      return wordIdx_*64+__builtin_ctzll(word_);
+    }
+    Iterator& operator++(){
+      word_ &= word_-1;
+      advance();
+      return *this;
+    }
+    bool operator!=(const Iterator& other) const{
+      return wordIdx_ != other.wordIdx_ || word_ != other.word_;
+    }
+   private:
+    /** \brief Moves to the next word with an occupied slot, if the current one is exhausted.
+     */
+    void advance(){
+      while(word_ == 0 && wordIdx_ < nWords_){
+        ++wordIdx_;
+        if(wordIdx_ < nWords_) word_ = mpAllocator_->words_[wordIdx_];
+      }
+    }
+    const SlotAllocator* mpAllocator_;
+    int wordIdx_;
+    uint64_t word_;  /**<Remaining occupied slots of the current word.*/
+  };
+
+  /** \brief Constructor, all slots are free.
+   */
+  SlotAllocator(){
+    reset();
+  }
+
+  /** \brief Frees all slots.
+   */
+  void reset(){
+    for(int w=0;w<nWords_;w++){
+      words_[w] = 0;
+    }
+  }
+
+  /** \brief Is slot i occupied?
+   */
+  bool isOccupied(const int i) const{
+    return (words_[i >> 6] >> (i & 63)) & 1;
+  }
+
+  /** \brief Marks slot i as occupied.
+   */
+  void occupy(const int i){
+    words_[i >> 6] |= uint64_t(1) << (i & 63);
+  }
+
+  /** \brief Marks slot i as free.
+   */
+  void release(const int i){
+    words_[i >> 6] &= ~(uint64_t(1) << (i & 63));
+  }
+
+  /** \brief Finds the lowest free slot.
+   *
+   * @param i - Index of the free slot.
+   * @return true, if a free slot was found.
+   */
+  bool getFree(int& i) const{
+    for(int w=0;w<nWords_;w++){
+      const uint64_t freeBits = ~words_[w];
+      if(freeBits != 0){
+        i = w*64+__builtin_ctzll(freeBits);
+        return i < nSlots;
+      }
+    }
+    return false;
+  }
+
+  /** \brief Returns the number of occupied slots.
+   */
+  int count() const{
+    int n = 0;
+    for(int w=0;w<nWords_;w++){
+      n += __builtin_popcountll(words_[w]);
+    }
+    return n;
+  }
+
+  Iterator begin() const{
+    return Iterator(this,0);
+  }
+
+  Iterator end() const{
+    return Iterator(this,nWords_);
+  }
+
+ private:
+  uint64_t words_[nWords_];  /**<Occupancy bits, bit (i & 63) of word (i >> 6) belongs to slot i.*/
+};
+
+}
+
+
+#endif /* ROVIO_SLOTALLOCATOR_HPP_ */
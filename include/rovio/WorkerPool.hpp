@@ -0,0 +1,157 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#ifndef ROVIO_WORKERPOOL_HPP_
+#define ROVIO_WORKERPOOL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rovio{
+
+/** \brief Fixed-size pool of worker threads for data-parallel loops.
+ *
+ *  The calling thread participates as worker 0, such that a pool of size n owns n-1 background threads. A pool of size 1
+ *  executes everything on the calling thread. parallelFor() must not be called concurrently or recursively on the same pool.
+ */
+class WorkerPool{
+ public:
+  /** \brief Constructor
+   *
+   * @param nWorkers - Number of workers, including the calling thread (values < 1 are treated as 1).
+   */
+  explicit WorkerPool(const int nWorkers): nWorkers_(std::max(nWorkers,1)), job_(nullptr), nJobs_(0), nextJob_(0), nActive_(0), generation_(0), stop_(false){
+    for(int i=1;i<nWorkers_;i++){
+      threads_.emplace_back(&WorkerPool::workerLoop,this,i);
+    }
+  }
+
+  /** \brief Destructor, joins all background threads.
+   */
+  ~WorkerPool(){
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cvStart_.notify_all();
+    for(auto& t : threads_){
+      t.join();
+    }
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  /** \brief Returns the number of workers (including the calling thread).
+   */
+  int size() const{
+    return nWorkers_;
+  }
+
+  /** \brief Executes job(i,workerId) for all i in [0,n). Indices are handed out in increasing order, each index is executed
+   *         exactly once. Blocks until all jobs are finished.
+   *
+   * @param n   - Number of jobs.
+   * @param job - Job, called with the job index and the id of the executing worker (in [0,size())).
+   */
+  void parallelFor(const int n, const std::function<void(const int, const int)>& job){
+    if(nWorkers_ == 1 || n <= 1){
+      for(int i=0;i<n;i++){
+        job(i,0);
+      }
+      return;
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      job_ = &job;
+      nJobs_ = n;
+      nextJob_ = 0;
+      nActive_ = nWorkers_-1;
+      generation_++;
+    }
+    cvStart_.notify_all();
+    runJobs(0);
+    std::unique_lock<std::mutex> lock(mutex_);
+    cvDone_.wait(lock,[this]{return nActive_ == 0;});
+    job_ = nullptr;
+  }
+
+ private:
+  /** \brief Main loop of the background workers.
+   *
+   * @param workerId - Id of the worker.
+   */
+  void workerLoop(const int workerId){
+    unsigned long generation = 0;
+    while(true){
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cvStart_.wait(lock,[this,generation]{return stop_ || generation_ != generation;});
+        if(stop_) return;
+        generation = generation_;
+      }
+      runJobs(workerId);
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(--nActive_ == 0) cvDone_.notify_one();
+      }
+    }
+  }
+
+  /** \brief Executes jobs of the current parallelFor() until none is left.
+   *
+   * @param workerId - Id of the worker.
+   */
+  void runJobs(const int workerId){
+    for(int i = nextJob_++; i < nJobs_; i = nextJob_++){
+      (*job_)(i,workerId);
+    }
+  }
+
+  const int nWorkers_;  /**<Number of workers, including the calling thread.*/
+  std::vector<std::thread> threads_;  /**<Background threads.*/
+  const std::function<void(const int, const int)>* job_;  /**<Job of the current parallelFor().*/
+  int nJobs_;  /**<Number of jobs of the current parallelFor().*/
+  std::atomic<int> nextJob_;  /**<Next job index to be handed out.*/
+  int nActive_;  /**<Number of background workers still busy with the current parallelFor().*/
+  unsigned long generation_;  /**<Incremented for every parallelFor(), wakes up the background workers.*/
+  bool stop_;  /**<Set on destruction.*/
+  std::mutex mutex_;
+  std::condition_variable cvStart_;
+  std::condition_variable cvDone_;
+};
+
+}
+
+
+#endif /* ROVIO_WORKERPOOL_HPP_ */
@@ -115,7 +115,7 @@ class FeatureTrackerNode{
       ROS_ERROR("cv_bridge exception: %s", e.what());
       return;
     }
-    cv_ptr->image.copyTo(img_);
+    img_ = cv_ptr->image; // Fresh buffer of toCvCopy, can be shared with the pyramid
 
     // Timing
     static double last_time = 0.0;
@@ -131,64 +131,60 @@ class FeatureTrackerNode{
 
     // Prediction
     cv::Point2f dc;
-    for(unsigned int i=0;i<nMax_;i++){
-      if(fsm_.isValid_[i]){
-        dc = 0.75*(fsm_.features_[i].mpCoordinates_->get_c() - fsm_.features_[i].log_previous_.get_c());
-        fsm_.features_[i].log_previous_ = *(fsm_.features_[i].mpCoordinates_);
-        fsm_.features_[i].mpCoordinates_->set_c(fsm_.features_[i].mpCoordinates_->get_c() + dc);
-        if(!fsm_.features_[i].mpMultilevelPatch_->isMultilevelPatchInFrame(pyr_,*(fsm_.features_[i].mpCoordinates_),nLevels_-1,false)){
-          fsm_.features_[i].mpCoordinates_->set_c(fsm_.features_[i].log_previous_.get_c());
-        }
-        fsm_.features_[i].mpStatistics_->increaseStatistics(current_time);
-        for(int j=0;j<nCam_;j++){
-          fsm_.features_[i].mpStatistics_->status_[j] = UNKNOWN;
-        }
+    for(const int i : fsm_.validSlots_){
+      dc = 0.75*(fsm_.features_[i].mpCoordinates_->get_c() - fsm_.features_[i].log_previous_.get_c());
+      fsm_.features_[i].log_previous_ = *(fsm_.features_[i].mpCoordinates_);
+      fsm_.features_[i].mpCoordinates_->set_c(fsm_.features_[i].mpCoordinates_->get_c() + dc);
+      if(!fsm_.features_[i].mpMultilevelPatch_->isMultilevelPatchInFrame(pyr_,*(fsm_.features_[i].mpCoordinates_),nLevels_-1,false)){
+        fsm_.features_[i].mpCoordinates_->set_c(fsm_.features_[i].log_previous_.get_c());
+      }
+      fsm_.features_[i].mpStatistics_->increaseStatistics(current_time);
+      for(int j=0;j<nCam_;j++){
+        fsm_.features_[i].mpStatistics_->status_[j] = UNKNOWN;
       }
     }
 
     // Track valid features
     FeatureCoordinates alignedCoordinates;
     const double t1 = (double) cv::getTickCount();
-    for(unsigned int i=0;i<nMax_;i++){
-      if(fsm_.isValid_[i]){
-        fsm_.features_[i].log_prediction_ = *(fsm_.features_[i].mpCoordinates_);
-        if(alignment_.align2DComposed(alignedCoordinates,pyr_,*fsm_.features_[i].mpMultilevelPatch_,*fsm_.features_[i].mpCoordinates_,l2,l1,l1)){
-          fsm_.features_[i].mpStatistics_->status_[0] = TRACKED;
-          fsm_.features_[i].mpCoordinates_->set_c(alignedCoordinates.get_c());
-          fsm_.features_[i].log_previous_ = *(fsm_.features_[i].mpCoordinates_);
-          fsm_.features_[i].mpCoordinates_->drawPoint(draw_image_,cv::Scalar(0,255,255));
-          fsm_.features_[i].mpCoordinates_->drawLine(draw_image_,fsm_.features_[i].log_prediction_,cv::Scalar(0,255,255));
-          fsm_.features_[i].mpCoordinates_->drawText(draw_image_,std::to_string(i),cv::Scalar(0,255,255));
-          if(i==18){
-            for(int j=0;j<nLevels_;j++){
+    for(const int i : fsm_.validSlots_){
+      fsm_.features_[i].log_prediction_ = *(fsm_.features_[i].mpCoordinates_);
+      if(alignment_.align2DComposed(alignedCoordinates,pyr_,*fsm_.features_[i].mpMultilevelPatch_,*fsm_.features_[i].mpCoordinates_,l2,l1,l1)){
+        fsm_.features_[i].mpStatistics_->status_[0] = TRACKED;
+        fsm_.features_[i].mpCoordinates_->set_c(alignedCoordinates.get_c());
+        fsm_.features_[i].log_previous_ = *(fsm_.features_[i].mpCoordinates_);
+        fsm_.features_[i].mpCoordinates_->drawPoint(draw_image_,cv::Scalar(0,255,255));
+        fsm_.features_[i].mpCoordinates_->drawLine(draw_image_,fsm_.features_[i].log_prediction_,cv::Scalar(0,255,255));
+        fsm_.features_[i].mpCoordinates_->drawText(draw_image_,std::to_string(i),cv::Scalar(0,255,255));
+        if(i==18){
+          for(int j=0;j<nLevels_;j++){
 //              std::cout << fsm_.features_[i].mpMultilevelPatch_->isValidPatch_[j] << std::endl;
 //              std::cout << fsm_.features_[i].mpMultilevelPatch_->patches_[j].dx_[0] << std::endl;
-            }
+          }
 //            std::cout << alignment_.A_.transpose() << std::endl;
 //            std::cout << alignment_.b_.transpose() << std::endl;
-          }
-
-        } else {
-          fsm_.features_[i].mpStatistics_->status_[0] = FAILED_ALIGNEMENT;
-          fsm_.features_[i].mpCoordinates_->drawPoint(draw_image_,cv::Scalar(0,0,255));
-          fsm_.features_[i].mpCoordinates_->drawText(draw_image_,std::to_string(fsm_.features_[i].idx_),cv::Scalar(0,0,255));
         }
+
+      } else {
+        fsm_.features_[i].mpStatistics_->status_[0] = FAILED_ALIGNEMENT;
+        fsm_.features_[i].mpCoordinates_->drawPoint(draw_image_,cv::Scalar(0,0,255));
+        fsm_.features_[i].mpCoordinates_->drawText(draw_image_,std::to_string(fsm_.features_[i].idx_),cv::Scalar(0,0,255));
       }
     }
     const double t2 = (double) cv::getTickCount();
     ROS_INFO_STREAM(" Matching " << fsm_.getValidCount() << " patches (" << (t2-t1)/cv::getTickFrequency()*1000 << " ms)");
     MultilevelPatch<nLevels_,patchSize_> mp;
     for(unsigned int i=0;i<numPatchesPlot;i++){
-      if(fsm_.isValid_[i+10]){
-        fsm_.features_[i+10].mpMultilevelPatch_->drawMultilevelPatch(draw_patches_,cv::Point2i(2,2+i*(patchSize_*pow(2,nLevels_-1)+4)),1,false);
+      if(fsm_.isValid(i+10)){
+        drawMultilevelPatch(draw_patches_,*fsm_.features_[i+10].mpMultilevelPatch_,cv::Point2i(2,2+i*(patchSize_*pow(2,nLevels_-1)+4)),1,false);
         if(mp.isMultilevelPatchInFrame(pyr_,fsm_.features_[i+10].log_prediction_,nLevels_-1,false)){
           mp.extractMultilevelPatchFromImage(pyr_,fsm_.features_[i+10].log_prediction_,nLevels_-1,false);
-          mp.drawMultilevelPatch(draw_patches_,cv::Point2i(patchSize_*pow(2,nLevels_-1)+6,2+i*(patchSize_*pow(2,nLevels_-1)+4)),1,false);
+          drawMultilevelPatch(draw_patches_,mp,cv::Point2i(patchSize_*pow(2,nLevels_-1)+6,2+i*(patchSize_*pow(2,nLevels_-1)+4)),1,false);
         }
         if(fsm_.features_[i+10].mpStatistics_->status_[0] == TRACKED
             && mp.isMultilevelPatchInFrame(pyr_,*fsm_.features_[i+10].mpCoordinates_,nLevels_-1,false)){
           mp.extractMultilevelPatchFromImage(pyr_,*fsm_.features_[i+10].mpCoordinates_,nLevels_-1,false);
-          mp.drawMultilevelPatch(draw_patches_,cv::Point2i(2*patchSize_*pow(2,nLevels_-1)+10,2+i*(patchSize_*pow(2,nLevels_-1)+4)),1,false);
+          drawMultilevelPatch(draw_patches_,mp,cv::Point2i(2*patchSize_*pow(2,nLevels_-1)+10,2+i*(patchSize_*pow(2,nLevels_-1)+4)),1,false);
           cv::rectangle(draw_patches_,cv::Point2i(0,i*(patchSize_*pow(2,nLevels_-1)+4)),cv::Point2i(patchSize_*pow(2,nLevels_-1)+3,(i+1)*(patchSize_*pow(2,nLevels_-1)+4)-1),cv::Scalar(255),2,8,0);
           cv::rectangle(draw_patches_,cv::Point2i(patchSize_*pow(2,nLevels_-1)+4,i*(patchSize_*pow(2,nLevels_-1)+4)),cv::Point2i(2*patchSize_*pow(2,nLevels_-1)+7,(i+1)*(patchSize_*pow(2,nLevels_-1)+4)-1),cv::Scalar(255),2,8,0);
         } else {
@@ -204,12 +200,10 @@ class FeatureTrackerNode{
     // If a bad quality of a MultilevelPatchFeature is recognized, it is set to invalid. New MultilevelPatchFeature%s
     // replace the array places of invalid MultilevelPatchFeature%s in the MultilevelPatchSet.
     int prune_count = 0;
-    for(unsigned int i=0;i<nMax_;i++){
-      if(fsm_.isValid_[i]){
-        if(fsm_.features_[i].mpStatistics_->status_[0] == FAILED_ALIGNEMENT){
-          fsm_.isValid_[i] = false;
-          prune_count++;
-        }
+    for(const int i : fsm_.validSlots_){
+      if(fsm_.features_[i].mpStatistics_->status_[0] == FAILED_ALIGNEMENT){
+        fsm_.removeFeature(i);
+        prune_count++;
       }
     }
     ROS_INFO_STREAM(" Pruned " << prune_count << " features");
@@ -217,12 +211,10 @@ class FeatureTrackerNode{
     // Extract feature patches
     // Extract new MultilevelPatchFeature%s at the current tracked feature positions.
     // Extracted multilevel patches are aligned with the image axes.
-    for(unsigned int i=0;i<nMax_;i++){
-      if(fsm_.isValid_[i]){
-        if(fsm_.features_[i].mpStatistics_->status_[0] == TRACKED
-            && fsm_.features_[i].mpMultilevelPatch_->isMultilevelPatchInFrame(pyr_,*fsm_.features_[i].mpCoordinates_,nLevels_-1,true)){
-          fsm_.features_[i].mpMultilevelPatch_->extractMultilevelPatchFromImage(pyr_,*fsm_.features_[i].mpCoordinates_,nLevels_-1,true);
-        }
+    for(const int i : fsm_.validSlots_){
+      if(fsm_.features_[i].mpStatistics_->status_[0] == TRACKED
+          && fsm_.features_[i].mpMultilevelPatch_->isMultilevelPatchInFrame(pyr_,*fsm_.features_[i].mpCoordinates_,nLevels_-1,true)){
+        fsm_.features_[i].mpMultilevelPatch_->extractMultilevelPatchFromImage(pyr_,*fsm_.features_[i].mpCoordinates_,nLevels_-1,true);
       }
     }
 
@@ -180,21 +180,16 @@ namespace rovio{
 
   void FeatureCoordinates::setPixelCov(const Eigen::Matrix2d& cov){
     pixelCov_ = cov;
-    es_.compute(cov);
-    sigmaAngle_ = std::atan2(es_.eigenvectors()(1,0).real(),es_.eigenvectors()(0,0).real());
-    sigma1_ = sqrt(es_.eigenvalues()(0).real());
-    sigma2_ = sqrt(es_.eigenvalues()(1).real());
-    if(sigma1_<sigma2_){ // Get larger axis on index 1
-      const double temp = sigma1_;
-      sigma1_ = sigma2_;
-      sigma2_ = temp;
-      sigmaAngle_ += 0.5*M_PI;
-      eigenVector1_ = es_.eigenvectors().col(1).real();
-      eigenVector2_ = es_.eigenvectors().col(0).real();
-    } else {
-      eigenVector1_ = es_.eigenvectors().col(0).real();
-      eigenVector2_ = es_.eigenvectors().col(1).real();
-    }
+    // Closed form eigen decomposition of the symmetric 2x2 covariance (larger axis on index 1)
+    const double mean = 0.5*(cov(0,0)+cov(1,1));
+    const double halfDiff = 0.5*(cov(0,0)-cov(1,1));
+    const double offDiag = 0.5*(cov(0,1)+cov(1,0));
+    const double radius = std::sqrt(halfDiff*halfDiff+offDiag*offDiag);
+    sigmaAngle_ = 0.5*std::atan2(2.0*offDiag,2.0*halfDiff);
+    sigma1_ = std::sqrt(std::max(mean+radius,0.0));
+    sigma2_ = std::sqrt(std::max(mean-radius,0.0));
+    eigenVector1_ << std::cos(sigmaAngle_), std::sin(sigmaAngle_);
+    eigenVector2_ << -eigenVector1_(1), eigenVector1_(0);
   }
 
   void FeatureCoordinates::drawPoint(cv::Mat& drawImg, const cv::Scalar& color) const{
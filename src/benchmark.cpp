@@ -0,0 +1,336 @@
+/*
+* Copyright (c) 2014, Autonomous Systems Lab
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* * Redistributions of source code must retain the above copyright
+* notice, this list of conditions and the following disclaimer.
+* * Redistributions in binary form must reproduce the above copyright
+* notice, this list of conditions and the following disclaimer in the
+* documentation and/or other materials provided with the distribution.
+* * Neither the name of the Autonomous Systems Lab, ETH Zurich nor the
+* names of its contributors may be used to endorse or promote products
+* derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "rovio/CandidateSelector.hpp"
+#include "rovio/FeatureArena.hpp"
+#include "rovio/ImagePyramid.hpp"
+#include "rovio/Patch.hpp"
+
+using namespace rovio;
+
+namespace {
+
+/** \brief Returns the name of an interpolation kernel.
+ */
+std::string kernelName(const InterpolationKernel kernel){
+  switch(kernel){
+    case KERNEL_SSE2: return "sse2";
+    case KERNEL_AVX2: return "avx2";
+    default: return "scalar";
+  }
+}
+
+/** \brief Prints a single benchmark result line.
+ *
+ *   @param name  - Name of the benchmark case.
+ *   @param ns    - Total runtime in nanoseconds.
+ *   @param count - Number of evaluations.
+ */
+void printResult(const std::string& name, const double ns, const int count){
+  std::cout << "  " << std::left << std::setw(40) << name << std::right << std::setw(12) << std::fixed << std::setprecision(1)
+            << ns/count << " ns/call" << std::endl;
+}
+
+/** \brief Benchmarks the warped patch interpolation (scalar reference vs SIMD kernels).
+ *
+ *   @tparam N - Edge length of the patch.
+ */
+template<int N>
+void benchmarkWarpedPatchExtraction(const cv::Mat& img, const int nPatches, const int nRepetitions){
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> distX(30,img.cols-30);
+  std::uniform_real_distribution<float> distY(30,img.rows-30);
+  std::uniform_real_distribution<float> distAngle(-M_PI,M_PI);
+  std::uniform_real_distribution<float> distScale(0.7,1.4);
+  std::vector<float> cx(nPatches), cy(nPatches);
+  std::vector<Eigen::Matrix2f,Eigen::aligned_allocator<Eigen::Matrix2f>> warps(nPatches);
+  for(int i=0;i<nPatches;i++){
+    cx[i] = distX(gen);
+    cy[i] = distY(gen);
+    const float a = distAngle(gen);
+    const float s = distScale(gen);
+    warps[i] << s*cos(a), -s*sin(a), s*sin(a), s*cos(a);
+  }
+  float patch[N*N] __attribute__ ((aligned (16)));
+  volatile float sink = 0;
+  const InterpolationKernel kernels[3] = {KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2};
+  for(unsigned int k=0;k<3;k++){
+    if(!isInterpolationKernelSupported(kernels[k])) continue;
+    const auto start = std::chrono::steady_clock::now();
+    for(int r=0;r<nRepetitions;r++){
+      for(int i=0;i<nPatches;i++){
+        interpolateWarpedPatch<N>(img.data,img.step.p[0],img.cols,img.rows,cx[i],cy[i],warps[i],patch,kernels[k]);
+        sink = patch[N*N-1];
+      }
+    }
+    const auto end = std::chrono::steady_clock::now();
+    printResult("warped patch " + std::to_string(N) + "x" + std::to_string(N) + " (" + kernelName(kernels[k]) + ")",
+                std::chrono::duration<double,std::nano>(end-start).count(),nRepetitions*nPatches);
+  }
+  (void)sink;
+}
+
+/** \brief Benchmarks the image pyramid construction (cv::pyrDown vs box filter with the different kernels).
+ *
+ *   @param img          - Input image (level 0).
+ *   @param nRepetitions - Number of pyramid constructions per mode.
+ */
+void benchmarkPyramidConstruction(const cv::Mat& img, const int nRepetitions){
+  ImagePyramid<4> pyr;
+  const std::string size = std::to_string(img.cols) + "x" + std::to_string(img.rows);
+  auto start = std::chrono::steady_clock::now();
+  for(int r=0;r<nRepetitions;r++){
+    pyr.computeFromImage(img,true);
+  }
+  auto end = std::chrono::steady_clock::now();
+  printResult("pyramid " + size + " (cv::pyrDown)",std::chrono::duration<double,std::nano>(end-start).count(),nRepetitions);
+  const InterpolationKernel activeKernel = activeInterpolationKernel();
+  const InterpolationKernel kernels[3] = {KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2};
+  for(unsigned int k=0;k<3;k++){
+    if(!isInterpolationKernelSupported(kernels[k])) continue;
+    activeInterpolationKernel() = kernels[k];
+    start = std::chrono::steady_clock::now();
+    for(int r=0;r<nRepetitions;r++){
+      pyr.computeFromImage(img,false);
+    }
+    end = std::chrono::steady_clock::now();
+    printResult("pyramid " + size + " (box, " + kernelName(kernels[k]) + ")",std::chrono::duration<double,std::nano>(end-start).count(),nRepetitions);
+  }
+  activeInterpolationKernel() = activeKernel;
+}
+
+/** \brief Previous candidate selection of FeatureSetManager::addBestCandidates() with one hash set per bucket (reference for
+ *         benchmarkCandidateSelection()).
+ */
+int selectWithHashBuckets(const std::vector<cv::Point2f>& pixels, const std::vector<float>& scores, const float minScore, const float maxScore,
+                          const std::vector<cv::Point2f>& existingPixels, const int maxCount, const int nDetectionBuckets, const double scoreDetectionExponent,
+                          const double penaltyDistance, const double zeroDistancePenalty){
+  std::vector<std::unordered_set<int>> buckets(nDetectionBuckets,std::unordered_set<int>());
+  for(int i=0;i<pixels.size();i++){
+    const float relScore = (scores[i]-minScore)/(maxScore-minScore);
+    if(relScore > 0.0){
+      buckets[std::min((int)std::ceil((nDetectionBuckets-1)*(pow(relScore,static_cast<float>(scoreDetectionExponent)))),nDetectionBuckets-1)].insert(i);
+    }
+  }
+  const double t2 = pow(penaltyDistance,2);
+  auto penalize = [&](const cv::Point2f& p, const int maxBucket){
+    for(int bucketID = 1;bucketID <= maxBucket;bucketID++){
+      for(auto it_cand = buckets[bucketID].begin();it_cand != buckets[bucketID].end();){
+        const double d2 = std::pow(p.x - pixels[*it_cand].x,2) + std::pow(p.y - pixels[*it_cand].y,2);
+        const int newBucketID = std::max((int)(bucketID - (t2-d2)/t2*zeroDistancePenalty),0);
+        if(d2<t2 && newBucketID != bucketID){
+          buckets[newBucketID].insert(*it_cand);
+          buckets[bucketID].erase(it_cand++);
+        } else {
+          ++it_cand;
+        }
+      }
+    }
+  };
+  for(const cv::Point2f& p : existingPixels){
+    penalize(p,nDetectionBuckets-1);
+  }
+  int count = 0;
+  for(int bucketID = nDetectionBuckets-1;bucketID >= 1;bucketID--){
+    while(!buckets[bucketID].empty() && count < maxCount){
+      const int nf = *(buckets[bucketID].begin());
+      buckets[bucketID].erase(nf);
+      count++;
+      penalize(pixels[nf],bucketID);
+    }
+  }
+  return count;
+}
+
+/** \brief Benchmarks the bucket selection of new feature candidates (hash set buckets vs CandidateSelector).
+ *
+ *   @param nCandidates  - Number of candidates.
+ *   @param nRepetitions - Number of selections per mode.
+ */
+void benchmarkCandidateSelection(const int nCandidates, const int nRepetitions){
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> distX(0,752);
+  std::uniform_real_distribution<float> distY(0,480);
+  std::uniform_real_distribution<float> distScore(0,100);
+  std::vector<cv::Point2f> pixels(nCandidates);
+  std::vector<float> scores(nCandidates);
+  for(int i=0;i<nCandidates;i++){
+    pixels[i] = cv::Point2f(distX(gen),distY(gen));
+    scores[i] = distScore(gen);
+  }
+  std::vector<cv::Point2f> existingPixels(15);
+  for(auto& p : existingPixels){
+    p = cv::Point2f(distX(gen),distY(gen));
+  }
+  // Parameters of cfg/rovio.info
+  const int maxCount = 10;
+  const int nDetectionBuckets = 100;
+  const double scoreDetectionExponent = 0.25;
+  const double penaltyDistance = 100;
+  const double zeroDistancePenalty = 100;
+  volatile int sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for(int r=0;r<nRepetitions;r++){
+    sink = selectWithHashBuckets(pixels,scores,5.0,100.0,existingPixels,maxCount,nDetectionBuckets,scoreDetectionExponent,penaltyDistance,zeroDistancePenalty);
+  }
+  auto end = std::chrono::steady_clock::now();
+  printResult(std::to_string(nCandidates) + " candidates (hash buckets)",std::chrono::duration<double,std::nano>(end-start).count(),nRepetitions);
+  CandidateSelector selector;
+  std::vector<int> selected;
+  start = std::chrono::steady_clock::now();
+  for(int r=0;r<nRepetitions;r++){
+    selector.select(pixels,scores,5.0,100.0,existingPixels,maxCount,nDetectionBuckets,scoreDetectionExponent,penaltyDistance,zeroDistancePenalty,false,selected);
+    sink = selected.size();
+  }
+  end = std::chrono::steady_clock::now();
+  printResult(std::to_string(nCandidates) + " candidates (grid)",std::chrono::duration<double,std::nano>(end-start).count(),nRepetitions);
+  (void)sink;
+}
+
+/** \brief Per-frame pass over the features, as done in the pre- and post-processing of the image update (status, score and
+ *         level 0 patch of every valid feature).
+ */
+template<int nLevels,int patchSize,int nCam>
+float visitFeatures(const std::vector<MultilevelPatch<nLevels,patchSize>*>& patches, const std::vector<FeatureStatistics<nCam>*>& statistics){
+  float sum = 0.0f;
+  for(unsigned int i=0;i<patches.size();i++){
+    if(statistics[i]->status_[0] == TRACKED || !patches[i]->isValidPatch_[0]) continue;
+    sum += patches[i]->s_;
+    const float* it = patches[i]->patches_[0].patch_;
+    for(int j=0;j<patchSize*patchSize;j++){
+      sum += it[j];
+    }
+  }
+  return sum;
+}
+
+/** \brief Benchmarks the per-frame feature loop for individually heap allocated feature objects vs the FeatureArena.
+ *
+ *   The cache is flushed between two frames, as the detection and alignment of a frame evict the feature data.
+ *
+ *   @tparam nMax        - Number of features.
+ *   @param nRepetitions - Number of frames per mode.
+ */
+template<int nMax>
+void benchmarkFeatureStorage(const int nRepetitions){
+  typedef MultilevelPatch<4,8> mtPatch;
+  typedef FeatureStatistics<1> mtStatistics;
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> distJunk(16,4096);
+  std::vector<char> flush(16*1024*1024);
+
+  // Individually allocated, interleaved with other allocations (as on a long running heap)
+  std::vector<std::unique_ptr<mtPatch>> scatteredPatches;
+  std::vector<std::unique_ptr<mtStatistics>> scatteredStatistics;
+  std::vector<std::unique_ptr<char[]>> junk;
+  for(int i=0;i<nMax;i++){
+    junk.emplace_back(new char[distJunk(gen)]);
+    scatteredPatches.emplace_back(new mtPatch());
+    junk.emplace_back(new char[distJunk(gen)]);
+    scatteredStatistics.emplace_back(new mtStatistics());
+  }
+  std::shuffle(scatteredPatches.begin(),scatteredPatches.end(),gen);
+  std::shuffle(scatteredStatistics.begin(),scatteredStatistics.end(),gen);
+  FeatureArena<4,8,1,nMax> arena;
+
+  std::vector<mtPatch*> patches[2];
+  std::vector<mtStatistics*> statistics[2];
+  for(int i=0;i<nMax;i++){
+    patches[0].push_back(scatteredPatches[i].get());
+    statistics[0].push_back(scatteredStatistics[i].get());
+    patches[1].push_back(&arena.multilevelPatch(i));
+    statistics[1].push_back(&arena.statistics(i));
+  }
+  const std::string modes[2] = {"heap","arena"};
+  volatile float sink = 0.0f;
+  for(int m=0;m<2;m++){
+    for(int i=0;i<nMax;i++){
+      patches[m][i]->isValidPatch_[0] = true;
+      patches[m][i]->s_ = i;
+    }
+    double ns = 0.0;
+    for(int r=0;r<nRepetitions;r++){
+      for(unsigned int j=0;j<flush.size();j+=64){
+        flush[j] += r;
+      }
+      auto start = std::chrono::steady_clock::now();
+      sink = visitFeatures(patches[m],statistics[m]);
+      auto end = std::chrono::steady_clock::now();
+      ns += std::chrono::duration<double,std::nano>(end-start).count();
+    }
+    printResult(std::to_string(nMax) + " features (" + modes[m] + ")",ns,nRepetitions);
+  }
+  (void)sink;
+}
+
+/** \brief Returns an image filled with uniformly distributed random intensities.
+ */
+cv::Mat randomImage(const int rows, const int cols){
+  cv::Mat img(rows,cols,CV_8UC1);
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> distIntensity(0,255);
+  for(int i=0;i<img.rows*img.cols;i++){
+    img.data[i] = distIntensity(gen);
+  }
+  return img;
+}
+
+}
+
+int main(int argc, char** argv) {
+  const cv::Mat img = randomImage(480,752);
+
+  std::cout << "Warped patch extraction:" << std::endl;
+  benchmarkWarpedPatchExtraction<6>(img,1000,200);
+  benchmarkWarpedPatchExtraction<8>(img,1000,200);
+  benchmarkWarpedPatchExtraction<10>(img,1000,200);
+
+  std::cout << "Pyramid construction (4 levels):" << std::endl;
+  benchmarkPyramidConstruction(img,500);
+  benchmarkPyramidConstruction(randomImage(1024,1280),200);
+
+  std::cout << "Candidate selection:" << std::endl;
+  benchmarkCandidateSelection(100,1000);
+  benchmarkCandidateSelection(1000,100);
+  benchmarkCandidateSelection(10000,10);
+
+  std::cout << "Feature storage (per frame, cold cache):" << std::endl;
+  benchmarkFeatureStorage<25>(200);
+  benchmarkFeatureStorage<200>(200);
+  return 0;
+}
@@ -1,10 +1,13 @@
 #include "rovio/Camera.hpp"
 #include "gtest/gtest.h"
 #include <assert.h>
+#include <random>
+#include <type_traits>
 
 #include "../include/rovio/ImagePyramid.hpp"
 #include "../include/rovio/FeatureManager.hpp"
 #include "../include/rovio/MultilevelPatchAlignment.hpp"
+#include "../include/rovio/FastCornerDetector.hpp"
 
 using namespace rovio;
 
@@ -77,6 +80,64 @@ TEST_F(MLPTesting, constructors) {
   ASSERT_EQ(feature.idx_,-1);
 }
 
+// Test that patches are plain value types
+TEST_F(MLPTesting, trivialCopy) {
+  ASSERT_TRUE((std::is_trivially_copyable<Patch<patchSize_>>::value));
+  ASSERT_TRUE((std::is_standard_layout<Patch<patchSize_>>::value));
+  ASSERT_TRUE((std::is_trivially_copyable<MultilevelPatch<nLevels_,patchSize_>>::value));
+  ASSERT_TRUE((std::is_standard_layout<MultilevelPatch<nLevels_,patchSize_>>::value));
+  c_.set_warp_identity();
+  c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2));
+  MultilevelPatch<nLevels_,patchSize_> mp;
+  mp.extractMultilevelPatchFromImage(pyr2_,c_,nLevels_-1,true);
+  mp.computeMultilevelShiTomasiScore();
+  const MultilevelPatch<nLevels_,patchSize_> mpCopy = mp;
+  ASSERT_EQ(mpCopy.s_,mp.s_);
+  ASSERT_EQ((mpCopy.H_.map()-mp.H_.map()).norm(),0.0);
+  ASSERT_EQ((mpCopy.patches_[0].getHessian()-mp.patches_[0].getHessian()).norm(),0.0);
+}
+
+// Test the conversion to PatchCoordinates and the extraction through them
+TEST_F(MLPTesting, patchCoordinates) {
+  ASSERT_TRUE((std::is_trivially_copyable<PatchCoordinates>::value));
+  c_.set_c(cv::Point2f(imgSize_/2+0.3,imgSize_/2-0.6));
+  PatchCoordinates pc;
+  ASSERT_TRUE(pc.set(c_));
+  ASSERT_EQ(pc.get_c(),c_.get_c());
+  ASSERT_EQ((pc.get_warp_c()-c_.get_warp_c()).norm(),0.0);
+  ASSERT_EQ(pc.isNearIdentityWarping(),c_.isNearIdentityWarping());
+  for(int l=0;l<nLevels_;l++){
+    FeatureCoordinates cLevel;
+    PatchCoordinates pcLevel;
+    pyr2_.levelTranformCoordinates(c_,cLevel,0,l);
+    pyr2_.levelTranformCoordinates(pc,pcLevel,0,l);
+    ASSERT_EQ(pcLevel.get_c(),cLevel.get_c());
+  }
+  MultilevelPatch<nLevels_,patchSize_> mp;
+  MultilevelPatch<nLevels_,patchSize_> mpPc;
+  ASSERT_TRUE(mp.isMultilevelPatchInFrame(pyr2_,c_,nLevels_-1,true));
+  ASSERT_TRUE(mpPc.isMultilevelPatchInFrame(pyr2_,pc,nLevels_-1,true));
+  mp.extractMultilevelPatchFromImage(pyr2_,c_,nLevels_-1,true);
+  mpPc.extractMultilevelPatchFromImage(pyr2_,pc,nLevels_-1,true);
+  for(int l=0;l<nLevels_;l++){
+    ASSERT_EQ(mp.isValidPatch_[l],mpPc.isValidPatch_[l]);
+    for(int i=0;i<patchSize_*patchSize_;i++){
+      ASSERT_EQ(mp.patches_[l].patch_[i],mpPc.patches_[l].patch_[i]);
+    }
+  }
+
+  // Closed form eigen decomposition of the pixel covariance
+  Eigen::Matrix2d cov;
+  cov << 3.0, -1.2, -1.2, 0.5;
+  c_.setPixelCov(cov);
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix2d> es(cov);
+  ASSERT_NEAR(c_.sigma1_,sqrt(es.eigenvalues()(1)),1e-10);
+  ASSERT_NEAR(c_.sigma2_,sqrt(es.eigenvalues()(0)),1e-10);
+  ASSERT_NEAR((cov*c_.eigenVector1_-c_.sigma1_*c_.sigma1_*c_.eigenVector1_).norm(),0.0,1e-10);
+  ASSERT_NEAR((cov*c_.eigenVector2_-c_.sigma2_*c_.sigma2_*c_.eigenVector2_).norm(),0.0,1e-10);
+  ASSERT_NEAR(std::fabs(c_.eigenVector1_.dot(Eigen::Vector2d(cos(c_.sigmaAngle_),sin(c_.sigmaAngle_)))),1.0,1e-10);
+}
+
 // Test coordinates getters and setters
 TEST_F(MLPTesting, coordinates) {
   c_.set_c(pixel_);
@@ -202,6 +263,42 @@ TEST_F(MLPTesting, statistics) {
   ASSERT_EQ(stat_.isGoodFeature(0.9,0.1),true);
 }
 
+// Test the windowed counts of the statistics history against a full record (with wraparound and range changes)
+TEST_F(MLPTesting, statisticsHistory) {
+  FeatureStatistics<nCam_,5> stat;
+  std::mt19937 gen(0);
+  std::vector<TrackingStatus> record[nCam_];
+  double time = 0.0;
+  for(int k=0;k<30;k++){
+    if(k == 15){
+      stat.localVisibilityRange_ = 7; // Keeps the history
+    }
+    for(int i=0;i<nCam_;i++){
+      stat.status_[i] = static_cast<TrackingStatus>(gen()%nTrackingStatus);
+    }
+    for(int n=0;n<stat.historySize()+2;n++){
+      for(int s=0;s<nTrackingStatus;s++){
+        int countAll = 0;
+        for(int i=0;i<nCam_;i++){
+          const int nStored = n == 0 ? record[i].size() : std::min(n-1,std::min(static_cast<int>(record[i].size()),stat.historySize()));
+          int count = (int)(stat.status_[i] == s);
+          for(int j=0;j<nStored;j++){
+            count += (int)(record[i][record[i].size()-1-j] == s);
+          }
+          ASSERT_EQ(stat.countTrackingStatistics(static_cast<TrackingStatus>(s),i,n),count);
+          countAll += count;
+        }
+        ASSERT_EQ(stat.countTrackingStatistics(static_cast<TrackingStatus>(s),-1,n),countAll);
+      }
+    }
+    for(int i=0;i<nCam_;i++){
+      record[i].push_back(stat.status_[i]);
+    }
+    time += 0.1;
+    stat.increaseStatistics(time);
+  }
+}
+
 // Test isMultilevelPatchInFrame
 TEST_F(MLPTesting, isMultilevelPatchInFrame) {
   double c;
@@ -228,6 +325,389 @@ TEST_F(MLPTesting, isMultilevelPatchInFrame) {
   }
 }
 
+// Test halfSample (SIMD kernels against scalar kernel, including odd sizes and row tails)
+TEST_F(MLPTesting, halfSample) {
+  cv::Mat img(67,151,CV_8UC1);
+  cv::randu(img,cv::Scalar(0),cv::Scalar(256));
+  cv::Mat imgScalar, imgKernel;
+  halfSample(img,imgScalar,KERNEL_SCALAR);
+  ASSERT_EQ(imgScalar.rows,33);
+  ASSERT_EQ(imgScalar.cols,75);
+  for(int y=0;y<imgScalar.rows;y++){
+    for(int x=0;x<imgScalar.cols;x++){
+      ASSERT_EQ(imgScalar.at<uint8_t>(y,x),(img.at<uint8_t>(2*y,2*x)+img.at<uint8_t>(2*y,2*x+1)+img.at<uint8_t>(2*y+1,2*x)+img.at<uint8_t>(2*y+1,2*x+1))/4);
+    }
+  }
+  const InterpolationKernel kernels[2] = {KERNEL_SSE2, KERNEL_AVX2};
+  for(unsigned int k=0;k<2;k++){
+    if(!isInterpolationKernelSupported(kernels[k])) continue;
+    halfSample(img,imgKernel,kernels[k]);
+    ASSERT_EQ(cv::countNonZero(imgKernel != imgScalar),0);
+  }
+}
+
+// Test the buffer sharing of ImagePyramid (copy, recomputation and clone)
+TEST_F(MLPTesting, imagePyramidSharing) {
+  ImagePyramid<nLevels_> pyr;
+  pyr.computeFromImage(img1_);
+  ASSERT_EQ(pyr.imgs_[0].data,img1_.data);
+  ImagePyramid<nLevels_> pyrCopy;
+  pyrCopy = pyr;
+  for(unsigned int l=0;l<nLevels_;l++){
+    ASSERT_EQ(pyrCopy.imgs_[l].data,pyr.imgs_[l].data);
+    ASSERT_EQ(pyrCopy.centers_[l],pyr.centers_[l]);
+  }
+  const ImagePyramid<nLevels_> pyrClone = pyr.clone();
+  pyr.computeFromImage(img2_);
+  for(unsigned int l=0;l<nLevels_;l++){
+    ASSERT_NE(pyrCopy.imgs_[l].data,pyr.imgs_[l].data);
+    ASSERT_NE(pyrClone.imgs_[l].data,pyrCopy.imgs_[l].data);
+    ASSERT_EQ(cv::countNonZero(pyrCopy.imgs_[l] != pyr1_.imgs_[l]),0);
+    ASSERT_EQ(cv::countNonZero(pyrClone.imgs_[l] != pyr1_.imgs_[l]),0);
+  }
+}
+
+// Test the recycling of pyramid buffers by ImagePyramidPool
+TEST_F(MLPTesting, imagePyramidPool) {
+  ImagePyramidPool<nLevels_> pool(2);
+  ImagePyramid<nLevels_> pyr, pyrPrev;
+  pyr.computeFromImage(img1_,false,&pool);
+  ASSERT_NE(pyr.imgs_[0].data,img1_.data);
+  for(unsigned int l=0;l<nLevels_;l++){
+    ASSERT_EQ(cv::countNonZero(pyr.imgs_[l] != pyr1_.imgs_[l]),0);
+  }
+  pyrPrev = pyr;
+  pyr.computeFromImage(img2_,false,&pool); // Previous slot still referenced by pyrPrev
+  ASSERT_EQ(pool.hits_,0u);
+  ASSERT_EQ(pool.misses_,2u);
+  ASSERT_EQ(cv::countNonZero(pyrPrev.imgs_[0] != img1_),0);
+  const uint8_t* data = pyrPrev.imgs_[0].data;
+  pyrPrev = pyr;
+  pyr.computeFromImage(img1_,false,&pool); // First slot is free again
+  ASSERT_EQ(pool.hits_,1u);
+  ASSERT_EQ(pyr.imgs_[0].data,data);
+  ASSERT_EQ(cv::countNonZero(pyrPrev.imgs_[0] != img2_),0);
+  ImagePyramid<nLevels_> pyrHold = pyr;
+  pyr.computeFromImage(img1_,false,&pool); // Capacity exhausted, unpooled buffers
+  ASSERT_EQ(pool.misses_,3u);
+  ASSERT_EQ(pool.slots_.size(),2u);
+}
+
+// Test the computation of a restricted level range (with and without pool)
+TEST_F(MLPTesting, imagePyramidLevelRange) {
+  ImagePyramidPool<nLevels_> pool;
+  for(int usePool=0;usePool<2;usePool++){
+    ImagePyramid<nLevels_> pyr;
+    pyr.computeFromImage(img1_,false,usePool ? &pool : nullptr,1,1);
+    ASSERT_FALSE(pyr.isLevelComputed(0));
+    ASSERT_TRUE(pyr.isLevelComputed(1));
+    ASSERT_EQ(cv::countNonZero(pyr.imgs_[1] != pyr1_.imgs_[1]),0);
+    for(unsigned int l=0;l<nLevels_;l++){
+      ASSERT_EQ(pyr.centers_[l],pyr1_.centers_[l]);
+      ASSERT_EQ(pyr.sizes_[l],pyr1_.sizes_[l]);
+    }
+    c_.set_warp_identity();
+    c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2));
+    mp_.extractMultilevelPatchFromImage(pyr,c_,nLevels_-1,true);
+    ASSERT_FALSE(mp_.isValidPatch_[0]);
+    ASSERT_TRUE(mp_.isValidPatch_[1]);
+
+    pyr.computeFromImage(img1_,true,usePool ? &pool : nullptr,0,0);
+    ASSERT_TRUE(pyr.isLevelComputed(0));
+    ASSERT_FALSE(pyr.isLevelComputed(1));
+    ASSERT_EQ(pyr.sizes_[1],pyr1_.sizes_[1]);
+  }
+}
+
+// Test the interpolation of patch gradients from gradient images (against the extraction with border)
+TEST_F(MLPTesting, extractPatchAndGradientsFromImage) {
+  cv::Mat gradX, gradY;
+  computeGradientImages(img1_,gradX,gradY);
+  ASSERT_EQ(gradX.at<int16_t>(imgSize_/2,imgSize_/2),2*dx_);
+  ASSERT_EQ(gradY.at<int16_t>(imgSize_/2,imgSize_/2),2*dy_);
+  ASSERT_EQ(gradX.at<int16_t>(imgSize_/2,0),0);
+  ASSERT_EQ(gradY.at<int16_t>(0,imgSize_/2),0);
+  Patch<patchSize_> pRef, p;
+  for(int warped=0;warped<2;warped++){
+    if(warped){
+      c_.set_warp_c(warp_c_);
+    } else {
+      c_.set_warp_identity();
+    }
+    c_.set_c(cv::Point2f(imgSize_/2+0.3,imgSize_/2-0.6));
+    ASSERT_TRUE(pRef.isPatchInFrame(img1_,c_,true));
+    pRef.extractPatchFromImage(img1_,c_,true);
+    p.extractPatchAndGradientsFromImage(img1_,gradX,gradY,c_);
+    ASSERT_TRUE(p.validGradientParameters_);
+    ASSERT_TRUE(pRef.validPatchWithBorder_);
+    ASSERT_FALSE(p.validPatchWithBorder_); // The expanded patch is not interpolated
+    for(int i=0;i<patchSize_*patchSize_;i++){
+      ASSERT_NEAR(p.patch_[i],pRef.patch_[i],1e-4);
+      ASSERT_NEAR(p.dx_[i],pRef.dx_[i],1e-3); // Linear image, thus also exact for the warped case
+      ASSERT_NEAR(p.dy_[i],pRef.dy_[i],1e-3);
+    }
+    ASSERT_NEAR((p.H_.map()-pRef.H_.map()).norm(),0.0,1e-2);
+  }
+
+  // Pyramid path
+  ImagePyramid<nLevels_> pyr;
+  pyr.computeFromImage(img1_);
+  ASSERT_FALSE(pyr.hasGradients(0));
+  pyr.computeGradients(0,0);
+  ASSERT_TRUE(pyr.hasGradients(0));
+  ASSERT_FALSE(pyr.hasGradients(1));
+}
+
+// Test SlotAllocator
+TEST_F(MLPTesting, slotAllocator) {
+  SlotAllocator<130> slots;
+  bool ref[130] = {};
+  int ind;
+  ASSERT_EQ(slots.count(),0);
+  ASSERT_TRUE(slots.getFree(ind));
+  ASSERT_EQ(ind,0);
+  for(int i=0;i<130;i++){
+    if(i%3 == 0 || i%64 == 63){
+      slots.occupy(i);
+      ref[i] = true;
+    }
+  }
+  // Iteration, removing every second valid slot on the way
+  int n = 0;
+  int k = 0;
+  for(const int i : slots){
+    while(!ref[k]) k++;
+    ASSERT_EQ(i,k);
+    if(n%2 == 1){
+      slots.release(i);
+      ref[i] = false;
+    }
+    n++;
+    k++;
+  }
+  int count = 0;
+  for(int i=0;i<130;i++){
+    ASSERT_EQ(slots.isOccupied(i),ref[i]);
+    if(ref[i]) count++;
+  }
+  ASSERT_EQ(slots.count(),count);
+  // Fill up, always the lowest free slot is returned
+  while(slots.getFree(ind)){
+    for(int i=0;i<ind;i++){
+      ASSERT_TRUE(ref[i]);
+    }
+    ASSERT_FALSE(ref[ind]);
+    slots.occupy(ind);
+    ref[ind] = true;
+  }
+  ASSERT_EQ(slots.count(),130);
+  slots.reset();
+  ASSERT_EQ(slots.count(),0);
+  ASSERT_FALSE(slots.begin() != slots.end());
+}
+
+// Test the arena storage of the FeatureSetManager
+TEST_F(MLPTesting, featureArena) {
+  MultiCamera<nCam_> multiCamera;
+  FeatureSetManager<nLevels_,patchSize_,nCam_,nMax_> fsm(&multiCamera);
+  FeatureCoordinates externalCoordinates;
+  fsm.features_[1].mpCoordinates_ = &externalCoordinates;
+  fsm.allocateMissing();
+  ASSERT_EQ(fsm.features_[1].mpCoordinates_,&externalCoordinates);
+  const size_t stride = AlignedArray<MultilevelPatch<nLevels_,patchSize_>,nMax_>::stride_;
+  ASSERT_EQ(stride%64,0);
+  const char* mpFirst = reinterpret_cast<const char*>(fsm.features_[0].mpMultilevelPatch_);
+  for(int i=0;i<nMax_;i++){
+    ASSERT_EQ(reinterpret_cast<size_t>(fsm.features_[i].mpMultilevelPatch_)%64,0);
+    ASSERT_EQ(reinterpret_cast<size_t>(fsm.features_[i].mpStatistics_)%64,0);
+    ASSERT_EQ(reinterpret_cast<const char*>(fsm.features_[i].mpMultilevelPatch_),mpFirst+i*stride);
+  }
+
+  // Copies share the storage, assignments keep their own one
+  FeatureSetManager<nLevels_,patchSize_,nCam_,nMax_> fsmCopy(fsm);
+  ASSERT_EQ(fsmCopy.features_[0].mpMultilevelPatch_,fsm.features_[0].mpMultilevelPatch_);
+  FeatureSetManager<nLevels_,patchSize_,nCam_,nMax_> fsmAssigned(&multiCamera);
+  fsmAssigned.allocateMissing();
+  const FeatureStatistics<nCam_>* mpStatistics = fsmAssigned.features_[0].mpStatistics_;
+  fsm.features_[0].mpStatistics_->localVisibility_ = 0.5;
+  fsmAssigned = fsm;
+  ASSERT_EQ(fsmAssigned.features_[0].mpStatistics_,mpStatistics);
+  ASSERT_EQ(fsmAssigned.features_[0].mpStatistics_->localVisibility_,0.5);
+}
+
+// Test preselectCandidates
+TEST_F(MLPTesting, preselectCandidates) {
+  MultiCamera<nCam_> multiCamera;
+  FeatureSetManager<nLevels_,patchSize_,nCam_,nMax_> fsm(&multiCamera);
+  fsm.allocateMissing();
+  const int ind = fsm.makeNewFeature(0);
+  fsm.features_[ind].mpCoordinates_->set_c(cv::Point2f(5,25));
+  fsm.features_[ind].mpCoordinates_->camID_ = 0;
+  fsm.features_[ind].mpCoordinates_->mpCamera_ = &multiCamera.cameras_[0];
+  const cv::Size size(40,30);
+  const cv::Point2f points[9] = {cv::Point2f(1,1), cv::Point2f(2,2), cv::Point2f(3,3), cv::Point2f(19,19), // Cell 0
+                                 cv::Point2f(30,5),                                                         // Cell 1
+                                 cv::Point2f(10,25),                                                        // Cell 2 (occupied)
+                                 cv::Point2f(21,21), cv::Point2f(39,29),                                    // Cell 3
+                                 cv::Point2f(41,5)};                                                        // Outside
+  const float pointResponses[9] = {1,4,3,4,1,9,2,3,9};
+  std::vector<FeatureCoordinates> candidates;
+  std::vector<float> responses;
+  for(int i=0;i<9;i++){
+    candidates.emplace_back(points[i]);
+    responses.push_back(pointResponses[i]);
+  }
+  ASSERT_EQ(fsm.preselectCandidates(candidates,responses,size,0,0,2),9);
+  ASSERT_EQ(fsm.preselectCandidates(candidates,responses,size,0,20,2),5);
+  ASSERT_EQ(candidates.size(),5);
+  ASSERT_EQ(responses.size(),5);
+  const int expected[5] = {1,3,4,6,7};
+  for(int i=0;i<5;i++){
+    ASSERT_EQ(candidates[i].get_c(),points[expected[i]]);
+    ASSERT_EQ(responses[i],pointResponses[expected[i]]);
+  }
+}
+
+// Test addBestCandidatesNew
+TEST_F(MLPTesting, addBestCandidatesNew) {
+  MultiCamera<nCam_> multiCamera;
+  std::vector<FeatureCoordinates> candidates;
+  for(int y=0;y<imgSize_;y++){
+    for(int x=0;x<imgSize_;x++){
+      candidates.emplace_back(cv::Point2f(x,y));
+    }
+  }
+  const float minScore = 1e-3;
+  // Best candidate by brute force
+  float bestScore = -1;
+  cv::Point2f bestPixel;
+  for(const FeatureCoordinates& c : candidates){
+    if(mp_.isMultilevelPatchInFrame(pyr2_,c,nLevels_-1,true)){
+      mp_.extractMultilevelPatchFromImage(pyr2_,c,nLevels_-1,true);
+      mp_.computeMultilevelShiTomasiScore(0,nLevels_-1);
+      if(mp_.s_ > bestScore){
+        bestScore = mp_.s_;
+        bestPixel = c.get_c();
+      }
+    }
+  }
+  ASSERT_GT(bestScore,minScore);
+
+  FeatureSetManager<nLevels_,patchSize_,nCam_,nMax_> fsm(&multiCamera);
+  fsm.allocateMissing();
+  std::vector<cv::Point2f> pixelsFirst;
+  for(int run=0;run<2;run++){ // Second run reuses the buffers
+    fsm.reset();
+    const std::unordered_set<unsigned int> newSet = fsm.addBestCandidatesNew(candidates,pyr2_,0,0.0,0,nLevels_-1,nMax_,100,0.5,20,100,false,minScore);
+    ASSERT_GE(newSet.size(),1);
+    std::vector<cv::Point2f> pixels;
+    std::unordered_set<int> cells;
+    for(const int i : fsm.validSlots_){
+      pixels.push_back(fsm.features_[i].mpCoordinates_->get_c());
+      ASSERT_TRUE(cells.insert(static_cast<int>(pixels.back().y/10)*100+static_cast<int>(pixels.back().x/10)).second); // One feature per blocked cell
+    }
+    ASSERT_EQ(pixels.size(),newSet.size());
+    ASSERT_EQ(pixels[0],bestPixel);
+    if(run == 0){
+      pixelsFirst = pixels;
+    } else {
+      ASSERT_EQ(pixels,pixelsFirst);
+    }
+  }
+}
+
+// Test MultilevelFastDetector
+TEST_F(MLPTesting, multilevelFastDetector) {
+  MultilevelFastDetector<nLevels_> detector;
+  std::vector<cv::Point2f> maskPixels;
+  for(int threshold=5;threshold<=20;threshold+=15){
+    detector.setThreshold(threshold);
+    std::vector<FeatureCoordinates> candidates;
+    std::vector<float> responses;
+    for(unsigned int l=0;l<nLevels_;l++){
+      pyr2_.detectFastCorners(candidates,l,threshold,&responses);
+      detector.detect(pyr2_,l,maskPixels,0.0);
+    }
+    std::vector<FeatureCoordinates> candidatesDetector;
+    std::vector<float> responsesDetector;
+    detector.getCandidates(candidatesDetector,responsesDetector,0,nLevels_-1);
+    ASSERT_EQ(candidatesDetector.size(),candidates.size());
+    ASSERT_EQ(responsesDetector.size(),candidates.size());
+    for(unsigned int i=0;i<candidates.size();i++){
+      ASSERT_EQ(candidatesDetector[i].get_c(),candidates[i].get_c());
+      ASSERT_EQ(responsesDetector[i],responses[i]);
+    }
+  }
+  maskPixels.push_back(cv::Point2f(imgSize_/2,imgSize_/2));
+  for(unsigned int l=0;l<nLevels_;l++){
+    detector.detect(pyr2_,l,maskPixels,2*imgSize_);
+    ASSERT_EQ(detector.candidates_[l].size(),0);
+  }
+}
+
+// Test CandidateSelector against a brute force implementation of the bucket selection
+TEST_F(MLPTesting, candidateSelector) {
+  const int nDetectionBuckets = 20;
+  const double scoreDetectionExponent = 0.5;
+  const double penaltyDistance = 15;
+  const double zeroDistancePenalty = 10;
+  const float minScore = 0.5;
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> distX(0,200);
+  std::uniform_real_distribution<float> distY(0,100);
+  std::uniform_int_distribution<int> distScore(0,10);
+  std::vector<cv::Point2f> pixels(500);
+  std::vector<float> scores(500);
+  float maxScore = 0;
+  for(int i=0;i<pixels.size();i++){
+    pixels[i] = cv::Point2f(distX(gen),distY(gen));
+    scores[i] = distScore(gen);
+    maxScore = std::max(maxScore,scores[i]);
+  }
+  std::vector<cv::Point2f> existingPixels;
+  for(int i=0;i<10;i++){
+    existingPixels.push_back(cv::Point2f(distX(gen),distY(gen)));
+  }
+  CandidateSelector selector;
+  for(int requireMax=0;requireMax<2;requireMax++){
+    std::vector<int> selected;
+    selector.select(pixels,scores,minScore,maxScore,existingPixels,50,nDetectionBuckets,scoreDetectionExponent,penaltyDistance,zeroDistancePenalty,requireMax,selected);
+
+    // Brute force reference
+    std::vector<int> bucket(pixels.size(),-1);
+    for(int i=0;i<pixels.size();i++){
+      const float relScore = (scores[i]-minScore)/(maxScore-minScore);
+      if(relScore > 0.0) bucket[i] = std::min((int)std::ceil((nDetectionBuckets-1)*(pow(relScore,static_cast<float>(scoreDetectionExponent)))),nDetectionBuckets-1);
+    }
+    const double t2 = pow(penaltyDistance,2);
+    auto penalize = [&](const cv::Point2f& p, const int maxBucket){
+      for(int i=0;i<pixels.size();i++){
+        if(bucket[i] < 1 || bucket[i] > maxBucket) continue;
+        const double d2 = std::pow(p.x - pixels[i].x,2) + std::pow(p.y - pixels[i].y,2);
+        if(d2<t2) bucket[i] = std::max((int)(bucket[i] - (t2-d2)/t2*zeroDistancePenalty),0);
+      }
+    };
+    for(const cv::Point2f& p : existingPixels){
+      penalize(p,nDetectionBuckets-1);
+    }
+    std::vector<int> selectedRef;
+    for(int b=nDetectionBuckets-1;b>=!requireMax;b--){
+      while(selectedRef.size() < 50){
+        int best = -1;
+        for(int i=0;i<pixels.size();i++){
+          if(bucket[i] == b && (best < 0 || scores[i] > scores[best])) best = i;
+        }
+        if(best < 0) break;
+        selectedRef.push_back(best);
+        bucket[best] = -1;
+        penalize(pixels[best],b);
+      }
+    }
+    ASSERT_EQ(selected.size(),50);
+    ASSERT_EQ(selected,selectedRef);
+  }
+}
+
 // Test extractMultilevelPatchFromImage (tests computeFromImage as well)
 TEST_F(MLPTesting, extractMultilevelPatchFromImage) {
   pyr1_.computeFromImage(img1_,false);
@@ -328,6 +808,148 @@ TEST_F(MLPTesting, getLinearAlignEquations) {
       }
     }
   }
+
+  // Error patches (unweighted, equal to the linear align equations here)
+  MultilevelPatch<nLevels_,patchSize_> mlpError;
+  ASSERT_EQ(mpa_.getAlignErrors(pyr2_,mp_,c_,0,nLevels_-1,mlpError),true);
+  for(unsigned int l=0;l<nLevels_;l++){
+    ASSERT_EQ(mlpError.isValidPatch_[l],true);
+    for(unsigned int i=0;i<patchSize_*patchSize_;i++){
+      ASSERT_EQ(mlpError.patches_[l].patch_[i],b(4*l+i));
+      ASSERT_EQ(mlpError.patches_[l].dx_[i],A(4*l+i,0));
+      ASSERT_EQ(mlpError.patches_[l].dy_[i],A(4*l+i,1));
+    }
+  }
+}
+
+// Test policy selection of the alignment kernels
+TEST_F(MLPTesting, alignmentPolicy) {
+  Eigen::MatrixXf A1, A2;
+  Eigen::MatrixXf b1, b2;
+  c_.set_warp_identity();
+  c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2));
+  mp_.extractMultilevelPatchFromImage(pyr2_,c_,nLevels_-1,true);
+  c_.set_c(cv::Point2f(imgSize_/2+1,imgSize_/2+1));
+  mpa_.gradientExponent_ = 0.0;
+  mpa_.huberNormThreshold_ = 0.0;
+  mpa_.useIntensityOffset_ = true;
+  mpa_.useIntensitySqew_ = false;
+  mpa_.computeWeightings(0.0);
+  mpa_.useESM_ = false;
+  mpa_.refreshPolicy();
+  ASSERT_EQ(mpa_.policyFlags_,ALIGN_INTENSITY_OFFSET);
+  ASSERT_EQ(mpa_.getLinearAlignEquations(pyr2_,mp_,c_,0,nLevels_-1,A1,b1),true);
+  ASSERT_EQ(mpa_.getLinearAlignEquations<ALIGN_INTENSITY_OFFSET>(pyr2_,mp_,c_,0,nLevels_-1,A2,b2),true);
+  ASSERT_EQ((A1-A2).norm(),0.0);
+  ASSERT_EQ((b1-b2).norm(),0.0);
+
+  // Options changed without refreshing are picked up by the entry points
+  const int flags = ALIGN_INTENSITY_SQEW | ALIGN_WEIGHTING | ALIGN_HUBER | ALIGN_GRADIENT_WEIGHTING;
+  mpa_.gradientExponent_ = 1.0;
+  mpa_.huberNormThreshold_ = 10.0;
+  mpa_.useIntensityOffset_ = false;
+  mpa_.useIntensitySqew_ = true;
+  mpa_.computeWeightings(2.0);
+  ASSERT_EQ(mpa_.getPolicyFlags(),flags);
+  ASSERT_EQ(mpa_.getLinearAlignEquations(pyr2_,mp_,c_,0,nLevels_-1,A1,b1),true);
+  ASSERT_EQ(mpa_.policyFlags_,flags);
+  ASSERT_EQ(mpa_.getLinearAlignEquations<flags>(pyr2_,mp_,c_,0,nLevels_-1,A2,b2),true);
+  ASSERT_EQ((A1-A2).norm(),0.0);
+  ASSERT_EQ((b1-b2).norm(),0.0);
+  typedef MultilevelPatchAlignment<nLevels_,patchSize_> MPA;
+  ASSERT_TRUE(MPA::getPolicyTable()[flags].normalEquations_ == &MPA::getLinearAlignNormalEquations<flags>);
+}
+
+// Test getLinearAlignEquationsReduced (against QR-decomposition, float vs double)
+TEST_F(MLPTesting, getLinearAlignEquationsReduced) {
+  Eigen::MatrixXf A;
+  Eigen::MatrixXf b;
+  Eigen::Matrix2f A_red;
+  Eigen::Vector2f b_red;
+  Eigen::Matrix2d A_red_d;
+  Eigen::Vector2d b_red_d;
+  Eigen::ColPivHouseholderQR<Eigen::MatrixXf> qr;
+  Eigen::Matrix2f aff;
+  aff << 0.8, -0.3, 0.4, 1.1;
+  mpa_.gradientExponent_ = 0.0;
+  mpa_.huberNormThreshold_ = -1.0;
+  mpa_.useIntensityOffset_ = true;
+  mpa_.useIntensitySqew_ = true;
+  mpa_.useWeighting_ = false;
+  const cv::Point2f offsets[3] = {cv::Point2f(0.3,0.6),cv::Point2f(1,1),cv::Point2f(-0.7,0.2)};
+  for(unsigned int w=0;w<2;w++){
+    for(unsigned int n=0;n<3;n++){
+      if(w==0){
+        c_.set_warp_identity();
+      } else {
+        c_.set_warp_c(aff);
+      }
+      c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2));
+      mp_.extractMultilevelPatchFromImage(pyr2_,c_,nLevels_-1,true);
+      c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2)+offsets[n]);
+      ASSERT_EQ(mpa_.getLinearAlignEquations(pyr2_,mp_,c_,0,nLevels_-1,A,b),true);
+      ASSERT_EQ(mpa_.getLinearAlignEquationsReduced(pyr2_,mp_,c_,0,nLevels_-1,A_red,b_red),true);
+      ASSERT_EQ(mpa_.getLinearAlignEquationsReduced(pyr2_,mp_,c_,0,nLevels_-1,A_red_d,b_red_d),true);
+
+      // Reference: QR-decomposition of the raw linear align equations
+      qr.compute(A);
+      const Eigen::Vector2f b_red_ref = (qr.householderQ().transpose()*b).template block<2,1>(0,0);
+      Eigen::Matrix2f A_red_ref = qr.matrixR().template block<2,2>(0,0);
+      A_red_ref(1,0) = 0.0;
+      A_red_ref = A_red_ref*qr.colsPermutation();
+      const float scale = A_red_ref.norm();
+      for(int i=0;i<2;i++){
+        ASSERT_NEAR(b_red(i),b_red_ref(i),1e-3*(1+b_red_ref.norm()));
+        ASSERT_NEAR(b_red_d(i),b_red(i),1e-3*(1+b_red_ref.norm()));
+        for(int j=0;j<2;j++){
+          ASSERT_NEAR(A_red(i,j),A_red_ref(i,j),1e-3*scale);
+          ASSERT_NEAR(A_red_d(i,j),A_red(i,j),1e-3*scale);
+        }
+      }
+    }
+  }
+}
+
+// Test computation of level-scaled Jacobians
+TEST_F(MLPTesting, computeJacobians) {
+  c_.set_warp_identity();
+  c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2));
+  mp_.extractMultilevelPatchFromImage(pyr2_,c_,nLevels_-1,true);
+  MultilevelPatchJacobians<nLevels_,patchSize_> jacobians;
+  for(unsigned int l=0;l<nLevels_;l++){
+    ASSERT_EQ(jacobians.validJacobians_[l],false);
+  }
+  Eigen::Matrix2f affInv;
+  affInv << 0.1, 0.5, 0.7, -0.2;
+  jacobians.compute(mp_,0,nLevels_-1,&affInv,true);
+  for(unsigned int l=0;l<nLevels_;l++){
+    ASSERT_EQ(jacobians.validJacobians_[l],true);
+    ASSERT_EQ(jacobians.validWarpedJacobians_[l],true);
+    ASSERT_EQ(jacobians.validHIC_[l],true);
+    Eigen::Matrix4f H;
+    H.setZero();
+    for(unsigned int i=0;i<patchSize_*patchSize_;i++){
+      const float Jx = -pow(0.5,l)*mp_.patches_[l].dx_[i];
+      const float Jy = -pow(0.5,l)*mp_.patches_[l].dy_[i];
+      ASSERT_EQ(jacobians.getJx(l,false)[i],Jx);
+      ASSERT_EQ(jacobians.getJy(l,false)[i],Jy);
+      ASSERT_EQ(jacobians.getJx(l,true)[i],Jx*affInv(0,0)+Jy*affInv(1,0));
+      ASSERT_EQ(jacobians.getJy(l,true)[i],Jx*affInv(0,1)+Jy*affInv(1,1));
+      const Eigen::Vector4f J(Jx,Jy,mp_.patches_[l].patch_[i],1.0f);
+      H += J*J.transpose();
+    }
+    ASSERT_NEAR((jacobians.HIC_[l].map()-H).norm(),0.0,1e-6*(1.0+H.norm()));
+  }
+
+  // Recomputation discards previous results (only the requested levels, no warping)
+  jacobians.compute(mp_,1,nLevels_-1,nullptr,false);
+  ASSERT_EQ(jacobians.validJacobians_[0],false);
+  for(unsigned int l=1;l<nLevels_;l++){
+    ASSERT_EQ(jacobians.validJacobians_[l],true);
+    ASSERT_EQ(jacobians.validWarpedJacobians_[l],false);
+    ASSERT_EQ(jacobians.validHIC_[l],false);
+  }
+  ASSERT_EQ(jacobians.HICInvKey_,-1);
 }
 
 // Test levelTranformCoordinates and computation of pyramid centers
@@ -507,6 +1129,262 @@ TEST_F(MLPTesting, align2D) {
 }
 
 
+// Test align2D with normal equations against align2D with SVD (A/B)
+TEST_F(MLPTesting, align2DNormalEquations) {
+  FeatureCoordinates cAligned;
+  cv::Point2f c1,c2;
+  bool s1,s2;
+  Eigen::Matrix2f aff;
+  aff << cos(M_PI/2.0), -sin(M_PI/2.0), sin(M_PI/2.0), cos(M_PI/2.0);
+  for(unsigned int k=0;k<4;k++){
+    mpa_.gradientExponent_ = (k==3) ? 0.5 : 0.0;
+    mpa_.huberNormThreshold_ = (k==2) ? 10.0 : -1.0;
+    mpa_.useIntensityOffset_ = true;
+    mpa_.useIntensitySqew_ = (k==1);
+    mpa_.computeWeightings(k==3 ? 1.0 : 0.0);
+    for(unsigned int w=0;w<2;w++){
+      if(w==0){
+        c_.set_warp_identity();
+      } else {
+        c_.set_warp_c(aff);
+      }
+      c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2));
+      mp_.extractMultilevelPatchFromImage(pyr2_,c_,nLevels_-1,true);
+      c_.set_c(cv::Point2f(imgSize_/2+1,imgSize_/2+1));
+
+      // Normal equations must match the raw linear align equations
+      Eigen::MatrixXf A;
+      Eigen::MatrixXf b;
+      Eigen::Matrix2f AtA;
+      Eigen::Vector2f Atb;
+      ASSERT_EQ(mpa_.getLinearAlignEquations(pyr2_,mp_,c_,0,nLevels_-1,A,b),true);
+      ASSERT_EQ(mpa_.getLinearAlignNormalEquations(pyr2_,mp_,c_,0,nLevels_-1,AtA,Atb),true);
+      const Eigen::Matrix2f AtA_ref = A.transpose()*A;
+      const Eigen::Vector2f Atb_ref = A.transpose()*b;
+      for(int i=0;i<2;i++){
+        ASSERT_NEAR(Atb(i),Atb_ref(i),1e-4*(1+fabs(Atb_ref(i))));
+        for(int j=0;j<2;j++){
+          ASSERT_NEAR(AtA(i,j),AtA_ref(i,j),1e-4*(1+fabs(AtA_ref(i,j))));
+        }
+      }
+
+      // Same convergence flags and results
+      for(int l1=0;l1<nLevels_;l1++){
+        for(int l2=l1;l2<nLevels_;l2++){
+          mpa_.useNormalEquations_ = false;
+          s1 = mpa_.align2D(cAligned,pyr2_,mp_,c_,l1,l2,100,1e-4);
+          c1 = cAligned.get_c();
+          mpa_.useNormalEquations_ = true;
+          s2 = mpa_.align2D(cAligned,pyr2_,mp_,c_,l1,l2,100,1e-4);
+          c2 = cAligned.get_c();
+          ASSERT_EQ(s1,s2);
+          if(s1){
+            ASSERT_NEAR(c1.x,c2.x,1e-3);
+            ASSERT_NEAR(c1.y,c2.y,1e-3);
+          }
+        }
+      }
+    }
+  }
+
+  // Rank deficient system (linear intensity ramp, all Jacobians parallel) is rejected by both
+  mpa_.gradientExponent_ = 0.0;
+  mpa_.huberNormThreshold_ = -1.0;
+  mpa_.computeWeightings(0.0);
+  mpa_.useIntensityOffset_ = false;
+  mpa_.useIntensitySqew_ = false;
+  c_.set_warp_identity();
+  c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2));
+  mp_.extractMultilevelPatchFromImage(pyr1_,c_,nLevels_-1,true);
+  c_.set_c(cv::Point2f(imgSize_/2+0.5,imgSize_/2+0.5));
+  mpa_.useNormalEquations_ = false;
+  ASSERT_EQ(mpa_.align2D(cAligned,pyr1_,mp_,c_,0,0,100,1e-4),false);
+  mpa_.useNormalEquations_ = true;
+  ASSERT_EQ(mpa_.align2D(cAligned,pyr1_,mp_,c_,0,0,100,1e-4),false);
+  mpa_.useNormalEquations_ = false;
+}
+
+// Test inverse compositional alignment
+TEST_F(MLPTesting, align2DInverseCompositional) {
+  mpa_.useIntensityOffset_ = true;
+  mpa_.useIntensitySqew_ = false;
+  FeatureCoordinates cAligned;
+  cv::Point2f c1,c2;
+  Eigen::Matrix2f aff;
+  aff << cos(M_PI/2.0), -sin(M_PI/2.0), sin(M_PI/2.0), cos(M_PI/2.0);
+  for(unsigned int w=0;w<2;w++){
+    if(w==0){
+      c_.set_warp_identity();
+    } else {
+      c_.set_warp_c(aff);
+    }
+    c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2));
+    mp_.extractMultilevelPatchFromImage(pyr2_,c_,nLevels_-1,true);
+    ASSERT_EQ(mpa_.align2DInverseCompositional(cAligned,pyr2_,mp_,c_,0,nLevels_-1,100,1e-4),true);
+    ASSERT_NEAR(cAligned.get_c().x,imgSize_/2,1e-2);
+    ASSERT_NEAR(cAligned.get_c().y,imgSize_/2,1e-2);
+    c_.set_c(cv::Point2f(imgSize_/2+1,imgSize_/2+1));
+    ASSERT_EQ(mpa_.align2DInverseCompositional(cAligned,pyr2_,mp_,c_,0,nLevels_-1,100,1e-4),true);
+    ASSERT_NEAR(cAligned.get_c().x,imgSize_/2,1e-2);
+    ASSERT_NEAR(cAligned.get_c().y,imgSize_/2,1e-2);
+
+    // Single step comparison with old inverse compositional implementation (offset only)
+    for(int l1=0;l1<nLevels_;l1++){
+      for(int l2=l1;l2<nLevels_;l2++){
+        mpa_.align2DInverseCompositional(cAligned,pyr2_,mp_,c_,l1,l2,1,1e-4);
+        c1 = cAligned.get_c();
+        mpa_.align2D_old(cAligned,pyr2_,mp_,c_,l1,l2,1,1e-4);
+        c2 = cAligned.get_c();
+        ASSERT_NEAR(c1.x,c2.x,1e-4);
+        ASSERT_NEAR(c1.y,c2.y,1e-4);
+      }
+    }
+
+    // Usable through align2D (and thus align2DComposed/align2DAdaptive)
+    mpa_.useInverseCompositional_ = true;
+    ASSERT_EQ(mpa_.align2DAdaptive(cAligned,pyr2_,mp_,c_,nLevels_-1,0),true);
+    ASSERT_NEAR(cAligned.get_c().x,imgSize_/2,5e-2);
+    ASSERT_NEAR(cAligned.get_c().y,imgSize_/2,5e-2);
+    mpa_.useInverseCompositional_ = false;
+
+    // Gaussian and gradient based weighting are applied
+    for(unsigned int k=0;k<2;k++){
+      mpa_.gradientExponent_ = (k==1) ? 0.5 : 0.0;
+      mpa_.computeWeightings(1.0);
+      ASSERT_EQ(mpa_.align2DInverseCompositional(cAligned,pyr2_,mp_,c_,0,nLevels_-1,100,1e-4),true);
+      ASSERT_NEAR(cAligned.get_c().x,imgSize_/2,1e-2);
+      ASSERT_NEAR(cAligned.get_c().y,imgSize_/2,1e-2);
+      MultilevelPatchJacobians<nLevels_,patchSize_> jacobians;
+      jacobians.compute(mp_,0,nLevels_-1,nullptr,true,mpa_.w_,mpa_.gradientExponent_);
+      for(unsigned int l=0;l<nLevels_;l++){
+        for(unsigned int i=0;i<16;i++){
+          ASSERT_EQ(mpa_.jacobians_.HIC_[l].data_[i],jacobians.HIC_[l].data_[i]);
+        }
+        if(k==1){ // Sum of the squared weights
+          ASSERT_LT(mpa_.jacobians_.HIC_[l].data_[15],patchSize_*patchSize_);
+        }
+      }
+    }
+    mpa_.gradientExponent_ = 0.0;
+    mpa_.computeWeightings(0.0);
+  }
+
+  // The Hessians are reused for the same extraction of the patch, a refreshed patch is never aligned with stale Hessians
+  c_.set_warp_identity();
+  c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2));
+  mp_.extractMultilevelPatchFromImage(pyr2_,c_,nLevels_-1,true);
+  mpa_.align2DInverseCompositional(cAligned,pyr2_,mp_,c_,0,nLevels_-1,1,1e-4);
+  const uint64_t extractionId = mp_.extractionId_;
+  ASSERT_EQ(mpa_.preparedExtractionId_,extractionId);
+  mp_.extractMultilevelPatchFromImage(pyr1_,c_,nLevels_-1,true);
+  ASSERT_NE(mp_.extractionId_,extractionId);
+  mpa_.align2DInverseCompositional(cAligned,pyr1_,mp_,c_,0,nLevels_-1,1,1e-4);
+  ASSERT_EQ(mpa_.preparedExtractionId_,mp_.extractionId_);
+  MultilevelPatchJacobians<nLevels_,patchSize_> jacobians;
+  jacobians.compute(mp_,0,nLevels_-1,nullptr,true);
+  for(unsigned int l=0;l<nLevels_;l++){
+    ASSERT_EQ(mpa_.jacobians_.validHIC_[l],true);
+    for(unsigned int i=0;i<16;i++){
+      ASSERT_EQ(mpa_.jacobians_.HIC_[l].data_[i],jacobians.HIC_[l].data_[i]);
+    }
+  }
+}
+
+// Test align2D with efficient second-order minimization
+TEST_F(MLPTesting, align2DESM) {
+  mpa_.useIntensityOffset_ = true;
+  mpa_.useIntensitySqew_ = false;
+  FeatureCoordinates cAligned;
+  Eigen::Matrix2f aff;
+  aff << cos(M_PI/2.0), -sin(M_PI/2.0), sin(M_PI/2.0), cos(M_PI/2.0);
+  for(unsigned int w=0;w<2;w++){
+    if(w==0){
+      c_.set_warp_identity();
+    } else {
+      c_.set_warp_c(aff);
+    }
+    c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2));
+    mp_.extractMultilevelPatchFromImage(pyr2_,c_,nLevels_-1,true);
+    c_.set_c(cv::Point2f(imgSize_/2+1,imgSize_/2+1));
+    mpa_.useESM_ = false;
+    ASSERT_EQ(mpa_.align2D(cAligned,pyr2_,mp_,c_,0,nLevels_-1,100,1e-4),true);
+    ASSERT_GT(mpa_.iterationCount_,0);
+    ASSERT_LE(mpa_.iterationCount_,100);
+    mpa_.useESM_ = true;
+    ASSERT_EQ(mpa_.align2D(cAligned,pyr2_,mp_,c_,0,nLevels_-1,100,1e-4),true);
+    ASSERT_NEAR(cAligned.get_c().x,imgSize_/2,1e-2);
+    ASSERT_NEAR(cAligned.get_c().y,imgSize_/2,1e-2);
+    ASSERT_GT(mpa_.iterationCount_,0);
+
+    // Wider convergence basin than the standard alignment
+    c_.set_c(cv::Point2f(imgSize_/2+1,imgSize_/2-0.5));
+    mpa_.useESM_ = false;
+    ASSERT_EQ(mpa_.align2D(cAligned,pyr2_,mp_,c_,0,nLevels_-1,100,1e-4),false);
+    mpa_.useESM_ = true;
+    ASSERT_EQ(mpa_.align2D(cAligned,pyr2_,mp_,c_,0,nLevels_-1,100,1e-4),true);
+    ASSERT_NEAR(cAligned.get_c().x,imgSize_/2,1e-2);
+    ASSERT_NEAR(cAligned.get_c().y,imgSize_/2,1e-2);
+    ASSERT_LE(mpa_.iterationCount_,100);
+
+    // Iteration counts are summed over the inner alignments
+    mpa_.align2DComposed(cAligned,pyr2_,mp_,c_,nLevels_-1,0,1);
+    const int iterationCountComposed = mpa_.iterationCount_;
+    int iterationCountSum = 0;
+    cAligned = c_;
+    for(int l=1;l>=0;--l){
+      const bool success = mpa_.align2D(cAligned,pyr2_,mp_,cAligned,l,nLevels_-1);
+      iterationCountSum += mpa_.iterationCount_;
+      if(!success) break;
+    }
+    ASSERT_GT(iterationCountComposed,0);
+    ASSERT_EQ(iterationCountComposed,iterationCountSum);
+    mpa_.useESM_ = false;
+  }
+}
+
+// Test the parallel seed evaluation of align2DAdaptive (against sequential evaluation)
+TEST_F(MLPTesting, align2DAdaptiveParallel) {
+  mpa_.useIntensityOffset_ = false;
+  mpa_.useIntensitySqew_ = false;
+  FeatureCoordinates cAligned, cParallel;
+  c_.set_warp_identity();
+  c_.set_c(cv::Point2f(imgSize_/2,imgSize_/2));
+  mp_.extractMultilevelPatchFromImage(pyr1_,c_,nLevels_-1,true);
+  Eigen::Matrix2d cov;
+  cov << 4.0, 0.0, 0.0, 1.0;
+  c_.setPixelCov(cov);
+  c_.set_c(cv::Point2f(imgSize_/2+1,imgSize_/2+0.5),false);
+  const bool success = mpa_.align2DAdaptive(cAligned,pyr1_,mp_,c_,nLevels_-1,0,0.25,2.0,2);
+  const double error = mpa_.bestIntensityError_;
+  const int iterationCount = mpa_.iterationCount_;
+  for(int nWorkers=2;nWorkers<=4;nWorkers++){
+    mpa_.setSeedWorkers(nWorkers);
+    ASSERT_EQ(mpa_.seedWorkerPool_->size(),nWorkers);
+    ASSERT_EQ(mpa_.align2DAdaptive(cParallel,pyr1_,mp_,c_,nLevels_-1,0,0.25,2.0,2),success);
+    ASSERT_EQ(mpa_.seedResults_.size(),5u);
+    ASSERT_EQ(mpa_.bestIntensityError_,error);
+    ASSERT_EQ(cParallel.get_c().x,cAligned.get_c().x);
+    ASSERT_EQ(cParallel.get_c().y,cAligned.get_c().y);
+    ASSERT_EQ(mpa_.iterationCount_,iterationCount);
+  }
+
+  // With early cancelling the first winning seed (center-out) and the seeds before it decide
+  mpa_.seedCancelIntensityError_ = 1e6;
+  int kWin = -1;
+  for(int k=0;k<5 && kWin == -1;k++){
+    if(mpa_.seedResults_[k].valid_) kWin = k;
+  }
+  ASSERT_EQ(kWin,0);
+  for(int run=0;run<20;run++){
+    ASSERT_EQ(mpa_.align2DAdaptive(cParallel,pyr1_,mp_,c_,nLevels_-1,0,0.25,2.0,2),true);
+    ASSERT_EQ(cParallel.get_c().x,mpa_.seedResults_[0].c_.get_c().x);
+    ASSERT_EQ(cParallel.get_c().y,mpa_.seedResults_[0].c_.get_c().y);
+  }
+  mpa_.seedCancelIntensityError_ = 0.0;
+  mpa_.setSeedWorkers(1);
+  ASSERT_TRUE(mpa_.seedWorkerPool_ == nullptr);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -37,6 +37,40 @@ class PatchTesting : public virtual ::testing::Test {
     }
   }
   virtual ~PatchTesting() {}
+
+  /** \brief Calls check(kernel) for every supported vectorized interpolation kernel and restores the active kernel afterwards.
+   */
+  template<typename Check>
+  void forEachVectorizedKernel(Check check){
+    const InterpolationKernel activeKernel = activeInterpolationKernel();
+    const InterpolationKernel kernels[2] = {KERNEL_SSE2, KERNEL_AVX2};
+    for(unsigned int k=0;k<2;k++){
+      if(isInterpolationKernelSupported(kernels[k])){
+        check(kernels[k]);
+      }
+    }
+    activeInterpolationKernel() = activeKernel;
+  }
+
+  /** \brief Extracts a patch at c_ with the scalar reference kernel (pRef) and with the given kernel (p), and compares them.
+   */
+  template<int N>
+  void compareKernelExtraction(const cv::Mat& img, const InterpolationKernel kernel, const bool withBorder, const float tol){
+    Patch<N> pRef;
+    Patch<N> p;
+    activeInterpolationKernel() = KERNEL_SCALAR;
+    pRef.extractPatchFromImage(img,c_,withBorder);
+    activeInterpolationKernel() = kernel;
+    p.extractPatchFromImage(img,c_,withBorder);
+    if(withBorder){
+      for(int i=0;i<(N+2)*(N+2);i++){
+        ASSERT_NEAR(p.patchWithBorder_[i],pRef.patchWithBorder_[i],tol);
+      }
+    }
+    for(int i=0;i<N*N;i++){
+      ASSERT_NEAR(p.patch_[i],pRef.patch_[i],tol);
+    }
+  }
 };
 
 // Test constructors
@@ -186,6 +220,33 @@ TEST_F(PatchTesting, extractPatchFromImage) {
   }
 }
 
+// Test the vectorized interpolation kernels of extractPatchFromImage against the scalar reference (near identity warping)
+TEST_F(PatchTesting, extractPatchFromImageKernels) {
+  const int imgSize = 20;
+  cv::Mat img = cv::Mat::zeros(imgSize,imgSize,CV_8UC1);
+  uint8_t* img_ptr = (uint8_t*) img.data;
+  for(int i=0;i<imgSize*imgSize;i++, ++img_ptr){
+    *img_ptr = (i*97+13)%256;
+  }
+  const int N = 6;
+  cv::Point2f centers[N] = {cv::Point2f(6,6),
+      cv::Point2f(6.5,6),
+      cv::Point2f(6,6.5),
+      cv::Point2f(7.3254,8.9123),
+      cv::Point2f(imgSize-6,imgSize-6),
+      cv::Point2f(imgSize-6-0.1234,imgSize-6-0.7654)};
+  forEachVectorizedKernel([&](const InterpolationKernel kernel){
+    for(unsigned int n=0;n<N;n++){
+      c_.set_c(centers[n]);
+      c_.set_warp_identity();
+      for(int withBorder=0;withBorder<2;withBorder++){
+        compareKernelExtraction<8>(img,kernel,withBorder,1e-4);
+        compareKernelExtraction<patchSize_>(img,kernel,withBorder,1e-4);
+      }
+    }
+  });
+}
+
 // Test extractWarpedPatchFromImage
 TEST_F(PatchTesting, extractWarpedPatchFromImage) {
   Eigen::Matrix2f aff;
@@ -202,6 +263,59 @@ TEST_F(PatchTesting, extractWarpedPatchFromImage) {
   }
 }
 
+// Test the vectorized interpolation kernels of extractPatchFromImage against the scalar reference (warped patch)
+TEST_F(PatchTesting, extractWarpedPatchFromImageKernels) {
+  const int imgSize = 20;
+  cv::Mat img = cv::Mat::zeros(imgSize,imgSize,CV_8UC1);
+  uint8_t* img_ptr = (uint8_t*) img.data;
+  for(int i=0;i<imgSize;i++){
+    for(int j=0;j<imgSize;j++, ++img_ptr){
+      *img_ptr = i*dy_+j*dx_;
+    }
+  }
+  const int N = 3;
+  Eigen::Matrix2f affs[N];
+  affs[0] << cos(M_PI/6.0), -sin(M_PI/6.0), sin(M_PI/6.0), cos(M_PI/6.0);
+  affs[1] << 1.3, 0.2, -0.1, 0.8;
+  affs[2] << 0.7, -0.4, 0.5, 1.1;
+  cv::Point2f centers[N] = {cv::Point2f(imgSize/2,imgSize/2),
+      cv::Point2f(9.3254,10.9123),
+      cv::Point2f(imgSize-8.5,imgSize-8.5)};
+  forEachVectorizedKernel([&](const InterpolationKernel kernel){
+    for(unsigned int n=0;n<N;n++){
+      c_.set_c(centers[n]);
+      c_.set_warp_c(affs[n]);
+      ASSERT_EQ(Patch<8>::isPatchInFrame(img,c_,true),true);
+      compareKernelExtraction<8>(img,kernel,true,1e-3);
+    }
+  });
+}
+
+// Test the vectorized warped interpolation kernels at the right and bottom image border (unpadded image buffer)
+TEST_F(PatchTesting, extractWarpedPatchAtBorderKernels) {
+  const int imgSize = 20;
+  std::vector<uint8_t> buffer(imgSize*imgSize);
+  for(unsigned int i=0;i<buffer.size();i++){
+    buffer[i] = (i*37+11)%251;
+  }
+  cv::Mat img(imgSize,imgSize,CV_8UC1,buffer.data());
+  const int N = 3;
+  Eigen::Matrix2f affs[N];
+  affs[0] << 0.0, -1.0, 1.0, 0.0;
+  affs[1] << -1.0, 0.0, 0.0, -1.0;
+  affs[2] << cos(M_PI/4.0), -sin(M_PI/4.0), sin(M_PI/4.0), cos(M_PI/4.0);
+  forEachVectorizedKernel([&](const InterpolationKernel kernel){
+    for(unsigned int n=0;n<N;n++){
+      const float extentX = 5*(std::fabs(affs[n](0,0))+std::fabs(affs[n](0,1)));
+      const float extentY = 5*(std::fabs(affs[n](1,0))+std::fabs(affs[n](1,1)));
+      c_.set_c(cv::Point2f(imgSize-extentX,imgSize-extentY));
+      c_.set_warp_c(affs[n]);
+      ASSERT_EQ(Patch<8>::isPatchInFrame(img,c_,true),true);
+      compareKernelExtraction<8>(img,kernel,true,1e-3);
+    }
+  });
+}
+
 // Test extractPatchFromPatchWithBorder
 TEST_F(PatchTesting, extractPatchFromPatchWithBorder) {
   c_.set_c(cv::Point2f(patchSize_/2+1,patchSize_/2+1));
@@ -250,6 +364,41 @@ TEST_F(PatchTesting, computeGradientParameters) {
   ASSERT_EQ(p_.s_,s);
 }
 
+// Test the fused extraction of patch, gradients and Hessian (extraction with border)
+TEST_F(PatchTesting, extractPatchAndGradientParameters) {
+  const int imgSize = 20;
+  cv::Mat img = cv::Mat::zeros(imgSize,imgSize,CV_8UC1);
+  uint8_t* img_ptr = (uint8_t*) img.data;
+  for(int i=0;i<imgSize*imgSize;i++, ++img_ptr){
+    *img_ptr = (i*97+13)%256;
+  }
+  Patch<8> p;
+  c_.set_c(cv::Point2f(9.3254,10.9123));
+  c_.set_warp_identity();
+  p.extractPatchFromImage(img,c_,true);
+  ASSERT_EQ(p.validGradientParameters_,true);
+  Eigen::Matrix3f H;
+  H.setZero();
+  Eigen::Vector3f J;
+  for(int y=0;y<8;y++){
+    for(int x=0;x<8;x++){
+      const float* it = p.patchWithBorder_ + (y+1)*10 + x+1;
+      J << 0.5 * (it[1] - it[-1]), 0.5 * (it[10] - it[-10]), 1;
+      H += J*J.transpose();
+      ASSERT_EQ(p.patch_[y*8+x],it[0]);
+      ASSERT_EQ(p.dx_[y*8+x],J(0));
+      ASSERT_EQ(p.dy_[y*8+x],J(1));
+    }
+  }
+  for(int i=0;i<3;i++){
+    for(int j=0;j<3;j++){
+      ASSERT_NEAR(p.H_(i,j),H(i,j),1e-6*(1+fabs(H(i,j))));
+    }
+  }
+  p.extractPatchFromImage(img,c_,false);
+  ASSERT_EQ(p.validGradientParameters_,false);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();